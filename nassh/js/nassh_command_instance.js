@@ -1238,6 +1238,8 @@ CommandInstance.prototype.connectToFinalize_ = async function(params, options) {
   argv.useJsSocket = !!this.relay_;
   argv.environment = this.environment_;
   argv.writeWindow = 8 * 1024;
+  // Let the plugin grow or shrink the window from how fast we ack output.
+  argv.writeWindowAuto = true;
 
   if (this.isSftp) {
     argv.subsystem = 'sftp';
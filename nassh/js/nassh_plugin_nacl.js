@@ -58,6 +58,28 @@ export class Plugin {
 
     // A set of open streams for this instance.
     this.streams_ = new StreamSet();
+
+    /**
+     * Messages waiting to be sent to the plugin as [name, arguments] pairs.
+     *
+     * @type {!Array<!Array>}
+     */
+    this.pendingMessages_ = [];
+
+    /**
+     * The latest write stats the plugin reported for each fd.
+     *
+     * @type {!Map<number, {window: number, ackRttUs: number, drainRate: number}>}
+     */
+    this.writeStats_ = new Map();
+
+    /**
+     * Whether the plugin takes onRead data as ArrayBuffers; see
+     * setCapabilities.
+     *
+     * @type {boolean}
+     */
+    this.arrayBufferInput_ = false;
   }
 
   /** @param {function()} onComplete */
@@ -127,6 +149,14 @@ export class Plugin {
    * @param {!Object} e
    */
   onMessage_(e) {
+    if (e.data.name === 'batch') {
+      // Several calls in one message; see send().
+      e.data.arguments.forEach(([name, args]) => {
+        this.dispatchMessage_('plugin', {name: name, argv: args});
+      });
+      return;
+    }
+
     // TODO: We should adjust all our callees to avoid this.
     e.data.argv = e.data.arguments;
     this.dispatchMessage_('plugin', e.data);
@@ -150,12 +180,38 @@ export class Plugin {
   /**
    * Send a message to the NaCl plugin.
    *
+   * Messages sent from the same task are queued and posted together in a
+   * single "batch" message to cut down on per-message overhead.
+   *
    * @param {string} name The name of the message to send.
    * @param {!Array} args The message arguments.
    */
   send(name, args) {
+    this.pendingMessages_.push([name, args]);
+    if (this.pendingMessages_.length == 1) {
+      Promise.resolve().then(() => this.flush_());
+    }
+  }
+
+  /**
+   * Post the queued messages to the plugin.
+   */
+  flush_() {
+    const messages = this.pendingMessages_;
+    this.pendingMessages_ = [];
+    if (messages.length == 0) {
+      return;
+    }
+
+    let msg;
+    if (messages.length == 1) {
+      msg = {name: messages[0][0], arguments: messages[0][1]};
+    } else {
+      msg = {name: 'batch', arguments: messages};
+    }
+
     try {
-      this.plugin_.postMessage({name: name, arguments: args});
+      this.plugin_.postMessage(msg);
     } catch (e) {
       // When we tear down the plugin, we sometimes have pending calls.
       // Rather than try and chase all of those down, swallow errors when the
@@ -241,14 +297,67 @@ export class Plugin {
     console.log(`plugin log: ${str}`);
   }
 
+  /**
+   * Plugin reports how its writes to a stream are doing.
+   *
+   * @param {number} fd The file handle the stats are for.
+   * @param {number} window Bytes the plugin may write without an ack.
+   * @param {number} ackRttUs Smoothed time until writes are acked.
+   * @param {number} drainRate Smoothed bytes per second we consume.
+   */
+  writeStats(fd, window, ackRttUs, drainRate) {
+    this.writeStats_.set(fd, {window, ackRttUs, drainRate});
+  }
+
+  /**
+   * Get the latest write stats the plugin reported for a stream.
+   *
+   * @param {number} fd The file handle.
+   * @return {?{window: number, ackRttUs: number, drainRate: number}}
+   */
+  getWriteStats(fd) {
+    return this.writeStats_.get(fd) || null;
+  }
+
+  /**
+   * Plugin tells us what it supports.
+   *
+   * @param {!Object} caps The plugin capabilities.
+   */
+  setCapabilities(caps) {
+    this.arrayBufferInput_ = !!caps.arrayBufferInput;
+  }
+
+  /**
+   * Pass data read from a stream on to the plugin.
+   *
+   * Streams hand us base64 strings or ArrayBuffers.  When the plugin can take
+   * ArrayBuffers, strings are decoded here so the plugin doesn't have to.
+   * Otherwise they are passed on as they are.
+   *
+   * @param {number} fd The file handle the data is for.
+   * @param {string|!ArrayBuffer} data The content.
+   */
+  sendData_(fd, data) {
+    if (this.arrayBufferInput_ && typeof data == 'string') {
+      const str = atob(data);
+      const bytes = new Uint8Array(str.length);
+      for (let i = 0; i < str.length; ++i) {
+        bytes[i] = str.charCodeAt(i);
+      }
+      data = bytes.buffer;
+    }
+    this.send('onRead', [fd, data]);
+  }
+
   /**
    * Write data to the plugin.
    *
    * @param {number} fd The file handle to write to.
-   * @param {!ArrayBuffer} data The content to write.
+   * @param {string|!ArrayBuffer} data The content to write.
    */
   writeTo(fd, data) {
-    this.send('onRead', [fd, data]);
+    this.sendData_(fd, data);
   }
 
   /**
@@ -343,7 +452,7 @@ export class Plugin {
     }
 
     stream.onDataAvailable = (data) => {
-      this.send('onRead', [fd, data]);
+      this.sendData_(fd, data);
     };
 
     stream.onClose = () => {
@@ -394,7 +503,7 @@ export class Plugin {
     }
 
     stream.asyncRead(size, (b64bytes) => {
-      this.send('onRead', [fd, b64bytes]);
+      this.sendData_(fd, b64bytes);
     });
   }
 
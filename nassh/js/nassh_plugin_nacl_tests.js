@@ -0,0 +1,157 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * @fileoverview NaCl plugin message tests.
+ */
+
+import {Plugin} from './nassh_plugin_nacl.js';
+
+describe('nassh_plugin_nacl_tests.js', () => {
+
+/**
+ * Create a plugin whose messages are captured instead of posted.
+ */
+beforeEach(function() {
+  this.plugin = new Plugin({io: {}});
+  this.posted = [];
+  this.plugin.plugin_ = {postMessage: (msg) => this.posted.push(msg)};
+});
+
+/**
+ * Wait for the queued messages to be flushed.
+ */
+const flush = () => new Promise((resolve) => setTimeout(resolve));
+
+/**
+ * A single message is posted as it is.
+ */
+it('send-single', async function() {
+  this.plugin.send('onResize', [80, 24]);
+  assert.deepStrictEqual(this.posted, []);
+
+  await flush();
+  assert.deepStrictEqual(this.posted, [
+    {name: 'onResize', arguments: [80, 24]},
+  ]);
+});
+
+/**
+ * Messages sent from the same task go out in one batch, in order.
+ */
+it('send-batch', async function() {
+  this.plugin.send('onReadReady', [0, true]);
+  this.plugin.send('onWriteAcknowledge', [1, 100]);
+  this.plugin.send('onClose', [2]);
+  assert.deepStrictEqual(this.posted, []);
+
+  await flush();
+  assert.deepStrictEqual(this.posted, [{
+    name: 'batch',
+    arguments: [
+      ['onReadReady', [0, true]],
+      ['onWriteAcknowledge', [1, 100]],
+      ['onClose', [2]],
+    ],
+  }]);
+});
+
+/**
+ * Messages sent after a flush start a new message.
+ */
+it('send-after-flush', async function() {
+  this.plugin.send('onClose', [1]);
+  await flush();
+  this.plugin.send('onClose', [2]);
+  await flush();
+  assert.deepStrictEqual(this.posted, [
+    {name: 'onClose', arguments: [1]},
+    {name: 'onClose', arguments: [2]},
+  ]);
+});
+
+/**
+ * A single message from the plugin is dispatched to its handler.
+ */
+it('onMessage-single', function() {
+  const calls = [];
+  this.plugin.printLog = (...args) => calls.push(['printLog', args]);
+
+  this.plugin.onMessage_({data: {name: 'printLog', arguments: ['hi']}});
+  assert.deepStrictEqual(calls, [['printLog', ['hi']]]);
+});
+
+/**
+ * A batch from the plugin is dispatched call by call, in order.
+ */
+it('onMessage-batch', function() {
+  const calls = [];
+  this.plugin.printLog = (...args) => calls.push(['printLog', args]);
+  this.plugin.read = (...args) => calls.push(['read', args]);
+
+  this.plugin.onMessage_({data: {
+    name: 'batch',
+    arguments: [
+      ['printLog', ['one']],
+      ['read', [3, 1024]],
+      ['printLog', ['two']],
+    ],
+  }});
+  assert.deepStrictEqual(calls, [
+    ['printLog', ['one']],
+    ['read', [3, 1024]],
+    ['printLog', ['two']],
+  ]);
+});
+
+/**
+ * Until the plugin asks for ArrayBuffers, stream data is passed on as it is.
+ */
+it('sendData', async function() {
+  const buffer = new Uint8Array([1, 2, 3]).buffer;
+  this.plugin.sendData_(4, 'AQID');
+  this.plugin.sendData_(4, buffer);
+
+  await flush();
+  assert.equal(this.posted.length, 1);
+  const [[name1, args1], [name2, args2]] = this.posted[0].arguments;
+  assert.equal(name1, 'onRead');
+  assert.deepStrictEqual(args1, [4, 'AQID']);
+  assert.equal(name2, 'onRead');
+  assert.strictEqual(args2[1], buffer);
+});
+
+/**
+ * Once the plugin asks for ArrayBuffers, base64 strings are decoded for it.
+ */
+it('sendData-arrayBufferInput', async function() {
+  this.plugin.onMessage_({data: {name: 'setCapabilities',
+                                 arguments: [{arrayBufferInput: true}]}});
+  const buffer = new Uint8Array([4, 5]).buffer;
+  this.plugin.sendData_(4, 'AQID');
+  this.plugin.sendData_(4, buffer);
+
+  await flush();
+  const [[, args1], [, args2]] = this.posted[0].arguments;
+  assert.equal(args1[0], 4);
+  assert.deepStrictEqual(Array.from(new Uint8Array(args1[1])), [1, 2, 3]);
+  assert.strictEqual(args2[1], buffer);
+});
+
+/**
+ * The latest write stats from the plugin are kept per fd.
+ */
+it('writeStats', function() {
+  assert.isNull(this.plugin.getWriteStats(1));
+
+  this.plugin.onMessage_({data: {name: 'writeStats',
+                                 arguments: [1, 65536, 2000, 1000000]}});
+  this.plugin.onMessage_({data: {name: 'writeStats',
+                                 arguments: [1, 131072, 1500, 2000000]}});
+  assert.deepStrictEqual(this.plugin.getWriteStats(1),
+                         {window: 131072, ackRttUs: 1500, drainRate: 2000000});
+  assert.isNull(this.plugin.getWriteStats(2));
+});
+
+});
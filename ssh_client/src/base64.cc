@@ -0,0 +1,167 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base64.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace {
+
+// Value of each base64 character, 0xff for everything else.
+const uint8_t kDecodeTable[256] = {
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+  0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+  0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+  0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+  0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+  0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+  0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+  0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+  0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+// Generic vectors, which GCC and clang lower to whatever the target has:
+// SSE2 or NEON natively, 128-bit vectors in PNaCl.
+typedef uint8_t U8x16 __attribute__((vector_size(16)));
+typedef int8_t I8x16 __attribute__((vector_size(16)));
+typedef uint32_t U32x4 __attribute__((vector_size(16)));
+
+// All ones in the lanes of |c| that are in [|lo|, |lo| + |n|).
+inline U8x16 InRange(U8x16 c, int lo, int n) {
+  // Moving |lo| to -128 makes this one signed comparison, which SSE2 has
+  // unlike unsigned ones.
+  return (U8x16)((I8x16)(c - (uint8_t)(lo + 128)) < (int8_t)(n - 128));
+}
+
+// Decode the 16 characters at |in| into 12 bytes at |out|, and write one more
+// byte after those.  Lanes of |*invalid| become non-zero for characters that
+// aren't base64.
+inline void DecodeBlock16(const uint8_t* in, uint8_t* out, U8x16* invalid) {
+  U8x16 c;
+  memcpy(&c, in, sizeof(c));
+
+  // Map each character range onto its values by adding an offset to it.
+  U8x16 upper = InRange(c, 'A', 26);
+  U8x16 lower = InRange(c, 'a', 26);
+  U8x16 digit = InRange(c, '0', 10);
+  U8x16 plus = (U8x16)(c == '+');
+  U8x16 slash = (U8x16)(c == '/');
+  U8x16 offset = (upper & (uint8_t)(0 - 'A')) |
+                 (lower & (uint8_t)(26 - 'a')) |
+                 (digit & (uint8_t)(52 - '0')) |
+                 (plus & (uint8_t)(62 - '+')) |
+                 (slash & (uint8_t)(63 - '/'));
+  *invalid |= ~(upper | lower | digit | plus | slash);
+
+  // Each little endian word now holds four 6-bit values a, b, c, d in its
+  // bytes.  Pack them into a << 18 | b << 12 | c << 6 | d, with the bytes of
+  // the result in big endian order at the bottom of the word.
+  U32x4 w = (U32x4)(c + offset);
+  U32x4 v = (w & 0x3f) << 18 | (w & 0x3f00) << 4 | (w >> 10 & 0xfc0) |
+            w >> 24;
+  v = (v >> 16) | (v & 0xff00) | (v & 0xff) << 16;
+
+  // The top byte of each word is zero and gets overwritten by the next word.
+  for (int i = 0; i < 4; i++)
+    memcpy(out + i * 3, reinterpret_cast<const uint8_t*>(&v) + i * 4, 4);
+}
+
+// Decode whole groups of four characters with the table, until fewer than
+// four are left.  |*invalid| gets bit 7 set for characters that aren't base64.
+inline void DecodeGroups(const uint8_t* in, size_t len, size_t* i,
+                         uint8_t** out, uint32_t* invalid) {
+  for (; len - *i >= 4; *i += 4) {
+    uint32_t a = kDecodeTable[in[*i]];
+    uint32_t b = kDecodeTable[in[*i + 1]];
+    uint32_t c = kDecodeTable[in[*i + 2]];
+    uint32_t d = kDecodeTable[in[*i + 3]];
+    *invalid |= a | b | c | d;
+    uint32_t value = a << 18 | b << 12 | c << 6 | d;
+    *(*out)++ = value >> 16;
+    *(*out)++ = value >> 8;
+    *(*out)++ = value;
+  }
+}
+
+ssize_t Decode(const char* src, size_t len, char* dst, bool vector) {
+  const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+  uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+
+  if (len % 4 == 0 && len && in[len - 1] == '=') {
+    len--;
+    if (in[len - 1] == '=')
+      len--;
+  }
+
+  // Invalid characters are only checked for at the end, so the loops have no
+  // branches besides their conditions.
+  uint32_t invalid = 0;
+  size_t i = 0;
+  if (vector) {
+    // The byte written past each block is within the slack that
+    // Base64DecodedSize() leaves, and is overwritten by the next block or
+    // the groups after it.
+    U8x16 invalid_lanes = {};
+    for (; len - i >= 16; i += 16, out += 12)
+      DecodeBlock16(in + i, out, &invalid_lanes);
+    U32x4 words = (U32x4)invalid_lanes;
+    if (words[0] | words[1] | words[2] | words[3])
+      return -1;
+  }
+  DecodeGroups(in, len, &i, &out, &invalid);
+
+
+  // The last group may have two or three characters.
+  size_t rest = len - i;
+  if (rest == 1)
+    return -1;
+  if (rest) {
+    uint32_t a = kDecodeTable[in[i]];
+    uint32_t b = kDecodeTable[in[i + 1]];
+    uint32_t c = rest == 3 ? kDecodeTable[in[i + 2]] : 0;
+    invalid |= a | b | c;
+    uint32_t value = a << 18 | b << 12 | c << 6;
+    *out++ = value >> 16;
+    if (rest == 3)
+      *out++ = value >> 8;
+  }
+  if (invalid & 0x80)
+    return -1;
+
+  return out - reinterpret_cast<uint8_t*>(dst);
+}
+
+}  // namespace
+
+ssize_t Base64Decode(const char* src, size_t len, char* dst) {
+  return Decode(src, len, dst, true);
+}
+
+ssize_t Base64DecodeScalar(const char* src, size_t len, char* dst) {
+  return Decode(src, len, dst, false);
+}
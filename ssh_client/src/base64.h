@@ -0,0 +1,25 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE64_H
+#define BASE64_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Room Base64Decode() needs for decoding |len| characters.
+inline size_t Base64DecodedSize(size_t len) {
+  return len / 4 * 3 + 3;
+}
+
+// Decode the standard base64 in |src| into |dst|, which must have room for
+// Base64DecodedSize(|len|) bytes.  Padding is optional but whitespace isn't
+// allowed.  Return the number of bytes decoded, or -1 if |src| isn't valid.
+ssize_t Base64Decode(const char* src, size_t len, char* dst);
+
+// Base64Decode() without the vector loop over 16 characters at a time, for
+// comparing the two.
+ssize_t Base64DecodeScalar(const char* src, size_t len, char* dst);
+
+#endif  // BASE64_H
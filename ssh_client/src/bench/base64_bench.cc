@@ -0,0 +1,113 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Base64 input from JavaScript on its way into a stream's input queue: the
+// original b64_pton() into a fresh vector, Base64Decode() into a scratch buffer
+// that is then copied into the queue, and straight into the queue's free space
+// as JsFile::OnReadBase64 does it, with the table decoder alone and with the
+// vector loop.  Throughput is counted in decoded bytes.
+
+#include <resolv.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "base64.h"
+#include "bench.h"
+#include "ring_buffer.h"
+
+namespace {
+
+const size_t kTotalSize = 256 * 1024 * 1024;
+
+const char kAlphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+std::string Encode(const std::vector<char>& data) {
+  std::string out;
+  size_t i = 0;
+  for (; i + 3 <= data.size(); i += 3) {
+    uint32_t value = (uint8_t)data[i] << 16 | (uint8_t)data[i + 1] << 8 |
+                     (uint8_t)data[i + 2];
+    out += kAlphabet[value >> 18];
+    out += kAlphabet[(value >> 12) & 0x3f];
+    out += kAlphabet[(value >> 6) & 0x3f];
+    out += kAlphabet[value & 0x3f];
+  }
+  if (i < data.size()) {
+    uint32_t value = (uint8_t)data[i] << 16;
+    if (i + 1 < data.size())
+      value |= (uint8_t)data[i + 1] << 8;
+    out += kAlphabet[value >> 18];
+    out += kAlphabet[(value >> 12) & 0x3f];
+    out += i + 1 < data.size() ? kAlphabet[(value >> 6) & 0x3f] : '=';
+    out += '=';
+  }
+  return out;
+}
+
+void DecodeWithPton(const std::string& msg, RingBuffer* queue) {
+  std::vector<char> buf(msg.size() * 3 / 4);
+  int res = b64_pton(msg.c_str(), (unsigned char*)&buf[0], buf.size());
+  queue->Write(&buf[0], res);
+}
+
+void DecodeThroughScratch(const std::string& msg, RingBuffer* queue) {
+  static std::vector<char> buf;
+  buf.resize(Base64DecodedSize(msg.size()));
+  ssize_t res = Base64Decode(msg.data(), msg.size(), &buf[0]);
+  queue->Write(&buf[0], res);
+}
+
+void DecodeScalarIntoQueue(const std::string& msg, RingBuffer* queue) {
+  size_t max_count = Base64DecodedSize(msg.size());
+  size_t room;
+  char* buf = queue->WriteSpan(max_count, &room);
+  ssize_t res = Base64DecodeScalar(msg.data(), msg.size(), buf);
+  queue->Commit(res);
+}
+
+void DecodeIntoQueue(const std::string& msg, RingBuffer* queue) {
+  size_t max_count = Base64DecodedSize(msg.size());
+  size_t room;
+  char* buf = queue->WriteSpan(max_count, &room);
+  ssize_t res = Base64Decode(msg.data(), msg.size(), buf);
+  queue->Commit(res);
+}
+
+void Run(const char* name, size_t msg_size,
+         void (*decode)(const std::string&, RingBuffer*)) {
+  std::vector<char> data(msg_size);
+  srand(1);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = rand();
+  const std::string msg = Encode(data);
+
+  RingBuffer queue;
+  std::vector<char> out(msg_size);
+  int64_t start = NowNs();
+  for (size_t done = 0; done < kTotalSize; done += msg_size) {
+    decode(msg, &queue);
+    // The reader keeps up, so the queue never grows past one message.
+    queue.Read(&out[0], out.size());
+    DoNotOptimize(out[0]);
+  }
+  ReportMBps(name, NowNs() - start, kTotalSize);
+}
+
+}  // namespace
+
+int main() {
+  Run("1KiB messages, b64_pton (old)", 1024, &DecodeWithPton);
+  Run("1KiB messages, Base64Decode + copy", 1024, &DecodeThroughScratch);
+  Run("1KiB messages, scalar into queue", 1024, &DecodeScalarIntoQueue);
+  Run("1KiB messages, Base64Decode into queue", 1024, &DecodeIntoQueue);
+  Run("64KiB messages, b64_pton (old)", 64 * 1024, &DecodeWithPton);
+  Run("64KiB messages, Base64Decode + copy", 64 * 1024, &DecodeThroughScratch);
+  Run("64KiB messages, scalar into queue", 64 * 1024,
+      &DecodeScalarIntoQueue);
+  Run("64KiB messages, Base64Decode into queue", 64 * 1024, &DecodeIntoQueue);
+  return 0;
+}
@@ -0,0 +1,34 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Helpers shared by the host benchmarks.
+
+inline int64_t NowNs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Keep the compiler from optimizing away a result that is otherwise unused.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ReportNsPerOp(const char* name, int64_t ns, int64_t ops) {
+  printf("%-48s %10.1f ns/op\n", name, double(ns) / ops);
+}
+
+inline void ReportMBps(const char* name, int64_t ns, int64_t bytes) {
+  printf("%-48s %10.1f MB/s\n", name, bytes * 1e3 / ns);
+}
+
+#endif  // BENCH_BENCH_H
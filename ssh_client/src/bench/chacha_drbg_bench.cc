@@ -0,0 +1,64 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// The small reads OpenSSL and OpenSSH make from /dev/urandom, served straight
+// from the kernel the way the unbuffered DevRandomHandler asks the IRT for
+// every read, and from a ChaChaDrbg seeded from it.  getrandom() stands in for
+// the IRT here; the IRT call costs at least as much as the system call.
+
+#include <errno.h>
+#include <sys/random.h>
+
+#include "bench.h"
+#include "chacha_drbg.h"
+
+namespace {
+
+const size_t kTotalSize = 64 * 1024 * 1024;
+
+int GetRandomBytes(void* buf, size_t count, size_t* nread) {
+  ssize_t ret = getrandom(buf, count, 0);
+  if (ret < 0)
+    return errno;
+  *nread = ret;
+  return 0;
+}
+
+int ReadDirect(void* buf, size_t count) {
+  size_t nread;
+  return GetRandomBytes(buf, count, &nread);
+}
+
+ChaChaDrbg* g_drbg;
+
+int ReadDrbg(void* buf, size_t count) {
+  return g_drbg->Generate(buf, count);
+}
+
+void Run(const char* name, size_t read_size,
+         int (*read_random)(void*, size_t)) {
+  uint8_t buf[64];
+  int64_t start = NowNs();
+  for (size_t done = 0; done < kTotalSize; done += read_size) {
+    read_random(buf, read_size);
+    DoNotOptimize(buf[0]);
+  }
+  ReportMBps(name, NowNs() - start, kTotalSize);
+}
+
+}  // namespace
+
+int main() {
+  g_drbg = new ChaChaDrbg(&GetRandomBytes);
+
+  Run("16 byte reads, direct (old)", 16, &ReadDirect);
+  Run("16 byte reads, ChaChaDrbg", 16, &ReadDrbg);
+  Run("32 byte reads, direct (old)", 32, &ReadDirect);
+  Run("32 byte reads, ChaChaDrbg", 32, &ReadDrbg);
+  Run("64 byte reads, direct (old)", 64, &ReadDirect);
+  Run("64 byte reads, ChaChaDrbg", 64, &ReadDrbg);
+
+  delete g_drbg;
+  return 0;
+}
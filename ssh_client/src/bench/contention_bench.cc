@@ -0,0 +1,191 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Latency of small stdout writes from the OpenSSH thread while the main thread
+// delivers 64K reads to two TCP sockets and moves terminal data, once with the
+// per-stream locks and once with a single lock around everything, as all
+// syscalls and callbacks used to share FileSystem::mutex_.
+//
+// Every stream is a LocalPipe.  The OpenSSH thread uses one end through the
+// descriptor table and LockedStream like a syscall does, and the main thread
+// uses the other end under that stream's lock like a Pepper callback does.
+
+#include <pthread.h>
+#include <stdarg.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "bench.h"
+#include "file_descriptor_table.h"
+#include "local_pipe.h"
+#include "locked_stream.h"
+
+namespace {
+
+enum { kStdin, kStdout, kSocket1, kSocket2, kNumStreams };
+
+const int64_t kRunNs = 1000000000;
+const size_t kStdoutWriteSize = 128;
+const size_t kSocketReadSize = 64 * 1024;
+
+// Takes the global lock when modelling the old locking.
+class GlobalLock {
+ public:
+  explicit GlobalLock(Mutex* mutex) : mutex_(mutex) {
+    if (mutex_)
+      pthread_mutex_lock(mutex_->get());
+  }
+  ~GlobalLock() {
+    if (mutex_)
+      pthread_mutex_unlock(mutex_->get());
+  }
+
+ private:
+  Mutex* mutex_;
+};
+
+int Fcntl(FileStream* stream, int cmd, ...) {
+  va_list ap;
+  va_start(ap, cmd);
+  int ret = stream->fcntl(cmd, ap);
+  va_end(ap);
+  return ret;
+}
+
+class Session {
+ public:
+  explicit Session(bool global_lock)
+      : global_(global_lock ? &global_mutex_ : NULL), table_(0), done_(false),
+        socket_bytes_(0) {
+    for (int i = 0; i < kNumStreams; i++) {
+      LocalPipe* end;
+      LocalPipe::CreatePair(true, &end, &peer_[i]);
+      Fcntl(end, F_SETFL, O_NONBLOCK);
+      Fcntl(peer_[i], F_SETFL, O_NONBLOCK);
+      fds_[i] = table_.Allocate();
+      table_.Set(fds_[i], end);
+    }
+  }
+
+  ~Session() {
+    for (int i = 0; i < kNumStreams; i++) {
+      table_.Get(fds_[i])->release();
+      peer_[i]->release();
+    }
+  }
+
+  void Run(const char* name) {
+    pthread_t main_thread;
+    pthread_create(&main_thread, NULL, &Session::MainThread, this);
+    RunOpenSsh();
+    __sync_synchronize();
+    done_ = true;
+    pthread_join(main_thread, NULL);
+
+    std::sort(latencies_.begin(), latencies_.end());
+    printf("%s\n", name);
+    printf("  stdout writes %9zu/s, p50 %6.1f us, p99 %7.1f us, max %8.1f us\n",
+           latencies_.size(), latencies_[latencies_.size() / 2] / 1e3,
+           latencies_[latencies_.size() * 99 / 100] / 1e3,
+           latencies_.back() / 1e3);
+    printf("  socket reads  %9.1f MB/s\n", socket_bytes_ * 1e3 / kRunNs);
+  }
+
+ private:
+  // The FileSystem syscall path: find the stream under the table lock, then
+  // make the call holding only the stream's lock.
+  FileStream* GetStreamRef(int fd) {
+    Mutex::Lock lock(table_mutex_);
+    FileStream* stream = table_.Get(fd);
+    if (stream)
+      stream->addref();
+    return stream;
+  }
+
+  int Read(int fd, char* buf, size_t count, size_t* nread) {
+    GlobalLock global(global_);
+    LockedStream stream(GetStreamRef(fd));
+    return stream->read(buf, count, nread);
+  }
+
+  int Write(int fd, const char* buf, size_t count, size_t* nwrote) {
+    GlobalLock global(global_);
+    LockedStream stream(GetStreamRef(fd));
+    return stream->write(buf, count, nwrote);
+  }
+
+  // A Pepper callback only locks the stream it completes on.
+  int Deliver(int stream, const char* buf, size_t count) {
+    GlobalLock global(global_);
+    Mutex::Lock lock(peer_[stream]->mutex());
+    size_t nwrote;
+    return peer_[stream]->write(buf, count, &nwrote);
+  }
+
+  void Drain(int stream, char* buf, size_t count) {
+    GlobalLock global(global_);
+    Mutex::Lock lock(peer_[stream]->mutex());
+    size_t nread;
+    peer_[stream]->read(buf, count, &nread);
+  }
+
+  void RunOpenSsh() {
+    std::vector<char> buf(kSocketReadSize);
+    char line[kStdoutWriteSize];
+    memset(line, 'x', sizeof(line));
+    int64_t end = NowNs() + kRunNs;
+    while (NowNs() < end) {
+      size_t n;
+      if (!Read(fds_[kSocket1], &buf[0], buf.size(), &n))
+        socket_bytes_ += n;
+      if (!Read(fds_[kSocket2], &buf[0], buf.size(), &n))
+        socket_bytes_ += n;
+      Read(fds_[kStdin], &buf[0], buf.size(), &n);
+
+      int64_t start = NowNs();
+      while (Write(fds_[kStdout], line, sizeof(line), &n) == EAGAIN)
+        sched_yield();
+      latencies_.push_back(NowNs() - start);
+    }
+  }
+
+  static void* MainThread(void* arg) {
+    Session* session = static_cast<Session*>(arg);
+    std::vector<char> payload(kSocketReadSize, 'y');
+    std::vector<char> buf(kSocketReadSize);
+    while (!session->done_) {
+      session->Deliver(kSocket1, &payload[0], payload.size());
+      session->Deliver(kSocket2, &payload[0], payload.size());
+      session->Drain(kStdout, &buf[0], buf.size());
+      session->Deliver(kStdin, &payload[0], 16);
+      sched_yield();
+    }
+    return NULL;
+  }
+
+  Mutex global_mutex_;
+  Mutex* global_;
+  Mutex table_mutex_;
+  FileDescriptorTable table_;
+  int fds_[kNumStreams];
+  LocalPipe* peer_[kNumStreams];
+  volatile bool done_;
+  int64_t socket_bytes_;
+  std::vector<int64_t> latencies_;
+};
+
+}  // namespace
+
+int main() {
+  {
+    Session session(true);
+    session.Run("one global lock (old)");
+  }
+  {
+    Session session(false);
+    session.Run("per-stream locks");
+  }
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Cost of the descriptor table operations every syscall does, as the number
+// of open descriptors grows.  The old std::map table with its upward probe
+// for a free descriptor is measured alongside for comparison.
+
+#include <map>
+
+#include "bench.h"
+#include "file_descriptor_table.h"
+
+namespace {
+
+const int kFirstFd = 3;
+const int kOps = 1000000;
+
+// Pick pseudo-random open descriptors without calling into libc.
+struct Lcg {
+  explicit Lcg(uint32_t seed) : state(seed) {}
+  int Next(int n) {
+    state = state * 1664525 + 1013904223;
+    return kFirstFd + (state >> 8) % n;
+  }
+  uint32_t state;
+};
+
+// Close a random descriptor, reopen the lowest free one and look it up: what
+// close(), socket() and the following read() do.
+void BenchTable(int open_fds) {
+  FileDescriptorTable table(kFirstFd);
+  for (int i = 0; i < open_fds; i++)
+    table.Allocate();
+
+  Lcg lcg(open_fds);
+  int64_t start = NowNs();
+  for (int i = 0; i < kOps; i++) {
+    table.Remove(lcg.Next(open_fds));
+    int fd = table.Allocate();
+    DoNotOptimize(table.Get(fd));
+  }
+  int64_t ns = NowNs() - start;
+
+  char name[64];
+  snprintf(name, sizeof(name), "FileDescriptorTable, %d fds", open_fds);
+  ReportNsPerOp(name, ns, kOps);
+}
+
+// The same with the std::map the table replaced.
+void BenchMap(int open_fds) {
+  std::map<int, FileStream*> streams;
+  for (int i = 0; i < open_fds; i++)
+    streams[kFirstFd + i] = NULL;
+
+  Lcg lcg(open_fds);
+  int ops = kOps / 100;
+  int64_t start = NowNs();
+  for (int i = 0; i < ops; i++) {
+    streams.erase(lcg.Next(open_fds));
+    int fd = kFirstFd;
+    while (streams.find(fd) != streams.end())
+      fd++;
+    streams[fd] = NULL;
+    DoNotOptimize(streams.find(fd)->second);
+  }
+  int64_t ns = NowNs() - start;
+
+  char name[64];
+  snprintf(name, sizeof(name), "std::map (old), %d fds", open_fds);
+  ReportNsPerOp(name, ns, ops);
+}
+
+}  // namespace
+
+int main() {
+  const int kSizes[] = {16, 128, 1024, 8192};
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++)
+    BenchTable(kSizes[i]);
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++)
+    BenchMap(kSizes[i]);
+  return 0;
+}
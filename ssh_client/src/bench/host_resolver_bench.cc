@@ -0,0 +1,151 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Several threads looking up a handful of names, the way ssh does for
+// forwards, ProxyJump and each address family, with a fake backend that
+// answers after a fixed delay.  getaddrinfo() used to hold the file system
+// lock for the whole lookup and ask Pepper every time; HostResolver runs
+// queries in parallel, shares them between callers and caches the answers.
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "host_resolver.h"
+
+namespace {
+
+const int kThreads = 8;
+const int kLookupsPerThread = 200;
+const int kNames = 16;
+// Time the fake backend takes to answer.
+const int kLatencyUs = 1000;
+
+// Answers every query from its own thread after kLatencyUs.
+class FakeBackend : public HostResolver::Backend {
+ public:
+  FakeBackend() : queries_(0) {}
+
+  virtual void Resolve(HostResolver::Query* query) {
+    __sync_add_and_fetch(&queries_, 1);
+    pthread_t thread;
+    pthread_create(&thread, NULL, &Answer, query);
+    pthread_detach(thread);
+  }
+
+  int queries() { return queries_; }
+
+  static HostResolver::Result Lookup(const std::string& hostname) {
+    usleep(kLatencyUs);
+    HostResolver::Result result;
+    HostResolver::Address addr = {};
+    addr.family = AF_INET;
+    addr.v4.s_addr = htonl(0x0a000000 + hostname.size());
+    result.ok = true;
+    result.canonical_name = hostname;
+    result.addresses.push_back(addr);
+    return result;
+  }
+
+ private:
+  static void* Answer(void* arg) {
+    HostResolver::Query* query = static_cast<HostResolver::Query*>(arg);
+    query->Complete(Lookup(query->hostname()));
+    return NULL;
+  }
+
+  int queries_;
+};
+
+std::string Name(int i) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "host%d.example.com", i);
+  return buf;
+}
+
+// The old getaddrinfo(): one lock around a backend round trip per call.
+Mutex g_global_lock;
+int g_global_queries;
+
+void* GlobalLockThread(void* arg) {
+  long id = reinterpret_cast<long>(arg);
+  for (int i = 0; i < kLookupsPerThread; i++) {
+    Mutex::Lock lock(g_global_lock);
+    g_global_queries++;
+    HostResolver::Result result =
+        FakeBackend::Lookup(Name((id + i) % kNames));
+    DoNotOptimize(result.ok);
+  }
+  return NULL;
+}
+
+HostResolver* g_resolver;
+
+void* ResolverThread(void* arg) {
+  long id = reinterpret_cast<long>(arg);
+  for (int i = 0; i < kLookupsPerThread; i++) {
+    HostResolver::Result result;
+    g_resolver->Lookup(Name((id + i) % kNames), AF_UNSPEC, &result);
+    DoNotOptimize(result.ok);
+  }
+  return NULL;
+}
+
+// Every lookup is for a new name, so only running queries in parallel helps.
+void* ResolverUniqueThread(void* arg) {
+  long id = reinterpret_cast<long>(arg);
+  for (int i = 0; i < kLookupsPerThread; i++) {
+    HostResolver::Result result;
+    g_resolver->Lookup(Name(kNames + id * kLookupsPerThread + i), AF_UNSPEC,
+                       &result);
+    DoNotOptimize(result.ok);
+  }
+  return NULL;
+}
+
+void Run(const char* name, void* (*thread_main)(void*),
+         int (*queries)()) {
+  std::vector<pthread_t> threads(kThreads);
+  int64_t start = NowNs();
+  for (long i = 0; i < kThreads; i++)
+    pthread_create(&threads[i], NULL, thread_main, reinterpret_cast<void*>(i));
+  for (int i = 0; i < kThreads; i++)
+    pthread_join(threads[i], NULL);
+  int64_t ns = NowNs() - start;
+
+  ReportNsPerOp(name, ns, kThreads * kLookupsPerThread);
+  printf("%-48s %10d queries\n", "", queries());
+}
+
+FakeBackend* g_backend;
+
+int GlobalQueries() { return g_global_queries; }
+int ResolverQueries() {
+  static int previous;
+  int queries = g_backend->queries() - previous;
+  previous += queries;
+  return queries;
+}
+
+}  // namespace
+
+int main() {
+  g_backend = new FakeBackend();
+  g_resolver = new HostResolver(g_backend);
+
+  Run("8 threads x 16 names, global lock (old)", &GlobalLockThread,
+      &GlobalQueries);
+  Run("8 threads x 16 names, HostResolver", &ResolverThread,
+      &ResolverQueries);
+  Run("8 threads, unique names, HostResolver", &ResolverUniqueThread,
+      &ResolverQueries);
+
+  delete g_resolver;
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// `cat`ing a large file to the terminal, as far as the plugin's queues go: the
+// file is read out of PepperFile's input queue, written to stdout, and JsFile
+// hands its output queue to JavaScript a write window at a time.  The
+// std::deque<char> queues and the copy loops they needed are measured against
+// RingBuffer.
+
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "bench.h"
+#include "ring_buffer.h"
+
+namespace {
+
+const size_t kFileSize = 256 * 1024 * 1024;
+// What Pepper hands PepperFile per read, and what cat reads & writes per call.
+const size_t kFileReadSize = 64 * 1024;
+const size_t kCatBufSize = 128 * 1024;
+// JsFile's default write window.
+const size_t kWriteWindow = 64 * 1024;
+
+// The file being read, and the buffer JavaScript gets the output in.
+std::vector<char> g_chunk(kFileReadSize, 'x');
+std::vector<char> g_js_buf(kWriteWindow);
+
+void CatWithDeque() {
+  std::deque<char> file_in;
+  std::deque<char> tty_out;
+  std::vector<char> buf(kCatBufSize);
+
+  for (size_t done = 0; done < kFileSize; ) {
+    // PepperFile::Read callback.
+    file_in.insert(file_in.end(), g_chunk.begin(), g_chunk.end());
+
+    // PepperFile::read drained the queue a byte at a time.
+    size_t nread = 0;
+    while (nread < buf.size() && !file_in.empty()) {
+      buf[nread++] = file_in.front();
+      file_in.pop_front();
+    }
+    done += nread;
+
+    // JsFile::write queued the data ...
+    tty_out.insert(tty_out.end(), buf.begin(), buf.begin() + nread);
+
+    // ... and JsFile::Write copied a window out through a temporary vector.
+    while (!tty_out.empty()) {
+      size_t count = std::min(kWriteWindow, tty_out.size());
+      std::vector<char> tmp(tty_out.begin(), tty_out.begin() + count);
+      memcpy(&g_js_buf[0], &tmp[0], count);
+      tty_out.erase(tty_out.begin(), tty_out.begin() + count);
+    }
+    DoNotOptimize(g_js_buf[0]);
+  }
+}
+
+void CatWithRingBuffer() {
+  RingBuffer file_in;
+  RingBuffer tty_out;
+  std::vector<char> buf(kCatBufSize);
+
+  for (size_t done = 0; done < kFileSize; ) {
+    file_in.Write(&g_chunk[0], g_chunk.size());
+
+    size_t nread = file_in.Read(&buf[0], buf.size());
+    done += nread;
+
+    tty_out.Write(&buf[0], nread);
+
+    while (!tty_out.empty()) {
+      size_t count = std::min(kWriteWindow, tty_out.size());
+      tty_out.Peek(&g_js_buf[0], count);
+      tty_out.Consume(count);
+    }
+    DoNotOptimize(g_js_buf[0]);
+  }
+}
+
+void Run(const char* name, void (*cat)()) {
+  int64_t start = NowNs();
+  cat();
+  ReportMBps(name, NowNs() - start, kFileSize);
+}
+
+}  // namespace
+
+int main() {
+  Run("cat 256MiB, std::deque<char> (old)", &CatWithDeque);
+  Run("cat 256MiB, RingBuffer", &CatWithRingBuffer);
+  return 0;
+}
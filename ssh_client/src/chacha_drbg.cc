@@ -0,0 +1,162 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chacha_drbg.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+uint32_t Load32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void Store32(uint8_t* p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+uint32_t Rotl32(uint32_t v, int n) {
+  return (v << n) | (v >> (32 - n));
+}
+
+#define QUARTERROUND(a, b, c, d) \
+  a += b; d = Rotl32(d ^ a, 16); \
+  c += d; b = Rotl32(b ^ c, 12); \
+  a += b; d = Rotl32(d ^ a, 8);  \
+  c += d; b = Rotl32(b ^ c, 7)
+
+// Write the ChaCha20 block |counter| of |key| and |nonce| to |out|.  This is
+// the original variant with a 64-bit counter and a 64-bit nonce.
+void ChaCha20Block(const uint8_t* key, const uint8_t* nonce, uint64_t counter,
+                   uint8_t* out) {
+  uint32_t input[16] = {
+    0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+    Load32(key), Load32(key + 4), Load32(key + 8), Load32(key + 12),
+    Load32(key + 16), Load32(key + 20), Load32(key + 24), Load32(key + 28),
+    (uint32_t)counter, (uint32_t)(counter >> 32),
+    Load32(nonce), Load32(nonce + 4),
+  };
+  uint32_t x[16];
+  memcpy(x, input, sizeof(x));
+  for (int i = 0; i < 10; i++) {
+    QUARTERROUND(x[0], x[4], x[8], x[12]);
+    QUARTERROUND(x[1], x[5], x[9], x[13]);
+    QUARTERROUND(x[2], x[6], x[10], x[14]);
+    QUARTERROUND(x[3], x[7], x[11], x[15]);
+    QUARTERROUND(x[0], x[5], x[10], x[15]);
+    QUARTERROUND(x[1], x[6], x[11], x[12]);
+    QUARTERROUND(x[2], x[7], x[8], x[13]);
+    QUARTERROUND(x[3], x[4], x[9], x[14]);
+  }
+  for (int i = 0; i < 16; i++)
+    Store32(out + 4 * i, x[i] + input[i]);
+}
+
+#undef QUARTERROUND
+
+pthread_once_t g_fork_handler_once = PTHREAD_ONCE_INIT;
+
+void RegisterForkHandler() {
+#if defined(__GLIBC__)
+  pthread_atfork(NULL, NULL, &ChaChaDrbg::OnFork);
+#endif
+  // newlib has no fork(), and the plugin's own fork() never makes a child.
+}
+
+}  // namespace
+
+const size_t ChaChaDrbg::kKeySize;
+const size_t ChaChaDrbg::kNonceSize;
+const size_t ChaChaDrbg::kBlockSize;
+const size_t ChaChaDrbg::kBufferBlocks;
+const size_t ChaChaDrbg::kReseedBytes;
+
+unsigned int ChaChaDrbg::fork_generation_ = 0;
+
+ChaChaDrbg::ChaChaDrbg(GetRandomBytes get_random_bytes)
+    : get_random_bytes_(get_random_bytes), seeded_(false), generation_(0),
+      since_reseed_(0), available_(0) {
+  memset(key_, 0, sizeof(key_));
+  memset(buf_, 0, sizeof(buf_));
+  pthread_once(&g_fork_handler_once, &RegisterForkHandler);
+}
+
+ChaChaDrbg::~ChaChaDrbg() {
+  memset(key_, 0, sizeof(key_));
+  memset(buf_, 0, sizeof(buf_));
+}
+
+int ChaChaDrbg::Generate(void* buf, size_t count) {
+  Mutex::Lock lock(mutex_);
+  if (!seeded_ || generation_ != fork_generation_ ||
+      since_reseed_ >= kReseedBytes) {
+    int err = Reseed();
+    if (err)
+      return err;
+  }
+  since_reseed_ += count;
+
+  uint8_t* out = static_cast<uint8_t*>(buf);
+  while (count) {
+    if (!available_)
+      Refill();
+    size_t n = std::min(count, available_);
+    uint8_t* p = buf_ + sizeof(buf_) - available_;
+    memcpy(out, p, n);
+    memset(p, 0, n);
+    available_ -= n;
+    out += n;
+    count -= n;
+  }
+  return 0;
+}
+
+void ChaChaDrbg::OnFork() {
+  __sync_add_and_fetch(&fork_generation_, 1);
+}
+
+int ChaChaDrbg::Reseed() {
+  uint8_t seed[sizeof(key_)];
+  size_t got = 0;
+  while (got < sizeof(seed)) {
+    size_t n;
+    int err = get_random_bytes_(seed + got, sizeof(seed) - got, &n);
+    if (err)
+      return err;
+    if (!n)
+      return EIO;
+    got += n;
+  }
+
+  // Mix rather than replace, so a bad seed can't make the state worse.
+  for (size_t i = 0; i < sizeof(key_); i++)
+    key_[i] ^= seed[i];
+  memset(seed, 0, sizeof(seed));
+
+  // Drop whatever was generated from the old key.
+  memset(buf_, 0, sizeof(buf_));
+  available_ = 0;
+  Refill();
+
+  seeded_ = true;
+  generation_ = fork_generation_;
+  since_reseed_ = 0;
+  return 0;
+}
+
+void ChaChaDrbg::Refill() {
+  for (size_t i = 0; i < kBufferBlocks; i++)
+    ChaCha20Block(key_, key_ + kKeySize, i, buf_ + i * kBlockSize);
+
+  memcpy(key_, buf_, sizeof(key_));
+  memset(buf_, 0, sizeof(key_));
+  available_ = sizeof(buf_) - sizeof(key_);
+}
@@ -0,0 +1,65 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHACHA_DRBG_H
+#define CHACHA_DRBG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pthread_helpers.h"
+
+// A random number generator that stretches entropy from the IRT with ChaCha20,
+// so that the many small reads of OpenSSL and OpenSSH don't each have to go
+// to the IRT.
+//
+// Output is generated a buffer at a time, and the start of every buffer
+// becomes the next key and nonce ("fast key erasure"), so output that was
+// already handed out can't be reconstructed from the state.  Bytes are wiped
+// from the buffer as they are handed out.  Fresh entropy is mixed into the key
+// after every kReseedBytes of output, and after OnFork() so that a forked child
+// doesn't repeat its parent's output.
+class ChaChaDrbg {
+ public:
+  typedef int (*GetRandomBytes)(void* buf, size_t count, size_t* nread);
+
+  explicit ChaChaDrbg(GetRandomBytes get_random_bytes);
+  ~ChaChaDrbg();
+
+  // Fill |buf| with |count| random bytes.  Return 0 or an errno value if the
+  // IRT couldn't provide entropy.  Safe to call from any thread.
+  int Generate(void* buf, size_t count);
+
+  // Make all generators reseed before their next output.  Registered with
+  // pthread_atfork() to run in the child when the first generator is created.
+  static void OnFork();
+
+ private:
+  static const size_t kKeySize = 32;
+  static const size_t kNonceSize = 8;
+  static const size_t kBlockSize = 64;
+  static const size_t kBufferBlocks = 16;
+  static const size_t kReseedBytes = 1024 * 1024;
+
+  int Reseed();
+  void Refill();
+
+  static unsigned int fork_generation_;
+
+  GetRandomBytes get_random_bytes_;
+  Mutex mutex_;
+  bool seeded_;
+  // Value of |fork_generation_| when last seeded.
+  unsigned int generation_;
+  size_t since_reseed_;
+  // Key followed by nonce.
+  uint8_t key_[kKeySize + kNonceSize];
+  uint8_t buf_[kBlockSize * kBufferBlocks];
+  // Unused bytes at the end of |buf_|.
+  size_t available_;
+
+  DISALLOW_COPY_AND_ASSIGN(ChaChaDrbg);
+};
+
+#endif  // CHACHA_DRBG_H
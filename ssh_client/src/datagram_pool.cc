@@ -0,0 +1,68 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "datagram_pool.h"
+
+#include <stdlib.h>
+
+namespace {
+
+// Slots are aligned like malloc() results so the headers can live in them.
+const size_t kSlotStride =
+    (sizeof(Datagram) + DatagramPool::kSlotSize + 15) & ~15;
+
+}  // namespace
+
+const size_t DatagramPool::kSlotSize;
+const size_t DatagramPool::kSlotsPerSlab;
+
+DatagramPool::DatagramPool() : free_(NULL) {
+}
+
+DatagramPool::~DatagramPool() {
+  for (size_t i = 0; i < slabs_.size(); i++)
+    free(slabs_[i]);
+}
+
+Datagram* DatagramPool::Alloc(size_t size) {
+  Datagram* datagram;
+  if (size > kSlotSize) {
+    datagram = static_cast<Datagram*>(malloc(sizeof(Datagram) + size));
+    if (!datagram)
+      return NULL;
+    datagram->capacity = size;
+  } else {
+    if (!free_ && !AddSlab())
+      return NULL;
+    datagram = free_;
+    free_ = datagram->next;
+  }
+  datagram->size = 0;
+  datagram->next = NULL;
+  return datagram;
+}
+
+void DatagramPool::Free(Datagram* datagram) {
+  if (datagram->capacity > kSlotSize) {
+    free(datagram);
+    return;
+  }
+  datagram->next = free_;
+  free_ = datagram;
+}
+
+bool DatagramPool::AddSlab() {
+  char* slab = static_cast<char*>(malloc(kSlotStride * kSlotsPerSlab));
+  if (!slab)
+    return false;
+  slabs_.push_back(slab);
+
+  for (size_t i = 0; i < kSlotsPerSlab; i++) {
+    Datagram* datagram = reinterpret_cast<Datagram*>(slab + i * kSlotStride);
+    datagram->capacity = kSlotSize;
+    datagram->next = free_;
+    free_ = datagram;
+  }
+  return true;
+}
@@ -0,0 +1,95 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef DATAGRAM_POOL_H
+#define DATAGRAM_POOL_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include "pthread_helpers.h"
+
+// A datagram and its peer address.  The payload follows the header in the
+// same allocation.
+struct Datagram {
+  char* data() { return reinterpret_cast<char*>(this + 1); }
+
+  sockaddr_in6 addr;
+  // Bytes of payload and room for them.
+  size_t size;
+  size_t capacity;
+  // Link in a DatagramQueue or the pool's free list.
+  Datagram* next;
+};
+
+// Hands out datagrams from slabs of MTU sized slots, so queueing a packet
+// doesn't allocate anything once the slabs are in place.  Datagrams larger
+// than a slot get an allocation of their own.
+class DatagramPool {
+ public:
+  // Room for a full Ethernet frame's payload.
+  static const size_t kSlotSize = 2048;
+  static const size_t kSlotsPerSlab = 32;
+
+  DatagramPool();
+  ~DatagramPool();
+
+  // Return a datagram with room for |size| bytes, or NULL if out of memory.
+  Datagram* Alloc(size_t size);
+  void Free(Datagram* datagram);
+
+ private:
+  bool AddSlab();
+
+  std::vector<char*> slabs_;
+  Datagram* free_;
+
+  DISALLOW_COPY_AND_ASSIGN(DatagramPool);
+};
+
+// A FIFO of datagrams that keeps track of the payload bytes it holds.
+class DatagramQueue {
+ public:
+  DatagramQueue() : head_(NULL), tail_(NULL), bytes_(0) {}
+
+  bool empty() const { return head_ == NULL; }
+  size_t bytes() const { return bytes_; }
+  Datagram* front() { return head_; }
+
+  void PushBack(Datagram* datagram) {
+    datagram->next = NULL;
+    if (tail_)
+      tail_->next = datagram;
+    else
+      head_ = datagram;
+    tail_ = datagram;
+    bytes_ += datagram->size;
+  }
+
+  Datagram* PopFront() {
+    Datagram* datagram = head_;
+    head_ = datagram->next;
+    if (!head_)
+      tail_ = NULL;
+    bytes_ -= datagram->size;
+    return datagram;
+  }
+
+  // Return all datagrams to |pool|.
+  void Clear(DatagramPool* pool) {
+    while (!empty())
+      pool->Free(PopFront());
+  }
+
+ private:
+  Datagram* head_;
+  Datagram* tail_;
+  size_t bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(DatagramQueue);
+};
+
+#endif  // DATAGRAM_POOL_H
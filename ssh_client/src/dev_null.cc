@@ -15,11 +15,11 @@ DevNullHandler::~DevNullHandler() {
 }
 
 void DevNullHandler::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void DevNullHandler::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -44,11 +44,11 @@ DevNull::~DevNull() {
 }
 
 void DevNull::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void DevNull::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
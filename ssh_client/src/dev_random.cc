@@ -9,27 +9,31 @@
 #include <string.h>
 
 DevRandomHandler::DevRandomHandler(
-    int (*get_random_bytes)(void* buf, size_t count, size_t* nread))
-    : ref_(1), get_random_bytes_(get_random_bytes) {
+    int (*get_random_bytes)(void* buf, size_t count, size_t* nread),
+    Mode mode)
+    : ref_(1), get_random_bytes_(get_random_bytes), drbg_(NULL) {
   assert(get_random_bytes);
+  if (mode == kBuffered)
+    drbg_ = new ChaChaDrbg(get_random_bytes);
 }
 
 DevRandomHandler::~DevRandomHandler() {
   assert(!ref_);
+  delete drbg_;
 }
 
 void DevRandomHandler::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void DevRandomHandler::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
 FileStream* DevRandomHandler::open(int fd, const char* pathname, int oflag,
                                    int* err) {
-  return new DevRandom(fd, oflag, get_random_bytes_);
+  return new DevRandom(fd, oflag, this);
 }
 
 int DevRandomHandler::stat(const char* pathname, nacl_abi_stat* out) {
@@ -37,28 +41,38 @@ int DevRandomHandler::stat(const char* pathname, nacl_abi_stat* out) {
   return 0;
 }
 
+int DevRandomHandler::Read(char* buf, size_t count, size_t* nread) {
+  if (!drbg_)
+    return get_random_bytes_(buf, count, nread);
+
+  int err = drbg_->Generate(buf, count);
+  *nread = err ? 0 : count;
+  return err;
+}
+
 //------------------------------------------------------------------------------
 
-DevRandom::DevRandom(int fd, int oflag,
-    int (*get_random_bytes)(void* buf, size_t count, size_t* nread))
-  : fd_(fd), oflag_(oflag), ref_(1), get_random_bytes_(get_random_bytes) {
+DevRandom::DevRandom(int fd, int oflag, DevRandomHandler* handler)
+  : fd_(fd), oflag_(oflag), ref_(1), handler_(handler) {
+  handler_->addref();
 }
 
 DevRandom::~DevRandom() {
   assert(!ref_);
+  handler_->release();
 }
 
 void DevRandom::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void DevRandom::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
 FileStream* DevRandom::dup(int fd) {
-  return new DevRandom(fd, oflag_, get_random_bytes_);
+  return new DevRandom(fd, oflag_, handler_);
 }
 
 void DevRandom::close() {
@@ -66,7 +80,7 @@ void DevRandom::close() {
 }
 
 int DevRandom::read(char* buf, size_t count, size_t* nread) {
-  return get_random_bytes_(buf, count, nread);
+  return handler_->Read(buf, count, nread);
 }
 
 int DevRandom::write(const char* buf, size_t count, size_t* nwrote) {
@@ -5,13 +5,22 @@
 #ifndef DEV_RANDOM_H
 #define DEV_RANDOM_H
 
+#include "chacha_drbg.h"
 #include "file_interfaces.h"
 #include "pthread_helpers.h"
 
 class DevRandomHandler : public PathHandler {
  public:
+  enum Mode {
+    // Every read goes to |get_random_bytes|.
+    kDirect,
+    // Reads are served by a ChaChaDrbg seeded from |get_random_bytes|.
+    kBuffered,
+  };
+
   DevRandomHandler(
-      int (*get_random_bytes)(void* buf, size_t count, size_t* nread));
+      int (*get_random_bytes)(void* buf, size_t count, size_t* nread),
+      Mode mode);
   virtual ~DevRandomHandler();
 
   virtual void addref();
@@ -20,17 +29,21 @@ class DevRandomHandler : public PathHandler {
   virtual FileStream* open(int fd, const char* pathname, int oflag, int* err);
   virtual int stat(const char* pathname, nacl_abi_stat* out);
 
+  // Fill |buf| with random bytes.  Return 0 or an errno value.
+  int Read(char* buf, size_t count, size_t* nread);
+
  private:
   int ref_;
   int (*get_random_bytes_)(void* buf, size_t count, size_t* nread);
+  // NULL in kDirect mode.
+  ChaChaDrbg* drbg_;
 
   DISALLOW_COPY_AND_ASSIGN(DevRandomHandler);
 };
 
 class DevRandom : public FileStream {
  public:
-  DevRandom(int fd, int oflag,
-            int (*get_random_bytes)(void* buf, size_t count, size_t* nread));
+  DevRandom(int fd, int oflag, DevRandomHandler* handler);
   virtual ~DevRandom();
 
   virtual void addref();
@@ -48,7 +61,7 @@ class DevRandom : public FileStream {
   int fd_;
   int oflag_;
   int ref_;
-  int (*get_random_bytes_)(void* buf, size_t count, size_t* nread);
+  DevRandomHandler* handler_;
 
   DISALLOW_COPY_AND_ASSIGN(DevRandom);
 };
@@ -0,0 +1,106 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "fake_address_pool.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+
+#include <algorithm>
+
+FakeAddressPool::FakeAddressPool(size_t max_entries)
+    : max_entries_(std::min<size_t>(max_entries, kPoolSize - kFirstIndex)),
+      next_index_(kFirstIndex) {
+}
+
+FakeAddressPool::~FakeAddressPool() {
+}
+
+bool FakeAddressPool::Contains(uint32_t addr) {
+  uint32_t index = ntohl(addr);
+  return index >= kFirstIndex && index < kPoolSize;
+}
+
+bool FakeAddressPool::Get(const std::string& name, uint32_t* addr) {
+  NameMap::iterator it = by_name_.find(name);
+  if (it != by_name_.end()) {
+    Touch(by_index_.find(it->second));
+    *addr = htonl(it->second);
+    return true;
+  }
+
+  // Like wassh, fail rather than grow once every mapping is in use.
+  if (by_index_.size() >= max_entries_ && !Evict())
+    return false;
+
+  uint32_t index = AllocateIndex();
+  assert(index);
+
+  Entry& entry = by_index_[index];
+  entry.name = name;
+  entry.refs = 0;
+  lru_.push_front(index);
+  entry.lru = lru_.begin();
+  by_name_[name] = index;
+
+  *addr = htonl(index);
+  return true;
+}
+
+bool FakeAddressPool::Lookup(uint32_t addr, std::string* name) {
+  IndexMap::iterator it = by_index_.find(ntohl(addr));
+  if (it == by_index_.end())
+    return false;
+
+  Touch(it);
+  *name = it->second.name;
+  return true;
+}
+
+void FakeAddressPool::Ref(uint32_t addr) {
+  IndexMap::iterator it = by_index_.find(ntohl(addr));
+  if (it != by_index_.end())
+    it->second.refs++;
+}
+
+void FakeAddressPool::Unref(uint32_t addr) {
+  IndexMap::iterator it = by_index_.find(ntohl(addr));
+  if (it != by_index_.end()) {
+    assert(it->second.refs > 0);
+    it->second.refs--;
+  }
+}
+
+void FakeAddressPool::Touch(IndexMap::iterator it) {
+  assert(it != by_index_.end());
+  lru_.splice(lru_.begin(), lru_, it->second.lru);
+}
+
+bool FakeAddressPool::Evict() {
+  for (LruList::reverse_iterator rit = lru_.rbegin(); rit != lru_.rend();
+       ++rit) {
+    IndexMap::iterator it = by_index_.find(*rit);
+    if (it->second.refs)
+      continue;
+
+    by_name_.erase(it->second.name);
+    lru_.erase(it->second.lru);
+    by_index_.erase(it);
+    return true;
+  }
+  return false;
+}
+
+uint32_t FakeAddressPool::AllocateIndex() {
+  // Fewer than |max_entries_| indexes are in use, so one of the next
+  // size() + 1 is free.
+  for (size_t i = 0; i <= by_index_.size(); i++) {
+    uint32_t index = next_index_++;
+    if (next_index_ == kPoolSize)
+      next_index_ = kFirstIndex;
+    if (!by_index_.count(index))
+      return index;
+  }
+  return 0;
+}
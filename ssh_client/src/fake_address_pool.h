@@ -0,0 +1,84 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FAKE_ADDRESS_POOL_H
+#define FAKE_ADDRESS_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "pthread_helpers.h"
+
+// Hands out addresses in 0.0.0.0/8 that stand in for host names which are
+// resolved later, when a socket connects to them.
+//
+// Names and addresses are indexed by hash in both directions.  Every address
+// of the /8 is used once before any is reused, and only the mappings that
+// were used least recently and have no connected sockets are dropped, once
+// more than |max_entries| are kept.
+class FakeAddressPool {
+ public:
+  explicit FakeAddressPool(size_t max_entries = kDefaultMaxEntries);
+  ~FakeAddressPool();
+
+  // Whether |addr| (network order) is in the pool's range.
+  static bool Contains(uint32_t addr);
+
+  // Return the address for |name| in |*addr|, in network order, allocating
+  // one if needed.  Return false if |max_entries| mappings are kept and all
+  // of them are referenced.
+  bool Get(const std::string& name, uint32_t* addr);
+
+  // Look up the name behind |addr|.
+  bool Lookup(uint32_t addr, std::string* name);
+
+  // A mapping isn't dropped while a socket holds a reference to it.
+  void Ref(uint32_t addr);
+  void Unref(uint32_t addr);
+
+  size_t size() const { return by_index_.size(); }
+
+ private:
+  typedef std::list<uint32_t> LruList;
+
+  struct Entry {
+    std::string name;
+    int refs;
+    // Position in |lru_|.
+    LruList::iterator lru;
+  };
+
+  typedef std::unordered_map<std::string, uint32_t> NameMap;
+  typedef std::unordered_map<uint32_t, Entry> IndexMap;
+
+  // Mark |it| as just used.
+  void Touch(IndexMap::iterator it);
+  // Drop the least recently used idle mapping.  Return false if there is
+  // none.
+  bool Evict();
+  // Return an unused index.  There must be fewer than |max_entries_|.
+  uint32_t AllocateIndex();
+
+  static const size_t kDefaultMaxEntries = 4096;
+  // Index 0 would be 0.0.0.0, which means "any address".
+  static const uint32_t kFirstIndex = 1;
+  static const uint32_t kPoolSize = 1 << 24;
+
+  size_t max_entries_;
+  NameMap by_name_;
+  IndexMap by_index_;
+  // Indexes of all mappings, most recently used first.
+  LruList lru_;
+  // Where to look for an unused index next.  It goes through the pool in
+  // order, so an index is reused only after all others were handed out.
+  uint32_t next_index_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeAddressPool);
+};
+
+#endif  // FAKE_ADDRESS_POOL_H
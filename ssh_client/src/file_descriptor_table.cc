@@ -0,0 +1,65 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "file_descriptor_table.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+FileDescriptorTable::FileDescriptorTable(int first_fd)
+    : first_fd_(first_fd), free_hint_(first_fd / kBitsPerWord) {
+  assert(first_fd >= 0);
+}
+
+FileDescriptorTable::~FileDescriptorTable() {
+}
+
+void FileDescriptorTable::Grow(size_t fd) {
+  if (fd < streams_.size())
+    return;
+
+  // Grow by whole words so every slot has a bit in |used_|.
+  size_t words = fd / kBitsPerWord + 1;
+  words = std::max(words, used_.size() * 2);
+  used_.resize(words, 0);
+  streams_.resize(words * kBitsPerWord, NULL);
+}
+
+int FileDescriptorTable::Allocate() {
+  size_t word = free_hint_;
+  for (; word < used_.size(); word++) {
+    uint32_t used = used_[word];
+    // Descriptors below |first_fd_| are never handed out here.
+    if (word == size_t(first_fd_ / kBitsPerWord))
+      used |= (1U << (first_fd_ % kBitsPerWord)) - 1;
+    if (used != ~0U) {
+      int fd = word * kBitsPerWord + __builtin_ctz(~used);
+      free_hint_ = word;
+      Set(fd, NULL);
+      return fd;
+    }
+  }
+
+  // Every slot is used; the first one past the end is the lowest free one.
+  int fd = std::max(size_t(first_fd_), used_.size() * kBitsPerWord);
+  free_hint_ = fd / kBitsPerWord;
+  Set(fd, NULL);
+  return fd;
+}
+
+void FileDescriptorTable::Set(int fd, FileStream* stream) {
+  assert(fd >= 0);
+  Grow(fd);
+  streams_[fd] = stream;
+  used_[fd / kBitsPerWord] |= 1U << (fd % kBitsPerWord);
+}
+
+void FileDescriptorTable::Remove(int fd) {
+  assert(IsUsed(fd));
+  streams_[fd] = NULL;
+  used_[fd / kBitsPerWord] &= ~(1U << (fd % kBitsPerWord));
+  if (fd >= first_fd_ && size_t(fd / kBitsPerWord) < free_hint_)
+    free_hint_ = fd / kBitsPerWord;
+}
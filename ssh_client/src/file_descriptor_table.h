@@ -0,0 +1,72 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef FILE_DESCRIPTOR_TABLE_H
+#define FILE_DESCRIPTOR_TABLE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "file_interfaces.h"
+#include "pthread_helpers.h"
+
+// Maps file descriptors to streams.
+//
+// Descriptors are small dense integers, so streams are kept in a vector indexed
+// by fd.  A bitmap of used slots lets Allocate() find the lowest unused
+// descriptor a word at a time instead of probing every fd, and a hint of the
+// first word that may have a free slot keeps that constant time in the common
+// case where low descriptors stay open.
+//
+// A slot can be used but hold no stream yet: socket() reserves a descriptor
+// that only gets its stream in connect() or bind().
+class FileDescriptorTable {
+ public:
+  // Descriptors at or above this are never valid, so that a caller-chosen
+  // descriptor can't make the table allocate without bound.
+  static const int kMaxFds = 4096;
+
+  // Descriptors below |first_fd| are only handed out explicitly via Set().
+  explicit FileDescriptorTable(int first_fd);
+  ~FileDescriptorTable();
+
+  // Reserve the lowest unused descriptor that is >= first_fd.
+  int Allocate();
+
+  // Mark |fd| as used and associate it with |stream|, which may be NULL to
+  // just reserve the descriptor.  Ownership of the reference is taken.
+  void Set(int fd, FileStream* stream);
+
+  // Release |fd| so it can be allocated again.  Does not release the stream.
+  void Remove(int fd);
+
+  bool IsUsed(int fd) const {
+    return fd >= 0 && size_t(fd) < streams_.size() &&
+           (used_[fd / kBitsPerWord] & (1U << (fd % kBitsPerWord)));
+  }
+
+  FileStream* Get(int fd) const {
+    return IsUsed(fd) ? streams_[fd] : NULL;
+  }
+
+  // One past the highest descriptor that may be in use.
+  int size() const { return streams_.size(); }
+
+ private:
+  static const int kBitsPerWord = 32;
+
+  void Grow(size_t fd);
+
+  const int first_fd_;
+  std::vector<FileStream*> streams_;
+  std::vector<uint32_t> used_;
+  // Index into |used_| of the first word that may have a free slot at or
+  // above |first_fd_|.
+  size_t free_hint_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileDescriptorTable);
+};
+
+#endif  // FILE_DESCRIPTOR_TABLE_H
@@ -9,13 +9,16 @@
 #include <fcntl.h>
 #include <sys/dir.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <stdarg.h>
 #include <string.h>
 #include <termios.h>
 #include <unistd.h>
 
 #include "nacl-mounts/base/nacl_stat.h"
+#include "pthread_helpers.h"
 
 class FileStream {
  public:
@@ -28,6 +31,52 @@ class FileStream {
   virtual void close() = 0;
   virtual int read(char* buf, size_t count, size_t* nread) = 0;
   virtual int write(const char* buf, size_t count, size_t* nwrote) = 0;
+  // Vectored read() and write().  These fall back to one call per segment,
+  // stopping at the first short one; streams that queue data override them
+  // to move all segments at once.
+  virtual int readv(const iovec* iov, int iovcnt, size_t* nread) {
+    *nread = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      size_t n;
+      int err = read(static_cast<char*>(iov[i].iov_base), iov[i].iov_len, &n);
+      if (err)
+        return *nread ? 0 : err;
+      *nread += n;
+      if (n < iov[i].iov_len)
+        break;
+    }
+    return 0;
+  }
+  virtual int writev(const iovec* iov, int iovcnt, size_t* nwrote) {
+    *nwrote = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      size_t n;
+      int err = write(static_cast<const char*>(iov[i].iov_base),
+                      iov[i].iov_len, &n);
+      if (err)
+        return *nwrote ? 0 : err;
+      *nwrote += n;
+      if (n < iov[i].iov_len)
+        break;
+    }
+    return 0;
+  }
+  // Positioned read() and write() that leave the file offset alone.
+  virtual int pread(char* buf, size_t count, nacl_abi_off_t offset,
+                    size_t* nread) {
+    return ESPIPE;
+  }
+  virtual int pwrite(const char* buf, size_t count, nacl_abi_off_t offset,
+                     size_t* nwrote) {
+    return ESPIPE;
+  }
+  // Push out data the stream holds back.  Return 0 or an errno value.
+  virtual int fsync() {
+    return EINVAL;
+  }
+  virtual int ftruncate(nacl_abi_off_t length) {
+    return EINVAL;
+  }
   virtual int seek(nacl_abi_off_t offset, int whence,
                    nacl_abi_off_t* new_offset) {
     return ESPIPE;
@@ -57,6 +106,16 @@ class FileStream {
     errno = EINVAL;
     return -1;
   }
+  // Return 0 or an errno value, ENOPROTOOPT for options the stream doesn't
+  // know about.
+  virtual int setsockopt(int level, int optname,
+                         const void* optval, socklen_t optlen) {
+    return ENOPROTOOPT;
+  }
+  virtual int getsockopt(int level, int optname,
+                         void* optval, socklen_t* optlen) {
+    return ENOPROTOOPT;
+  }
 
   virtual bool is_read_ready() {
     return true;
@@ -67,6 +126,24 @@ class FileStream {
   virtual bool is_exception() {
     return false;
   }
+
+  // Woken whenever the state of the stream changes, e.g. data arrived or a
+  // pending Pepper call completed.  Blocking calls on the stream wait here, and
+  // select() registers with the queues of the streams it was asked about.
+  virtual WaitQueue& wait_queue() {
+    return wait_queue_;
+  }
+
+  // Guards the state of the stream and its wait queue.  FileSystem holds it
+  // around every call into the stream and Pepper callbacks take it before
+  // touching the stream, so unrelated streams don't contend with each other.
+  virtual Mutex& mutex() {
+    return mutex_;
+  }
+
+ private:
+  WaitQueue wait_queue_;
+  Mutex mutex_;
 };
 
 class PathHandler {
@@ -79,6 +156,10 @@ class PathHandler {
   virtual FileStream* open(int fd, const char* pathname, int oflag,
                            int* err) = 0;
   virtual int stat(const char* pathname, nacl_abi_stat* out) = 0;
+  // Return 0 or an errno value.
+  virtual int mkdir(const char* pathname, mode_t mode) {
+    return EPERM;
+  }
 };
 
 class InputInterface {
@@ -87,6 +168,9 @@ class InputInterface {
 
   virtual void OnOpen(bool success, bool is_atty) = 0;
   virtual void OnRead(const char* buf, size_t size) = 0;
+  // Like OnRead() for base64 encoded data.  Returns false without queueing
+  // anything if |data| isn't strict base64.
+  virtual bool OnReadBase64(const char* data, size_t size) = 0;
   virtual void OnWriteAcknowledge(uint64_t count) = 0;
   virtual void OnClose() = 0;
   virtual void OnReadReady(bool is_read_ready) = 0;
@@ -101,10 +185,24 @@ class OutputInterface {
   virtual bool OpenSocket(int fd, const char* host, uint16_t port,
                           InputInterface* stream) = 0;
   virtual bool Write(int fd, const char* data, size_t size) = 0;
+  // Zero-copy variant of Write().  BeginWrite() lends out a buffer for up to
+  // |*size| bytes and sets |*size| to its actual length, which the caller has
+  // to fill completely.  EndWrite() then hands the buffer over to |fd| without
+  // copying it again.  Only one buffer can be lent out at a time.
+  virtual char* BeginWrite(int fd, size_t* size) = 0;
+  virtual bool EndWrite(int fd) = 0;
   virtual bool Read(int fd, size_t size) = 0;
   virtual bool Close(int fd) = 0;
   virtual void ReadPass(const char* prompt, size_t size, bool echo) = 0;
+  // How many bytes a stream may have written without an acknowledgement.
+  // With an adaptive window this is only the starting point and the stream
+  // tunes it from how fast its writes get acknowledged.
   virtual size_t GetWriteWindow() = 0;
+  virtual bool IsWriteWindowAdaptive() = 0;
+  // Report the current write window of |fd|, how long JavaScript takes to
+  // acknowledge writes and how fast it consumes them in bytes per second.
+  virtual void SendWriteStats(int fd, size_t window, int64_t ack_rtt_us,
+                              uint64_t drain_rate) = 0;
   virtual void SendExitCode(int error) = 0;
 };
 
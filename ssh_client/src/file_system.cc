@@ -6,6 +6,7 @@
 
 #include <arpa/inet.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <signal.h>
@@ -20,7 +21,11 @@
 #include "dev_null.h"
 #include "dev_random.h"
 #include "js_file.h"
+#include "local_pipe.h"
+#include "locked_stream.h"
+#include "memory_file.h"
 #include "pepper_file.h"
+#include "pepper_resolver_backend.h"
 #include "tcp_server_socket.h"
 #include "tcp_socket.h"
 #include "udp_socket.h"
@@ -32,6 +37,9 @@ const int64_t kNanosecondsPerMicrosecond = 1000;
 // Magic value; keep in sync with //ssh_client/openssh/authfd.c
 const uint32_t kSshAgentFakeIP = 0x7F010203;
 
+// How much the in-memory /tmp may hold.
+const size_t kTmpMaxBytes = 16 * 1024 * 1024;
+
 // Convert a numeric string to a port number.
 uint16_t strtoport(const char* servname) {
   long port = 0;
@@ -48,6 +56,21 @@ uint16_t strtoport(const char* servname) {
   return port;
 }
 
+// Convert a timeout relative to now into an absolute deadline.
+void GetDeadline(int64_t timeout_us, timespec* ts_abs) {
+  timeval tv_now;
+  gettimeofday(&tv_now, NULL);
+  int64_t current_time_us =
+      tv_now.tv_sec * kMicrosecondsPerSecond + tv_now.tv_usec;
+  int64_t wakeup_time_us = current_time_us + timeout_us;
+  ts_abs->tv_sec = wakeup_time_us / kMicrosecondsPerSecond;
+  ts_abs->tv_nsec =
+      (wakeup_time_us - ts_abs->tv_sec * kMicrosecondsPerSecond) *
+      kNanosecondsPerMicrosecond;
+  VLOG("%s: ts_abs={tv_sec=%" PRIu64 ", tv_nsec=%" PRIu64 "}\n",
+       __func__, (uint64_t)ts_abs->tv_sec, (uint64_t)ts_abs->tv_nsec);
+}
+
 }  // namespace
 
 FileStream* const FileSystem::kBadFileStream = (FileStream*)-1;
@@ -56,12 +79,12 @@ FileSystem* FileSystem::file_system_ = NULL;
 FileSystem::FileSystem(pp::Instance* instance, OutputInterface* out)
     : instance_(instance),
       output_(out),
+      streams_(kFileIDOffset),
       ppfs_(NULL),
       ppfs_path_handler_(NULL),
       fs_initialized_(false),
       factory_(this),
-      host_resolver_(NULL),
-      first_unused_addr_(kFirstAddr),
+      host_resolver_(new PepperResolverBackend(instance)),
       use_js_socket_(false),
       col_(80), row_(24),
       is_resize_(false),
@@ -96,26 +119,32 @@ FileSystem::FileSystem(pp::Instance* instance, OutputInterface* out)
 
   AddPathHandler("/dev/tty", new JsFileHandler(out));
   AddPathHandler("/dev/null", new DevNullHandler());
+  AddPathHandler("/tmp/", new MemoryFileHandler("/tmp", kTmpMaxBytes));
 
   nacl_irt_random random;
   if (nacl_interface_query(NACL_IRT_RANDOM_v0_1, &random, sizeof(random))) {
-    AddPathHandler("/dev/random",
-                   new DevRandomHandler(random.get_random_bytes));
+    // Both share one generator.
+    DevRandomHandler* handler = new DevRandomHandler(
+        random.get_random_bytes, DevRandomHandler::kBuffered);
+    handler->addref();
+    AddPathHandler("/dev/random", handler);
+    AddPathHandler("/dev/urandom", handler);
   } else {
     LOG("Can't get " NACL_IRT_RANDOM_v0_1 " interface\n");
     abort();
   }
-
-  // Add localhost 127.0.0.1
-  AddHostAddress("localhost", 0x7F000001);
 }
 
 FileSystem::~FileSystem() {
-  for (PathHandlerMap::iterator it = paths_.begin(); it != paths_.end(); ++it)
-    it->second->release();
-  for (FileStreamMap::iterator it = streams_.begin(); it != streams_.end();
-       ++it) {
-    it->second->release();
+  int nfds;
+  {
+    Mutex::Lock lock(mutex_);
+    nfds = streams_.size();
+  }
+  for (int fd = 0; fd < nfds; fd++) {
+    FileStream* stream = streams_.Get(fd);
+    if (stream && stream != kBadFileStream)
+      stream->release();
   }
   if (ppfs_path_handler_)
     ppfs_path_handler_->release();
@@ -145,66 +174,73 @@ FileSystem* FileSystem::GetFileSystemNoCrash() {
 }
 
 void FileSystem::WaitForStdFiles() {
-  JsFile* stdin_fs = static_cast<JsFile*>(GetStream(0));
-  JsFile* stdout_fs = static_cast<JsFile*>(GetStream(1));
-  JsFile* stderr_fs = static_cast<JsFile*>(GetStream(2));
-
-  Mutex::Lock lock(mutex_);
-  while (!(stdin_fs->is_open() && stdout_fs->is_open() && stderr_fs->is_open()))
-    cond_.wait(mutex_);
+  for (int fd = 0; fd < 3; fd++) {
+    LockedStream stream(GetStreamRef(fd));
+    JsFile* file = static_cast<JsFile*>(stream.get());
+    while (!file->is_open())
+      file->wait_queue().wait(file->mutex());
+  }
 }
 
 void FileSystem::AddPathHandler(const std::string& path, PathHandler* handler) {
-  assert(paths_.find(path) == paths_.end());
-  paths_[path] = handler;
+  bool mounted = mounts_.Mount(path, handler);
+  assert(mounted);
+  (void)mounted;
 }
 
 void FileSystem::AddFileStream(int fd, FileStream* stream) {
-  assert(streams_.find(fd) == streams_.end() || !streams_.find(fd)->second);
-  streams_[fd] = stream;
+  assert(!streams_.Get(fd));
+  streams_.Set(fd, stream);
 }
 
 void FileSystem::RemoveFileStream(int fd) {
-  assert(streams_.find(fd) != streams_.end());
-  streams_.erase(fd);
-}
+  streams_.Remove(fd);
 
-int FileSystem::GetFirstUnusedDescriptor() {
-  int fd = kFileIDOffset;
-  while (IsKnowDescriptor(fd))
-    fd++;
-  return fd;
+  FakeAddressRefMap::iterator it = fake_addr_refs_.find(fd);
+  if (it != fake_addr_refs_.end()) {
+    fake_addrs_.Unref(it->second);
+    fake_addr_refs_.erase(it);
+  }
 }
 
-bool FileSystem::IsKnowDescriptor(int fd) {
-  return streams_.find(fd) != streams_.end();
+FileStream* FileSystem::GetStream(int fd) {
+  return streams_.Get(fd);
 }
 
-FileStream* FileSystem::GetStream(int fd) {
-  FileStreamMap::iterator it = streams_.find(fd);
-  return it != streams_.end() ? it->second : (FileStream*)NULL;
+FileStream* FileSystem::GetStreamRef(int fd) {
+  Mutex::Lock lock(mutex_);
+  FileStream* stream = GetStream(fd);
+  if (!stream || stream == kBadFileStream)
+    return NULL;
+  stream->addref();
+  return stream;
 }
 
 int FileSystem::open(const char* pathname, int oflag, mode_t cmode,
                      int* newfd) {
-  Mutex::Lock lock(mutex_);
-  PathHandlerMap::iterator it = paths_.find(pathname);
   PathHandler* handler = NULL;
-  if (it != paths_.end()) {
-    handler = it->second;
-  } else {
-    while (!fs_initialized_)
-      cond_.wait(mutex_);
-    handler = ppfs_path_handler_;
+  int fd;
+  {
+    Mutex::Lock lock(mutex_);
+    handler = mounts_.Find(pathname);
+    if (!handler) {
+      while (!fs_initialized_)
+        cond_.wait(mutex_);
+      handler = ppfs_path_handler_;
+    }
+    if (!handler)
+      return ENOENT;
+
+    // Reserve the descriptor while the handler opens the stream.
+    fd = streams_.Allocate();
   }
-  if (!handler)
-    return ENOENT;
 
+  // Opening may block on Pepper or JavaScript, which must not hold up other
+  // descriptors.
   int err;
-  int fd = GetFirstUnusedDescriptor();
-  // mark descriptor as used
-  AddFileStream(fd, NULL);
   FileStream* stream = handler->open(fd, pathname, oflag, &err);
+
+  Mutex::Lock lock(mutex_);
   if (!stream) {
     RemoveFileStream(fd);
     return err;
@@ -215,43 +251,111 @@ int FileSystem::open(const char* pathname, int oflag, mode_t cmode,
   return 0;
 }
 
-int FileSystem::close(int fd) {
-  Mutex::Lock lock(mutex_);
-  if (!IsKnowDescriptor(fd))
-    return EBADF;
-
-  FileStream* stream = GetStream(fd);
+void FileSystem::CloseStream(FileStream* stream) {
   if (stream && stream != kBadFileStream) {
-    stream->close();
+    {
+      Mutex::Lock lock(stream->mutex());
+      stream->close();
+    }
     stream->release();
   }
-  RemoveFileStream(fd);
+}
+
+int FileSystem::close(int fd) {
+  FileStream* stream;
+  {
+    Mutex::Lock lock(mutex_);
+    if (!streams_.IsUsed(fd))
+      return EBADF;
+
+    stream = GetStream(fd);
+    RemoveFileStream(fd);
+    socket_options_.erase(fd);
+  }
+
+  CloseStream(stream);
   return 0;
 }
 
 int FileSystem::read(int fd, char* buf, size_t count, size_t* nread) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream)
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
     return stream->read(buf, count, nread);
   else
     return EBADF;
 }
 
 int FileSystem::write(int fd, const char* buf, size_t count, size_t* nwrote) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream)
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
     return stream->write(buf, count, nwrote);
   else
     return EBADF;
 }
 
+#ifndef IOV_MAX
+# define IOV_MAX 1024
+#endif
+int FileSystem::readv(int fd, const iovec* iov, int iovcnt, size_t* nread) {
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return EINVAL;
+
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
+    return stream->readv(iov, iovcnt, nread);
+  else
+    return EBADF;
+}
+
+int FileSystem::writev(int fd, const iovec* iov, int iovcnt, size_t* nwrote) {
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return EINVAL;
+
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
+    return stream->writev(iov, iovcnt, nwrote);
+  else
+    return EBADF;
+}
+
+int FileSystem::pread(int fd, char* buf, size_t count, nacl_abi_off_t offset,
+                      size_t* nread) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
+    return stream->pread(buf, count, offset, nread);
+  else
+    return EBADF;
+}
+
+int FileSystem::pwrite(int fd, const char* buf, size_t count,
+                       nacl_abi_off_t offset, size_t* nwrote) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
+    return stream->pwrite(buf, count, offset, nwrote);
+  else
+    return EBADF;
+}
+
+int FileSystem::fsync(int fd) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
+    return stream->fsync();
+  else
+    return EBADF;
+}
+
+int FileSystem::ftruncate(int fd, nacl_abi_off_t length) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
+    return stream->ftruncate(length);
+  else
+    return EBADF;
+}
+
 int FileSystem::seek(int fd, nacl_abi_off_t offset, int whence,
                      nacl_abi_off_t* new_offset) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream)
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
     return stream->seek(offset, whence, new_offset);
   else
     return EBADF;
@@ -263,9 +367,7 @@ int FileSystem::dup(int fd, int* newfd) {
   if (!stream || stream == kBadFileStream)
     return EBADF;
 
-  *newfd = GetFirstUnusedDescriptor();
-  // Mark as used.
-  AddFileStream(*newfd, NULL);
+  *newfd = streams_.Allocate();
   FileStream* new_stream = stream->dup(*newfd);
   if (!new_stream) {
     RemoveFileStream(*newfd);
@@ -277,45 +379,67 @@ int FileSystem::dup(int fd, int* newfd) {
 }
 
 int FileSystem::dup2(int fd, int newfd) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (!stream || stream == kBadFileStream)
-    return EBADF;
+  FileStream* old_stream;
+  FileStream* new_stream;
+  {
+    Mutex::Lock lock(mutex_);
+    FileStream* stream = GetStream(fd);
+    if (!stream || stream == kBadFileStream)
+      return EBADF;
+    if (newfd < 0 || newfd >= FileDescriptorTable::kMaxFds)
+      return EBADF;
+    if (fd == newfd)
+      return 0;
 
-  FileStream* new_stream = GetStream(newfd);
-  if (stream == kBadFileStream) {
-    return EBADF;
-  } else if (!new_stream) {
-    new_stream->close();
-    new_stream->release();
-    RemoveFileStream(newfd);
+    // The stream that was at |newfd| is closed once the table is unlocked.
+    old_stream = GetStream(newfd);
+    streams_.Set(newfd, NULL);
+    new_stream = stream->dup(newfd);
+    if (new_stream)
+      AddFileStream(newfd, new_stream);
+    else
+      RemoveFileStream(newfd);
   }
 
-  AddFileStream(newfd, NULL);
-  new_stream = stream->dup(newfd);
-  if (!new_stream)
-    return EACCES;
+  CloseStream(old_stream);
+  return new_stream ? 0 : EACCES;
+}
+
+int FileSystem::pipe(int fds[2]) {
+  LocalPipe* ends[2];
+  LocalPipe::CreatePair(false, &ends[0], &ends[1]);
 
-  AddFileStream(newfd, new_stream);
+  Mutex::Lock lock(mutex_);
+  for (int i = 0; i < 2; i++) {
+    fds[i] = streams_.Allocate();
+    AddFileStream(fds[i], ends[i]);
+  }
   return 0;
 }
 
 int FileSystem::fstat(int fd, nacl_abi_stat* out) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream)
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
     return stream->fstat(out);
   else
     return EBADF;
 }
 
 int FileSystem::stat(const char* pathname, nacl_abi_stat* out) {
-  Mutex::Lock lock(mutex_);
-  PathHandlerMap::iterator it = paths_.find(pathname);
-  PathHandler* handler = (it != paths_.end()) ? it->second : ppfs_path_handler_;
-  if (!handler)
-    return ENOENT;
+  PathHandler* handler = NULL;
+  {
+    Mutex::Lock lock(mutex_);
+    handler = mounts_.Find(pathname);
+    if (!handler) {
+      while (!fs_initialized_)
+        cond_.wait(mutex_);
+      handler = ppfs_path_handler_;
+    }
+    if (!handler)
+      return ENOENT;
+  }
 
+  // Like open(), don't hold up other descriptors while Pepper is asked.
   return handler->stat(pathname, out);
 }
 
@@ -345,9 +469,8 @@ void FileSystem::ReadPassResult(const std::string pass) {
 }
 
 int FileSystem::isatty(int fd) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get()) {
     return stream->isatty();
   } else {
     errno = EBADF;
@@ -356,9 +479,8 @@ int FileSystem::isatty(int fd) {
 }
 
 int FileSystem::tcgetattr(int fd, struct termios* termios_p) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get()) {
     return stream->tcgetattr(termios_p);
   } else {
     errno = EBADF;
@@ -368,9 +490,8 @@ int FileSystem::tcgetattr(int fd, struct termios* termios_p) {
 
 int FileSystem::tcsetattr(int fd, int optional_actions,
                           const termios* termios_p) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get()) {
     return stream->tcsetattr(optional_actions, termios_p);
   } else {
     errno = EBADF;
@@ -379,11 +500,12 @@ int FileSystem::tcsetattr(int fd, int optional_actions,
 }
 
 int FileSystem::fcntl(int fd, int cmd, va_list ap) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get())
     return stream->fcntl(cmd, ap);
-  } else if (IsKnowDescriptor(fd)) {
+
+  Mutex::Lock lock(mutex_);
+  if (streams_.IsUsed(fd)) {
     // Socket with reserved FD but not allocated yet, for now just ignore.
     return 0;
   } else {
@@ -393,9 +515,8 @@ int FileSystem::fcntl(int fd, int cmd, va_list ap) {
 }
 
 int FileSystem::ioctl(int fd, int request, va_list ap) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get()) {
     return stream->ioctl(request, ap);
   } else {
     errno = EBADF;
@@ -403,351 +524,232 @@ int FileSystem::ioctl(int fd, int request, va_list ap) {
   }
 }
 
-int FileSystem::IsReady(int nfds, fd_set* fds, bool (FileStream::*is_ready)(),
-                        bool apply) {
-  if (!fds)
-    return 0;
-
-  int nset = 0;
-  for (int i = 0; i < nfds; i++) {
-    if (FD_ISSET(i, fds)) {
-      FileStream* stream = GetStream(i);
-      if (!stream) {
-        return -1;
-      } else if ((stream->*is_ready)()) {
-        if (!apply)
-          return 1;
-        else
-          nset++;
-      } else {
-        if (apply)
-          FD_CLR(i, fds);
-      }
-    }
-  }
-  return nset;
-}
-
 bool FileSystem::IsInterrupted() {
+  Mutex::Lock lock(mutex_);
   bool has_handler_sigwinch = handler_sigwinch_ != SIG_IGN &&
                               handler_sigwinch_ != SIG_DFL &&
                               handler_sigwinch_ != SIG_ERR;
   return has_handler_sigwinch && is_resize_;
 }
 
-int FileSystem::select(int nfds, fd_set* readfds, fd_set* writefds,
-                       fd_set* exceptfds, struct timeval* timeout) {
-  Mutex::Lock lock(mutex_);
+int FileSystem::WaitForEvents(PollSet* set, const timespec* ts_abs) {
+  // Streams wake up the set when their state changes; a raised signal has to
+  // interrupt the wait as well.
+  set->Watch(&signal_queue_, &mutex_);
+  set->Start();
 
-  timespec ts_abs;
-  if (timeout) {
-    timespec ts;
-    TIMEVAL_TO_TIMESPEC(timeout, &ts);
-    timeval tv_now;
-    gettimeofday(&tv_now, NULL);
-    int64_t current_time_us =
-        tv_now.tv_sec * kMicrosecondsPerSecond + tv_now.tv_usec;
-    int64_t wakeup_time_us =
-        current_time_us +
-        timeout->tv_sec * kMicrosecondsPerSecond + timeout->tv_usec;
-    ts_abs.tv_sec = wakeup_time_us / kMicrosecondsPerSecond;
-    ts_abs.tv_nsec =
-        (wakeup_time_us - ts_abs.tv_sec * kMicrosecondsPerSecond) *
-        kNanosecondsPerMicrosecond;
-    VLOG("%s: ts_abs={tv_sec=%" PRIu64 ", tv_nsec=%" PRIu64 "}\n",
-         __func__, (uint64_t)ts_abs.tv_sec, (uint64_t)ts_abs.tv_nsec);
-  }
-
-  while (!(IsInterrupted() ||
-           IsReady(nfds, readfds, &FileStream::is_read_ready, false) ||
-           IsReady(nfds, writefds, &FileStream::is_write_ready, false) ||
-           IsReady(nfds, exceptfds, &FileStream::is_exception, false))) {
-    if (timeout) {
-      if (!timeout->tv_sec && !timeout->tv_usec)
+  int nready = 0;
+  while (!IsInterrupted() && !(nready = set->Update())) {
+    if (set->Wait(ts_abs)) {
+      if (errno == ETIMEDOUT)
         break;
-
-      if (cond_.timedwait(mutex_, &ts_abs)) {
-        if (errno == ETIMEDOUT)
-          break;
-        else
-          return -1;
-      }
-    } else {
-      cond_.wait(mutex_);
+      else
+        return -1;
     }
   }
 
-  if (IsInterrupted()) {
-    is_resize_ = false;
-    handler_sigwinch_(SIGWINCH);
-    errno = EINTR;
-    return -1;
+  // The handler is run without |mutex_| held as it's likely to call back into
+  // the streams, e.g. to query the new terminal size.
+  void (*handler)(int) = NULL;
+  {
+    Mutex::Lock lock(mutex_);
+    if (IsInterrupted()) {
+      is_resize_ = false;
+      handler = handler_sigwinch_;
+    }
   }
-
-  int nread = IsReady(nfds, readfds, &FileStream::is_read_ready, true);
-  int nwrite = IsReady(nfds, writefds, &FileStream::is_write_ready, true);
-  int nexcpt = IsReady(nfds, exceptfds, &FileStream::is_exception, true);
-  if (nread < 0 || nwrite < 0 || nexcpt < 0) {
-    errno = EBADF;
+  if (handler) {
+    handler(SIGWINCH);
+    errno = EINTR;
     return -1;
   }
-  return nread + nwrite + nexcpt;
+  return nready;
 }
 
-uint32_t FileSystem::AddHostAddress(const char* name, uint32_t addr) {
-  addr = htonl(addr);
-  hosts_[name] = addr;
-  addrs_[addr] = name;
-  return addr;
-}
-
-addrinfo* FileSystem::CreateAddrInfo(const PP_NetAddress_Private& netaddr,
-                                     const addrinfo* hints,
-                                     const char* name) {
-  addrinfo* ai = new addrinfo();
-  sockaddr_in6* addr = new sockaddr_in6();
+int FileSystem::select(int nfds, fd_set* readfds, fd_set* writefds,
+                       fd_set* exceptfds, struct timeval* timeout) {
+  timespec ts_abs;
+  if (timeout)
+    GetDeadline(timeout->tv_sec * kMicrosecondsPerSecond + timeout->tv_usec,
+                &ts_abs);
+
+  PollSet set;
+  std::vector<int> fds;
+  {
+    Mutex::Lock lock(mutex_);
+    for (int i = 0; i < nfds; i++) {
+      short events = 0;
+      if (readfds && FD_ISSET(i, readfds))
+        events |= POLLIN;
+      if (writefds && FD_ISSET(i, writefds))
+        events |= POLLOUT;
+      // Exceptional conditions are hang ups; there is no out-of-band data.
+      if (exceptfds && FD_ISSET(i, exceptfds))
+        events |= POLLHUP;
+      if (!events)
+        continue;
 
-  ai->ai_addr = reinterpret_cast<sockaddr*>(addr);
-  ai->ai_addrlen = sizeof(*addr);
+      FileStream* stream = GetStream(i);
+      if (!stream || stream == kBadFileStream) {
+        errno = EBADF;
+        return -1;
+      }
+      set.Add(stream, events);
+      fds.push_back(i);
+    }
+  }
 
-  PP_NetAddressFamily_Private family =
-      pp::NetAddressPrivate::GetFamily(netaddr);
-  if (family == PP_NETADDRESSFAMILY_PRIVATE_IPV4)
-    ai->ai_addr->sa_family = ai->ai_family = AF_INET;
-  else if (family == PP_NETADDRESSFAMILY_PRIVATE_IPV6)
-    ai->ai_addr->sa_family = ai->ai_family = AF_INET6;
+  if (WaitForEvents(&set, timeout ? &ts_abs : NULL) < 0)
+    return -1;
 
-  ai->ai_canonname = strdup(name);
-  addr->sin6_port = pp::NetAddressPrivate::GetPort(netaddr);
-  if (family == PP_NETADDRESSFAMILY_PRIVATE_IPV6) {
-    pp::NetAddressPrivate::GetAddress(
-        netaddr, &addr->sin6_addr, sizeof(in6_addr));
-  } else {
-    sockaddr_in* addr_in = reinterpret_cast<sockaddr_in*>(addr);
-    pp::NetAddressPrivate::GetAddress(
-        netaddr, &addr_in->sin_addr, sizeof(in_addr));
+  int nset = 0;
+  for (size_t i = 0; i < set.size(); i++) {
+    short revents = set.revents(i);
+    int fd = fds[i];
+    if (readfds && FD_ISSET(fd, readfds)) {
+      if (revents & POLLIN)
+        nset++;
+      else
+        FD_CLR(fd, readfds);
+    }
+    if (writefds && FD_ISSET(fd, writefds)) {
+      if (revents & POLLOUT)
+        nset++;
+      else
+        FD_CLR(fd, writefds);
+    }
+    if (exceptfds && FD_ISSET(fd, exceptfds)) {
+      if (revents & POLLHUP)
+        nset++;
+      else
+        FD_CLR(fd, exceptfds);
+    }
   }
+  return nset;
+}
 
-  if (hints && hints->ai_socktype)
-    ai->ai_socktype = hints->ai_socktype;
-  else
-    ai->ai_socktype = SOCK_STREAM;
+int FileSystem::poll(pollfd* fds, nfds_t nfds, const timespec* timeout) {
+  timespec ts_abs;
+  if (timeout)
+    GetDeadline(timeout->tv_sec * kMicrosecondsPerSecond +
+                timeout->tv_nsec / kNanosecondsPerMicrosecond, &ts_abs);
+
+  // Descriptors that aren't open are reported right away with POLLNVAL and
+  // make the call return without waiting.
+  PollSet set;
+  int ninvalid = 0;
+  {
+    Mutex::Lock lock(mutex_);
+    for (nfds_t i = 0; i < nfds; i++) {
+      fds[i].revents = 0;
+      if (fds[i].fd < 0)
+        continue;
+
+      FileStream* stream = GetStream(fds[i].fd);
+      if (!stream || stream == kBadFileStream) {
+        fds[i].revents = POLLNVAL;
+        ninvalid++;
+      } else {
+        // POLLHUP is always reported whether it was asked for or not.
+        short events = fds[i].events & (POLLIN | POLLOUT | POLLPRI);
+        set.Add(stream, events | POLLHUP);
+      }
+    }
+  }
 
-  if (hints && hints->ai_protocol)
-    ai->ai_protocol = hints->ai_protocol;
+  // A deadline in the past makes the wait only check the current state.
+  timespec ts_past = {0, 0};
+  int nready = WaitForEvents(&set, ninvalid ? &ts_past :
+                                   timeout ? &ts_abs : NULL);
+  if (nready < 0)
+    return -1;
 
-  return ai;
+  for (nfds_t i = 0, j = 0; i < nfds; i++) {
+    if (fds[i].fd >= 0 && fds[i].revents != POLLNVAL)
+      fds[i].revents = set.revents(j++);
+  }
+  return nready + ninvalid;
 }
 
 addrinfo* FileSystem::GetFakeAddress(const char* hostname, uint16_t port,
                                      const addrinfo* hints) {
   uint32_t addr;
-  HostMap::iterator it = hosts_.find(hostname);
-  if (it != hosts_.end())
-    addr = it->second;
-  else
-    addr = AddHostAddress(hostname, first_unused_addr_++);
-
-  addrinfo* ai = new addrinfo();
-  sockaddr_in* addr_in = new sockaddr_in();
-  ai->ai_addr = reinterpret_cast<sockaddr*>(addr_in);
-  ai->ai_addrlen = sizeof(sockaddr_in);
-  ai->ai_family = addr_in->sin_family = AF_INET;
-  addr_in->sin_port = port;
-  addr_in->sin_addr.s_addr = addr;
-
-  if (hints && hints->ai_socktype)
-    ai->ai_socktype = hints->ai_socktype;
-  else
-    ai->ai_socktype = SOCK_STREAM;
-
-  if (hints && hints->ai_protocol)
-    ai->ai_protocol = hints->ai_protocol;
-
-  return ai;
+  if (!strcmp(hostname, "localhost"))
+    addr = htonl(INADDR_LOOPBACK);
+  else if (!fake_addrs_.Get(hostname, &addr))
+    return NULL;
+
+  HostResolver::Address address = {};
+  address.family = AF_INET;
+  address.v4.s_addr = addr;
+  return HostResolver::CreateAddrInfo(&address, 1, port, hints, "");
 }
 
 int FileSystem::getaddrinfo(const char* hostname, const char* servname,
     const addrinfo* hints, addrinfo** res) {
-  Mutex::Lock lock(mutex_);
-  GetAddrInfoParams params;
-  params.hostname = hostname;
-  params.servname = servname;
-  params.hints = hints;
-  params.res = res;
-  int32_t result = PP_OK_COMPLETIONPENDING;
-  pp::Module::Get()->core()->CallOnMainThread(0, factory_.NewCallback(
-      &FileSystem::Resolve, &params, &result));
-  while (result == PP_OK_COMPLETIONPENDING)
-    cond_.wait(mutex_);
-  return result == PP_OK ? 0 : EAI_FAIL;
-}
-
-void FileSystem::Resolve(int32_t result, GetAddrInfoParams* params,
-                         int32_t* pres) {
-  Mutex::Lock lock(mutex_);
-  const char* hostname = params->hostname;
-  const char* servname = params->servname;
-  const addrinfo* hints = params->hints;
-  addrinfo** res = params->res;
-
   if (hints && hints->ai_family != AF_UNSPEC &&
       hints->ai_family != AF_INET &&
       hints->ai_family != AF_INET6) {
-    *pres = PP_ERROR_FAILED;
-    cond_.broadcast();
-    return;
+    return EAI_FAIL;
   }
 
   uint16_t port = htons(strtoport(servname));
 
   bool is_ipv6 = hints ? hints->ai_family == AF_INET6 : false;
-  in6_addr in = {};
-  bool is_numeric = hostname &&
-      inet_pton(is_ipv6 ? AF_INET6 : AF_INET, hostname, &in);
-
-  if (is_numeric) {
-    PP_NetAddress_Private addr = {};
-    if (is_ipv6) {
-      // TODO: handle scope_id
-      if (!pp::NetAddressPrivate::CreateFromIPv6Address(
-              in.s6_addr, 0, port, &addr)) {
-        LOG("NetAddressPrivate::CreateFromIPv6Address failed!\n");
-        *pres = PP_ERROR_FAILED;
-        cond_.broadcast();
-        return;
-      }
-    } else {
-      if (!pp::NetAddressPrivate::CreateFromIPv4Address(
-              in.s6_addr, port, &addr)) {
-        LOG("NetAddressPrivate::CreateFromIPv4Address failed!\n");
-        *pres = PP_ERROR_FAILED;
-        cond_.broadcast();
-        return;
-      }
-    }
-    *res = CreateAddrInfo(addr, hints, "");
-    *pres = PP_OK;
-    cond_.broadcast();
-    return;
+  HostResolver::Address addr = {};
+  addr.family = is_ipv6 ? AF_INET6 : AF_INET;
+
+  if (hostname && inet_pton(addr.family, hostname, &addr.v6)) {
+    // TODO: handle scope_id
+    *res = HostResolver::CreateAddrInfo(&addr, 1, port, hints, "");
+    return *res ? 0 : EAI_MEMORY;
   }
 
   if (hints && hints->ai_flags & AI_PASSIVE) {
     // Numeric case we considered above so the only remaining case is any.
-    PP_NetAddress_Private addr = {};
-    if (!pp::NetAddressPrivate::GetAnyAddress(is_ipv6, &addr)) {
-      LOG("NetAddressPrivate::GetAnyAddress failed!\n");
-      *pres = PP_ERROR_FAILED;
-      cond_.broadcast();
-      return;
-    }
-    *res = CreateAddrInfo(addr, hints, "");
-    *pres = PP_OK;
-    cond_.broadcast();
-    return;
+    *res = HostResolver::CreateAddrInfo(&addr, 1, port, hints, "");
+    return *res ? 0 : EAI_MEMORY;
   }
 
   if (!hostname) {
-    PP_NetAddress_Private localhost = {};
-    if (is_ipv6) {
-      uint8_t localhost_ip[16] = {};
-      localhost_ip[15] = 1;
-      // TODO: handle scope_id
-      if (!pp::NetAddressPrivate::CreateFromIPv6Address(
-              localhost_ip, 0, port, &localhost)) {
-        LOG("NetAddressPrivate::CreateFromIPv6Address failed!\n");
-        *pres = PP_ERROR_FAILED;
-        cond_.broadcast();
-        return;
-      }
-    } else {
-      uint8_t localhost_ip[4] = { 127, 0, 0, 1 };
-      if (!pp::NetAddressPrivate::CreateFromIPv4Address(
-              localhost_ip, port, &localhost)) {
-        LOG("NetAddressPrivate::CreateFromIPv4Address failed!\n");
-        *pres = PP_ERROR_FAILED;
-        cond_.broadcast();
-        return;
-      }
-    }
-    *res = CreateAddrInfo(localhost, hints, "");
-    *pres = PP_OK;
-    cond_.broadcast();
-    return;
+    if (is_ipv6)
+      addr.v6.s6_addr[15] = 1;
+    else
+      addr.v4.s_addr = htonl(INADDR_LOOPBACK);
+    *res = HostResolver::CreateAddrInfo(&addr, 1, port, hints, "");
+    return *res ? 0 : EAI_MEMORY;
   }
 
-  if (hints && hints->ai_flags & AI_NUMERICHOST) {
-    *pres = PP_ERROR_FAILED;
-    cond_.broadcast();
-    return;
-  }
-
-  // In case of JS socket don't use local host resolver.
-  if (!use_js_socket_ && pp::HostResolverPrivate::IsAvailable()) {
-    PP_HostResolver_Private_Hint hint = {
-        PP_NETADDRESSFAMILY_PRIVATE_UNSPECIFIED, 0,
-    };
-    if (hints) {
-      if (hints->ai_family == AF_INET)
-        hint.family = PP_NETADDRESSFAMILY_PRIVATE_IPV4;
-      else if (hints->ai_family == AF_INET6)
-        hint.family = PP_NETADDRESSFAMILY_PRIVATE_IPV6;
-      if (hints->ai_flags & AI_CANONNAME)
-        hint.flags = PP_HOST_RESOLVER_PRIVATE_FLAGS_CANONNAME;
-    }
+  if (hints && hints->ai_flags & AI_NUMERICHOST)
+    return EAI_FAIL;
 
-    assert(host_resolver_ == NULL);
-    host_resolver_ = new pp::HostResolverPrivate(instance_);
-    *pres = host_resolver_->Resolve(hostname, port, hint,
-        factory_.NewCallback(&FileSystem::OnResolve, params, pres));
-    if (*pres != PP_OK_COMPLETIONPENDING) {
-      delete host_resolver_;
-      host_resolver_ = NULL;
-      cond_.broadcast();
-    }
-  } else {
-    *res = GetFakeAddress(hostname, port, hints);
-    *pres = PP_OK;
-    cond_.broadcast();
-    return;
+  bool use_js_socket;
+  {
+    Mutex::Lock lock(mutex_);
+    use_js_socket = use_js_socket_;
   }
-}
 
-void FileSystem::OnResolve(int32_t result, GetAddrInfoParams* params,
-                           int32_t* pres) {
-  Mutex::Lock lock(mutex_);
-  assert(host_resolver_);
-  const addrinfo* hints = params->hints;
-  addrinfo** res = params->res;
-  std::string host_name = host_resolver_->GetCanonicalName().AsString();
-  if (result == PP_OK) {
-    size_t size  = host_resolver_->GetSize();
-    for (size_t i = 0; i < size; i++) {
-      PP_NetAddress_Private address = {};
-      if (host_resolver_->GetNetAddress(i, &address)) {
-        *res = CreateAddrInfo(address, hints, host_name.c_str());
-        res = &(*res)->ai_next;
-      }
+  // In case of JS socket don't use local host resolver.  Names it can't
+  // resolve get a fake address and are left to JavaScript.
+  if (!use_js_socket) {
+    HostResolver::Result result;
+    host_resolver_.Lookup(hostname, hints ? hints->ai_family : AF_UNSPEC,
+                          &result);
+    if (result.ok) {
+      *res = HostResolver::CreateAddrInfo(
+          &result.addresses[0], result.addresses.size(), port, hints,
+          result.canonical_name.c_str());
+      return *res ? 0 : EAI_MEMORY;
     }
-  } else {
-    uint16_t port = htons(strtoport(params->servname));
-    *res = GetFakeAddress(params->hostname, port, hints);
-    result = PP_OK;
   }
-  delete host_resolver_;
-  host_resolver_ = NULL;
-  *pres = result;
-  cond_.broadcast();
+
+  Mutex::Lock lock(mutex_);
+  *res = GetFakeAddress(hostname, port, hints);
+  return *res ? 0 : EAI_MEMORY;
 }
 
 void FileSystem::freeaddrinfo(addrinfo* ai) {
-  while (ai != NULL) {
-    addrinfo* next = ai->ai_next;
-    free(ai->ai_canonname);
-    delete ai->ai_addr;
-    delete ai;
-    ai = next;
-  }
+  HostResolver::FreeAddrInfo(ai);
 }
 
 int FileSystem::getnameinfo(const sockaddr* sa, socklen_t salen,
@@ -774,26 +776,53 @@ int FileSystem::getnameinfo(const sockaddr* sa, socklen_t salen,
 
 int FileSystem::socket(int socket_family, int socket_type, int protocol) {
   Mutex::Lock lock(mutex_);
-  int fd = GetFirstUnusedDescriptor();
+  // Stream sockets only get their stream in connect() or bind().
+  int fd = streams_.Allocate();
   socket_types_[fd] = socket_type;
-  if (socket_types_[fd] == SOCK_DGRAM) {
-    UDPSocket* socket = new UDPSocket(fd, 0);
-    AddFileStream(fd, socket);
-  } else {
-    // mark descriptor as used
-    AddFileStream(fd, NULL);
-  }
+  socket_options_.erase(fd);
+  if (socket_types_[fd] == SOCK_DGRAM)
+    AddFileStream(fd, new UDPSocket(fd, 0));
   return fd;
 }
 
-bool FileSystem::GetHostPort(const sockaddr* serv_addr, socklen_t addrlen,
+int FileSystem::socketpair(int domain, int type, int protocol, int fds[2]) {
+  // Only a connected pair of stream sockets within the process is supported.
+  if (domain != AF_UNIX)
+    return EAFNOSUPPORT;
+  if (type != SOCK_STREAM)
+    return EOPNOTSUPP;
+  if (protocol != 0)
+    return EPROTONOSUPPORT;
+
+  LocalPipe* ends[2];
+  LocalPipe::CreatePair(true, &ends[0], &ends[1]);
+
+  Mutex::Lock lock(mutex_);
+  for (int i = 0; i < 2; i++) {
+    fds[i] = streams_.Allocate();
+    socket_types_[fds[i]] = type;
+    socket_options_.erase(fds[i]);
+    AddFileStream(fds[i], ends[i]);
+  }
+  return 0;
+}
+
+bool FileSystem::GetHostPort(int fd, const sockaddr* serv_addr,
+                             socklen_t addrlen,
                              std::string* hostname, uint16_t* port) {
   if (serv_addr->sa_family == AF_INET) {
     const sockaddr_in* sin4 = reinterpret_cast<const sockaddr_in*>(serv_addr);
     *port = ntohs(sin4->sin_port);
-    AddressMap::iterator it = addrs_.find(sin4->sin_addr.s_addr);
-    if (it != addrs_.end()) {
-      *hostname = it->second;
+    if (sin4->sin_addr.s_addr == htonl(INADDR_LOOPBACK)) {
+      *hostname = "localhost";
+    } else if (FakeAddressPool::Contains(sin4->sin_addr.s_addr) &&
+               fake_addrs_.Lookup(sin4->sin_addr.s_addr, hostname)) {
+      // Keep the name around while the socket is open.
+      FakeAddressRefMap::iterator it = fake_addr_refs_.find(fd);
+      if (it != fake_addr_refs_.end())
+        fake_addrs_.Unref(it->second);
+      fake_addrs_.Ref(sin4->sin_addr.s_addr);
+      fake_addr_refs_[fd] = sin4->sin_addr.s_addr;
     } else {
       char buf[NI_MAXHOST];
       inet_ntop(AF_INET, &sin4->sin_addr, buf, sizeof(buf));
@@ -826,32 +855,43 @@ bool FileSystem::IsAgentConnect(const sockaddr* serv_addr, socklen_t addrlen,
 }
 
 int FileSystem::connect(int fd, const sockaddr* serv_addr, socklen_t addrlen) {
-  Mutex::Lock lock(mutex_);
-  if (streams_.find(fd) == streams_.end()) {
-    errno = EBADF;
-    return -1;
-  }
-
   uint16_t port;
   std::string hostname;
+  bool use_js_socket;
+  {
+    Mutex::Lock lock(mutex_);
+    if (!streams_.IsUsed(fd)) {
+      errno = EBADF;
+      return -1;
+    }
 
-  if (IsAgentConnect(serv_addr, addrlen, &hostname, &port)) {
-    // If the request is for the auth agent,
-    // make sure to punt request to JS proxy.
-    use_js_socket_ = true;
-  } else if (!GetHostPort(serv_addr, addrlen, &hostname, &port)) {
-    errno = EAFNOSUPPORT;
-    return -1;
-  }
-  LOG("FileSystem::connect: [%s] port %d\n", hostname.c_str(), port);
+    if (IsAgentConnect(serv_addr, addrlen, &hostname, &port)) {
+      // If the request is for the auth agent,
+      // make sure to punt request to JS proxy.
+      use_js_socket_ = true;
+    } else if (!GetHostPort(fd, serv_addr, addrlen, &hostname, &port)) {
+      errno = EAFNOSUPPORT;
+      return -1;
+    }
 
-  FileStream* stream = NULL;
-  if (use_js_socket_) {
     // Only first socket and auth sockets need JS proxy.
     // Clear flag so other sockets will use Pepper by default.
+    use_js_socket = use_js_socket_;
     use_js_socket_ = false;
+  }
+  LOG("FileSystem::connect: [%s] port %d\n", hostname.c_str(), port);
+
+  // Connecting blocks until the peer answers, so only the new stream is
+  // locked meanwhile.
+  FileStream* stream = NULL;
+  if (use_js_socket) {
     JsSocket* socket = new JsSocket(fd, O_RDWR, output_);
-    if (!socket->connect(hostname.c_str(), port)) {
+    bool connected;
+    {
+      Mutex::Lock lock(socket->mutex());
+      connected = socket->connect(hostname.c_str(), port);
+    }
+    if (!connected) {
       errno = ECONNREFUSED;
       socket->release();
       return -1;
@@ -859,7 +899,12 @@ int FileSystem::connect(int fd, const sockaddr* serv_addr, socklen_t addrlen) {
     stream = socket;
   } else {
     TCPSocket* socket = new TCPSocket(fd, O_RDWR);
-    if (!socket->connect(hostname.c_str(), port)) {
+    bool connected;
+    {
+      Mutex::Lock lock(socket->mutex());
+      connected = socket->connect(hostname.c_str(), port);
+    }
+    if (!connected) {
       errno = ECONNREFUSED;
       socket->release();
       return -1;
@@ -867,14 +912,18 @@ int FileSystem::connect(int fd, const sockaddr* serv_addr, socklen_t addrlen) {
     stream = socket;
   }
 
-  AddFileStream(fd, stream);
+  // The descriptor may have been closed while we were connecting.
+  if (!AddSocketStream(fd, stream)) {
+    CloseStream(stream);
+    errno = EBADF;
+    return -1;
+  }
   return 0;
 }
 
 int FileSystem::shutdown(int fd, int how) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(fd);
-  if (stream && stream != kBadFileStream) {
+  LockedStream stream(GetStreamRef(fd));
+  if (stream.get()) {
     // Actually shutdown should be something more complicated but for now
     // it works. Method close can be called multiple time.
     stream->close();
@@ -885,21 +934,65 @@ int FileSystem::shutdown(int fd, int how) {
   }
 }
 
-int FileSystem::bind(int fd, const sockaddr* addr, socklen_t addrlen) {
+int FileSystem::GetSocketType(int fd) {
   Mutex::Lock lock(mutex_);
-  if (streams_.find(fd) == streams_.end() ||
-      socket_types_.find(fd) == socket_types_.end()) {
+  SocketTypesMap::iterator it = socket_types_.find(fd);
+  if (!streams_.IsUsed(fd) || it == socket_types_.end())
+    return -1;
+  return it->second;
+}
+
+bool FileSystem::AddSocketStream(int fd, FileStream* stream) {
+  // Keep the stream locked until the options are applied so that options set
+  // through the new stream meanwhile aren't overridden by older ones.
+  Mutex::Lock stream_lock(stream->mutex());
+  SocketOptionList options;
+  {
+    Mutex::Lock lock(mutex_);
+    if (!streams_.IsUsed(fd) || GetStream(fd))
+      return false;
+    AddFileStream(fd, stream);
+    SocketOptionsMap::iterator it = socket_options_.find(fd);
+    if (it != socket_options_.end()) {
+      options.swap(it->second);
+      socket_options_.erase(it);
+    }
+  }
+
+  for (size_t i = 0; i < options.size(); i++) {
+    const SocketOption& option = options[i];
+    const char* value = option.value.empty() ? NULL : &option.value[0];
+    int err = stream->setsockopt(option.level, option.name,
+                                 value, option.value.size());
+    if (err && err != ENOPROTOOPT) {
+      LOG("FileSystem::AddSocketStream: %d option %d/%d failed %d\n",
+          fd, option.level, option.name, err);
+    }
+  }
+  return true;
+}
+
+int FileSystem::bind(int fd, const sockaddr* addr, socklen_t addrlen) {
+  int type = GetSocketType(fd);
+  if (type == -1) {
     errno = EBADF;
     return -1;
   }
 
-  switch (socket_types_[fd]) {
-    case SOCK_STREAM:
-      AddFileStream(fd, new TCPServerSocket(fd, 0, addr, addrlen));
+  switch (type) {
+    case SOCK_STREAM: {
+      FileStream* stream = new TCPServerSocket(fd, 0, addr, addrlen);
+      if (!AddSocketStream(fd, stream)) {
+        stream->release();
+        errno = EBADF;
+        return -1;
+      }
       return 0;
+    }
 
     case SOCK_DGRAM: {
-      UDPSocket* socket = static_cast<UDPSocket*>(GetStream(fd));
+      LockedStream stream(GetStreamRef(fd));
+      UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
       if (socket && socket->bind(addr, addrlen)) {
         return 0;
       } else {
@@ -914,10 +1007,9 @@ int FileSystem::bind(int fd, const sockaddr* addr, socklen_t addrlen) {
 }
 
 int FileSystem::listen(int sockfd, int backlog) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(sockfd);
-  if (stream && stream != kBadFileStream) {
-    if (static_cast<TCPServerSocket*>(stream)->listen(backlog)) {
+  LockedStream stream(GetStreamRef(sockfd));
+  if (stream.get()) {
+    if (static_cast<TCPServerSocket*>(stream.get())->listen(backlog)) {
       return 0;
     } else {
       errno = EACCES;
@@ -930,55 +1022,170 @@ int FileSystem::listen(int sockfd, int backlog) {
 }
 
 int FileSystem::accept(int sockfd, sockaddr* addr, socklen_t* addrlen) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(sockfd);
-  if (stream && stream != kBadFileStream) {
-    PP_Resource resource = static_cast<TCPServerSocket*>(stream)->accept();
-    if (resource) {
-      int fd = GetFirstUnusedDescriptor();
-      TCPSocket* socket = new TCPSocket(fd, O_RDWR);
-      if (socket->accept(resource)) {
-        AddFileStream(fd, socket);
-        return fd;
-      } else {
-        socket->release();
-      }
+  PP_Resource resource;
+  {
+    LockedStream stream(GetStreamRef(sockfd));
+    if (!stream.get()) {
+      errno = EBADF;
+      return -1;
     }
-    errno = EINVAL;
-    return -1;
-  } else {
+    resource = static_cast<TCPServerSocket*>(stream.get())->accept();
+  }
+
+  if (resource) {
+    int fd;
+    {
+      Mutex::Lock lock(mutex_);
+      fd = streams_.Allocate();
+    }
+    TCPSocket* socket = new TCPSocket(fd, O_RDWR);
+    bool accepted;
+    {
+      Mutex::Lock lock(socket->mutex());
+      accepted = socket->accept(resource);
+    }
+
+    Mutex::Lock lock(mutex_);
+    if (accepted) {
+      AddFileStream(fd, socket);
+      return fd;
+    }
+    socket->release();
+    RemoveFileStream(fd);
+  }
+  errno = EINVAL;
+  return -1;
+}
+
+int FileSystem::getsockname(int sockfd, sockaddr* name, socklen_t* namelen) {
+  if (GetSocketType(sockfd) == SOCK_DGRAM) {
+    LockedStream stream(GetStreamRef(sockfd));
+    if (stream.get()) {
+      UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
+      return socket->getsockname(name, namelen);
+    }
+  }
+
+  // TOOD(dpolukhin): implement getsockname for TCP sockets. Now it is
+  // impossible to implement for TCP server sockets because Pepper doesn't
+  // have method to get bound address.
+  sockaddr_in* sin4 = reinterpret_cast<sockaddr_in*>(name);
+  sin4->sin_family = AF_INET;
+  sin4->sin_port = htons(0);
+  inet_aton("127.0.0.1", &sin4->sin_addr);
+  *namelen = sizeof(sockaddr_in);
+  return 0;
+}
+
+int FileSystem::setsockopt(int sockfd, int level, int optname,
+                           const void* optval, socklen_t optlen) {
+  if (GetSocketType(sockfd) == -1) {
     errno = EBADF;
     return -1;
   }
+
+  int err;
+  while (true) {
+    LockedStream stream(GetStreamRef(sockfd));
+    if (stream.get()) {
+      err = stream->setsockopt(level, optname, optval, optlen);
+      break;
+    }
+
+    // Stream sockets only get their stream in connect() or bind(), keep the
+    // option until then.
+    Mutex::Lock lock(mutex_);
+    if (!streams_.IsUsed(sockfd)) {
+      err = EBADF;
+      break;
+    }
+    if (!GetStream(sockfd)) {
+      const char* value = static_cast<const char*>(optval);
+      SocketOption option = { level, optname,
+                              std::vector<char>(value, value + optlen) };
+      socket_options_[sockfd].push_back(option);
+      err = 0;
+      break;
+    }
+    // The stream was added meanwhile, try again with it.
+  }
+
+  if (err == ENOPROTOOPT) {
+    // Options we don't support are silently ignored like they used to be.
+    LOG("FileSystem::setsockopt: %d ignored option %d/%d\n",
+        sockfd, level, optname);
+    err = 0;
+  }
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  return 0;
 }
 
-int FileSystem::getsockname(int sockfd, sockaddr* name, socklen_t* namelen) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(sockfd);
-  if (stream && stream != kBadFileStream &&
-      socket_types_[sockfd] == SOCK_DGRAM) {
-    UDPSocket* socket = static_cast<UDPSocket*>(stream);
-    return socket->getsockname(name, namelen);
-  } else {
-    // TOOD(dpolukhin): implement getsockname for TCP sockets. Now it is
-    // impossible to implement for TCP server sockets because Pepper doesn't
-    // have method to get bound address.
-    sockaddr_in* sin4 = reinterpret_cast<sockaddr_in*>(name);
-    sin4->sin_family = AF_INET;
-    sin4->sin_port = htons(0);
-    inet_aton("127.0.0.1", &sin4->sin_addr);
-    *namelen = sizeof(sockaddr_in);
-    return 0;
+int FileSystem::getsockopt(int sockfd, int level, int optname,
+                           void* optval, socklen_t* optlen) {
+  int type = GetSocketType(sockfd);
+  if (type == -1) {
+    errno = EBADF;
+    return -1;
+  }
+
+  int err = ENOPROTOOPT;
+  {
+    LockedStream stream(GetStreamRef(sockfd));
+    if (stream.get())
+      err = stream->getsockopt(level, optname, optval, optlen);
+  }
+
+  if (err == ENOPROTOOPT) {
+    // Report the last value set on a socket without a stream.
+    Mutex::Lock lock(mutex_);
+    SocketOptionsMap::iterator it = socket_options_.find(sockfd);
+    if (it != socket_options_.end()) {
+      const SocketOptionList& options = it->second;
+      for (size_t i = options.size(); i > 0; i--) {
+        const SocketOption& option = options[i - 1];
+        if (option.level == level && option.name == optname) {
+          *optlen = std::min(*optlen, (socklen_t)option.value.size());
+          if (*optlen)
+            memcpy(optval, &option.value[0], *optlen);
+          err = 0;
+          break;
+        }
+      }
+    }
   }
+
+  if (err == ENOPROTOOPT && level == SOL_SOCKET) {
+    if (optname == SO_TYPE)
+      err = SetIntOption(type, optval, optlen);
+    else if (optname == SO_ERROR)
+      err = SetIntOption(0, optval, optlen);
+  }
+
+  if (err == ENOPROTOOPT) {
+    // Everything else reads as zero.
+    memset(optval, 0, *optlen);
+    err = 0;
+  }
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  return 0;
 }
 
 ssize_t FileSystem::sendto(int sockfd, const char* buf, size_t len, int flags,
                            const sockaddr* dest_addr, socklen_t addrlen) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(sockfd);
-  if (stream && stream != kBadFileStream &&
-      socket_types_[sockfd] == SOCK_DGRAM) {
-    UDPSocket* socket = static_cast<UDPSocket*>(stream);
+  if (GetSocketType(sockfd) != SOCK_DGRAM) {
+    errno = EBADF;
+    return -1;
+  }
+
+  LockedStream stream(GetStreamRef(sockfd));
+  if (stream.get()) {
+    UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
     return socket->sendto(buf, len, flags, dest_addr, addrlen);
   } else {
     errno = EBADF;
@@ -988,11 +1195,14 @@ ssize_t FileSystem::sendto(int sockfd, const char* buf, size_t len, int flags,
 
 ssize_t FileSystem::recvfrom(int sockfd, char* buffer, size_t len, int flags,
                              sockaddr* addr, socklen_t* addrlen) {
-  Mutex::Lock lock(mutex_);
-  FileStream* stream = GetStream(sockfd);
-  if (stream && stream != kBadFileStream &&
-      socket_types_[sockfd] == SOCK_DGRAM) {
-    UDPSocket* socket = static_cast<UDPSocket*>(stream);
+  if (GetSocketType(sockfd) != SOCK_DGRAM) {
+    errno = EBADF;
+    return -1;
+  }
+
+  LockedStream stream(GetStreamRef(sockfd));
+  if (stream.get()) {
+    UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
     return socket->recvfrom(buffer, len, flags, addr, addrlen);
   } else {
     errno = EBADF;
@@ -1000,8 +1210,124 @@ ssize_t FileSystem::recvfrom(int sockfd, char* buffer, size_t len, int flags,
   }
 }
 
+ssize_t FileSystem::sendmsg(int sockfd, const msghdr* msg, int flags) {
+  int type = GetSocketType(sockfd);
+  if (type == -1) {
+    errno = EBADF;
+    return -1;
+  }
+
+  LockedStream stream(GetStreamRef(sockfd));
+  if (!stream.get()) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (type == SOCK_DGRAM) {
+    UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
+    return socket->sendmsg(msg, flags);
+  }
+
+  // Connected sockets ignore the address, like send().
+  size_t nwrote;
+  int err = stream->writev(msg->msg_iov, msg->msg_iovlen, &nwrote);
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  return nwrote;
+}
+
+ssize_t FileSystem::recvmsg(int sockfd, msghdr* msg, int flags) {
+  int type = GetSocketType(sockfd);
+  if (type == -1) {
+    errno = EBADF;
+    return -1;
+  }
+
+  LockedStream stream(GetStreamRef(sockfd));
+  if (!stream.get()) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (type == SOCK_DGRAM) {
+    UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
+    return socket->recvmsg(msg, flags);
+  }
+
+  size_t nread;
+  int err = stream->readv(msg->msg_iov, msg->msg_iovlen, &nread);
+  if (err) {
+    errno = err;
+    return -1;
+  }
+  msg->msg_namelen = 0;
+  msg->msg_controllen = 0;
+  msg->msg_flags = 0;
+  return nread;
+}
+
+int FileSystem::sendmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen,
+                         int flags) {
+  int type = GetSocketType(sockfd);
+  if (type == -1) {
+    errno = EBADF;
+    return -1;
+  }
+  if (type != SOCK_DGRAM) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+
+  // The whole batch is queued under a single lock.
+  LockedStream stream(GetStreamRef(sockfd));
+  if (!stream.get()) {
+    errno = EBADF;
+    return -1;
+  }
+  UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
+  return socket->sendmmsg(msgvec, vlen, flags);
+}
+
+int FileSystem::recvmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen,
+                         int flags, const timespec* timeout) {
+  int type = GetSocketType(sockfd);
+  if (type == -1) {
+    errno = EBADF;
+    return -1;
+  }
+  if (type != SOCK_DGRAM) {
+    errno = EOPNOTSUPP;
+    return -1;
+  }
+
+  timespec ts_abs;
+  if (timeout)
+    GetDeadline(timeout->tv_sec * kMicrosecondsPerSecond +
+                timeout->tv_nsec / kNanosecondsPerMicrosecond, &ts_abs);
+
+  LockedStream stream(GetStreamRef(sockfd));
+  if (!stream.get()) {
+    errno = EBADF;
+    return -1;
+  }
+  UDPSocket* socket = static_cast<UDPSocket*>(stream.get());
+  return socket->recvmmsg(msgvec, vlen, flags, timeout ? &ts_abs : NULL);
+}
+
 int FileSystem::mkdir(const char* pathname, mode_t mode) {
   Mutex::Lock lock(mutex_);
+  PathHandler* handler = mounts_.Find(pathname);
+  if (handler) {
+    int err = handler->mkdir(pathname, mode);
+    if (err) {
+      errno = err;
+      return -1;
+    }
+    return 0;
+  }
+
   while (!fs_initialized_)
     cond_.wait(mutex_);
 
@@ -1016,6 +1342,8 @@ int FileSystem::mkdir(const char* pathname, mode_t mode) {
                                    pathname, &result));
   while (result == PP_OK_COMPLETIONPENDING)
     cond_.wait(mutex_);
+  // Missing ancestors may have been created too.
+  ppfs_path_handler_->InvalidateWithAncestors(pathname);
   return (result == PP_OK) ? 0 : -1;
 }
 
@@ -1034,6 +1362,18 @@ int FileSystem::sigaction(int signum,
 }
 
 void FileSystem::exit(int status) {
+  // Files hold back writes and nothing closes them on the way out.
+  int nfds;
+  {
+    Mutex::Lock lock(mutex_);
+    nfds = streams_.size();
+  }
+  for (int fd = 0; fd < nfds; fd++) {
+    LockedStream stream(GetStreamRef(fd));
+    if (stream.get())
+      stream->fsync();
+  }
+
   Mutex::Lock lock(mutex_);
   output_->SendExitCode(status);
   // Wait for the page to ACK it, so we can abort.
@@ -1073,7 +1413,7 @@ void FileSystem::SetTerminalSize(unsigned short col, unsigned short row) {
   col_ = col;
   row_ = row;
   is_resize_ = true;
-  cond_.broadcast();
+  signal_queue_.broadcast();
 }
 
 bool FileSystem::GetTerminalSize(unsigned short* col, unsigned short* row) {
@@ -1132,3 +1472,19 @@ bool FileSystem::CreateSocketAddress(const PP_NetAddress_Private& addr,
   }
   return false;
 }
+
+int FileSystem::GetIntOption(const void* optval, socklen_t optlen,
+                             int* value) {
+  if (!optval || optlen < sizeof(int))
+    return EINVAL;
+  memcpy(value, optval, sizeof(int));
+  return 0;
+}
+
+int FileSystem::SetIntOption(int value, void* optval, socklen_t* optlen) {
+  if (!optval || !optlen || *optlen < sizeof(int))
+    return EINVAL;
+  memcpy(optval, &value, sizeof(int));
+  *optlen = sizeof(int);
+  return 0;
+}
@@ -9,6 +9,7 @@
 #include <errno.h>
 #include <memory.h>
 #include <netdb.h>
+#include <poll.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <sys/ioctl.h>
@@ -18,15 +19,30 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include "ppapi/cpp/file_ref.h"
 #include "ppapi/cpp/file_system.h"
-#include "ppapi/cpp/private/host_resolver_private.h"
 #include "ppapi/utility/completion_callback_factory.h"
 
+#include "file_descriptor_table.h"
+#include "fake_address_pool.h"
 #include "file_interfaces.h"
+#include "host_resolver.h"
+#include "mount_table.h"
+#include "poll_set.h"
 #include "pthread_helpers.h"
 
+#if !defined(__GLIBC__)
+// newlib lacks the batched socket calls.
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+#endif
+
+class PepperFileHandler;
+
 class FileSystem {
  public:
   FileSystem(pp::Instance* instance, OutputInterface* out);
@@ -42,8 +58,6 @@ class FileSystem {
 
   void WaitForStdFiles();
 
-  Cond& cond() { return cond_; }
-  Mutex& mutex() { return mutex_; }
   pp::Instance* instance() { return instance_; }
 
   void SetTerminalSize(unsigned short col, unsigned short row);
@@ -56,16 +70,29 @@ class FileSystem {
                                PP_NetAddress_Private* addr);
   static bool CreateSocketAddress(const PP_NetAddress_Private& addr,
                                   sockaddr* saddr, socklen_t* addrlen);
+  // Helpers for socket options that take an int.  They return 0 or an errno
+  // value.
+  static int GetIntOption(const void* optval, socklen_t optlen, int* value);
+  static int SetIntOption(int value, void* optval, socklen_t* optlen);
 
   // Syscall implementations.
   int open(const char* pathname, int oflag, mode_t cmode, int* newfd);
   int close(int fd);
   int read(int fd, char* buf, size_t count, size_t* nread);
   int write(int fd, const char* buf, size_t count, size_t* nwrote);
+  int readv(int fd, const iovec* iov, int iovcnt, size_t* nread);
+  int writev(int fd, const iovec* iov, int iovcnt, size_t* nwrote);
+  int pread(int fd, char* buf, size_t count, nacl_abi_off_t offset,
+            size_t* nread);
+  int pwrite(int fd, const char* buf, size_t count, nacl_abi_off_t offset,
+             size_t* nwrote);
+  int fsync(int fd);
+  int ftruncate(int fd, nacl_abi_off_t length);
   int seek(int fd, nacl_abi_off_t offset, int whence,
            nacl_abi_off_t* new_offset);
   int dup(int fd, int* newfd);
   int dup2(int fd, int newfd);
+  int pipe(int fds[2]);
   int fstat(int fd, nacl_abi_stat* out);
   int stat(const char* pathname, nacl_abi_stat* out);
   void readpass(const char* prompt, char* buf, size_t buf_len, bool echo);
@@ -77,6 +104,7 @@ class FileSystem {
   int ioctl(int fd, int request, va_list ap);
   int select(int nfds, fd_set* readfds, fd_set* writefds,
              fd_set* exceptfds, struct timeval* timeout);
+  int poll(pollfd* fds, nfds_t nfds, const timespec* timeout);
 
   int getaddrinfo(const char* hostname, const char* servname,
                   const addrinfo* hints, addrinfo** res);
@@ -86,16 +114,26 @@ class FileSystem {
                   char* serv, size_t servlen, int flags);
 
   int socket(int socket_family, int socket_type, int protocol);
+  int socketpair(int domain, int type, int protocol, int fds[2]);
   int connect(int sockfd, const sockaddr* serv_addr, socklen_t addrlen);
   int shutdown(int sockfd, int how);
   int bind(int sockfd, const sockaddr* serv_addr, socklen_t addrlen);
   int listen(int sockfd, int backlog);
   int accept(int sockfd, sockaddr* addr, socklen_t* addrlen);
   int getsockname(int s, sockaddr* name, socklen_t* namelen);
+  int setsockopt(int sockfd, int level, int optname,
+                 const void* optval, socklen_t optlen);
+  int getsockopt(int sockfd, int level, int optname,
+                 void* optval, socklen_t* optlen);
   ssize_t sendto(int sockfd, const char* buf, size_t len, int flags,
                  const sockaddr* dest_addr, socklen_t addrlen);
   ssize_t recvfrom(int socket, char* buffer, size_t len, int flags,
                    sockaddr* addr, socklen_t* addrlen);
+  ssize_t sendmsg(int sockfd, const msghdr* msg, int flags);
+  ssize_t recvmsg(int sockfd, msghdr* msg, int flags);
+  int sendmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen, int flags);
+  int recvmmsg(int sockfd, mmsghdr* msgvec, unsigned int vlen, int flags,
+               const timespec* timeout);
 
   int mkdir(const char* pathname, mode_t mode);
 
@@ -108,74 +146,83 @@ class FileSystem {
   void ReadPassResult(const std::string pass);
 
  private:
-  typedef std::map<int, FileStream*> FileStreamMap;
-  typedef std::map<std::string, PathHandler*> PathHandlerMap;
-  typedef std::map<std::string, unsigned long> HostMap;
-  typedef std::map<unsigned long, std::string> AddressMap;
+  typedef std::map<int, uint32_t> FakeAddressRefMap;
   typedef std::map<int, int> SocketTypesMap;
 
-  struct GetAddrInfoParams {
-    const char* hostname;
-    const char* servname;
-    const struct addrinfo* hints;
-    struct addrinfo** res;
+  struct SocketOption {
+    int level;
+    int name;
+    std::vector<char> value;
   };
+  typedef std::vector<SocketOption> SocketOptionList;
+  typedef std::map<int, SocketOptionList> SocketOptionsMap;
 
+  // Serve |path| from |handler|, or the whole subtree if |path| ends in a
+  // slash.  Paths without a handler go to the HTML5 file system.
   void AddPathHandler(const std::string& path, PathHandler* handler);
   void AddFileStream(int fd, FileStream* stream);
   void RemoveFileStream(int fd);
 
-  bool IsKnowDescriptor(int fd);
   FileStream* GetStream(int fd);
+  // Like GetStream() but takes |mutex_| and returns the stream with a
+  // reference held, or NULL if |fd| has no usable stream.
+  FileStream* GetStreamRef(int fd);
+  // Close and release a stream that was removed from the table.
+  void CloseStream(FileStream* stream);
+  int GetSocketType(int fd);
+  // Add the stream a socket gets in connect() or bind() and apply the options
+  // set on the socket before.  Return false if |fd| was closed meanwhile.
+  bool AddSocketStream(int fd, FileStream* stream);
 
-  uint32_t AddHostAddress(const char* name, uint32_t addr);
-  addrinfo* CreateAddrInfo(const PP_NetAddress_Private& addr,
-                           const addrinfo* hints,
-                           const char* name);
   addrinfo* GetFakeAddress(const char* hostname, uint16_t port,
                            const addrinfo* hints);
-  bool GetHostPort(const sockaddr* serv_addr, socklen_t addrlen,
+  // Return the host and port to connect socket |fd| to.  A fake address
+  // keeps its name for as long as |fd| is open.
+  bool GetHostPort(int fd, const sockaddr* serv_addr, socklen_t addrlen,
                    std::string* hostname, uint16_t* port);
   bool IsAgentConnect(const sockaddr* serv_addr, socklen_t addrlen,
                       std::string* hostname, uint16_t* port);
-  void Resolve(int32_t result, GetAddrInfoParams* params, int32_t* pres);
-  void OnResolve(int32_t result, GetAddrInfoParams* params, int32_t* pres);
 
   void OnOpen(int32_t result, pp::FileSystem* fs);
 
   void MakeDirectory(int32_t result, const char* pathname, int32_t* pres);
   void OnMakeDirectory(int32_t result, pp::FileRef* file_ref, int32_t* pres);
 
-  int GetFirstUnusedDescriptor();
-  int IsReady(int nfds, fd_set* fds, bool (FileStream::*is_ready)(),
-              bool apply);
+  int WaitForEvents(PollSet* set, const timespec* ts_abs);
   bool IsInterrupted();
 
   static const int kFileIDOffset = 16;
-  static const unsigned long kFirstAddr = 0x00000000;
 
   static FileSystem* file_system_;
 
   pp::Instance* instance_;
   OutputInterface* output_;
   Cond cond_;
+  // Guards the descriptor table and the rest of the state of FileSystem.  Each
+  // stream has its own mutex for I/O, see FileStream::mutex().  A stream mutex
+  // may be held when taking |mutex_| but never the other way around, so
+  // syscalls look the stream up first and drop |mutex_| before locking it.
   Mutex mutex_;
+  // Woken when a signal is raised so that select() and poll() can be
+  // interrupted.
+  WaitQueue signal_queue_;
 
-  PathHandlerMap paths_;
-  FileStreamMap streams_;
+  MountTable mounts_;
+  FileDescriptorTable streams_;
   pp::FileSystem* ppfs_;
-  PathHandler* ppfs_path_handler_;
+  PepperFileHandler* ppfs_path_handler_;
   bool fs_initialized_;
   pp::CompletionCallbackFactory<FileSystem> factory_;
   bool exit_code_acked_;
   std::string read_pass_result_;
   bool read_pass_available_;
 
-  pp::HostResolverPrivate* host_resolver_;
+  HostResolver host_resolver_;
 
-  HostMap hosts_;
-  AddressMap addrs_;
-  unsigned long first_unused_addr_;
+  // Addresses standing in for names that are resolved by JavaScript, and the
+  // one each socket connected to.
+  FakeAddressPool fake_addrs_;
+  FakeAddressRefMap fake_addr_refs_;
   bool use_js_socket_;
 
   unsigned short col_;
@@ -186,6 +233,8 @@ class FileSystem {
   // TODO(dpolukhin): remove this map and put all socket related info into
   // FileStream with type socket.
   SocketTypesMap socket_types_;
+  // Options set on sockets that don't have a stream yet.
+  SocketOptionsMap socket_options_;
 
   DISALLOW_COPY_AND_ASSIGN(FileSystem);
 };
@@ -0,0 +1,172 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "host_resolver.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+namespace {
+
+int64_t GetTimeUs() {
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+// Round |size| up so that whatever follows it in an allocation is aligned.
+size_t Align(size_t size) {
+  const size_t kAlign = sizeof(void*) > 8 ? sizeof(void*) : 8;
+  return (size + kAlign - 1) & ~(kAlign - 1);
+}
+
+}  // namespace
+
+HostResolver::Query::Query(HostResolver* resolver, const Key& key)
+    : resolver_(resolver), key_(key), done_(false), waiters_(0) {
+}
+
+void HostResolver::Query::Complete(const Result& result) {
+  resolver_->OnComplete(this, result);
+}
+
+HostResolver::HostResolver(Backend* backend) : backend_(backend) {
+}
+
+HostResolver::~HostResolver() {
+  assert(queries_.empty());
+  delete backend_;
+}
+
+void HostResolver::Lookup(const std::string& hostname, int family,
+                          Result* result) {
+  Query::Key key(hostname, family);
+  Mutex::Lock lock(mutex_);
+
+  Cache::iterator it = cache_.find(key);
+  if (it != cache_.end()) {
+    if (it->second.expires_us > GetTimeUs()) {
+      *result = it->second.result;
+      return;
+    }
+    cache_.erase(it);
+  }
+
+  Query* query;
+  QueryMap::iterator qit = queries_.find(key);
+  if (qit != queries_.end()) {
+    query = qit->second;
+    query->waiters_++;
+  } else {
+    query = new Query(this, key);
+    query->waiters_++;
+    queries_[key] = query;
+    backend_->Resolve(query);
+  }
+
+  while (!query->done_)
+    cond_.wait(mutex_);
+
+  *result = query->result_;
+  if (--query->waiters_ == 0)
+    delete query;
+}
+
+void HostResolver::OnComplete(Query* query, const Result& result) {
+  Mutex::Lock lock(mutex_);
+  assert(!query->done_);
+  int64_t now_us = GetTimeUs();
+  TrimCache(now_us);
+  CacheEntry& entry = cache_[query->key_];
+  entry.result = result;
+  entry.expires_us = now_us + (result.ok ? kPositiveTtlUs : kNegativeTtlUs);
+
+  queries_.erase(query->key_);
+  query->result_ = result;
+  query->done_ = true;
+  cond_.broadcast();
+}
+
+void HostResolver::TrimCache(int64_t now_us) {
+  if (cache_.size() < kMaxCacheEntries)
+    return;
+
+  Cache::iterator oldest = cache_.end();
+  for (Cache::iterator it = cache_.begin(); it != cache_.end();) {
+    if (it->second.expires_us <= now_us) {
+      cache_.erase(it++);
+      continue;
+    }
+    if (oldest == cache_.end() ||
+        it->second.expires_us < oldest->second.expires_us) {
+      oldest = it;
+    }
+    ++it;
+  }
+
+  if (cache_.size() >= kMaxCacheEntries)
+    cache_.erase(oldest);
+}
+
+addrinfo* HostResolver::CreateAddrInfo(const Address* addresses, size_t count,
+                                       uint16_t port, const addrinfo* hints,
+                                       const char* canonical_name) {
+  if (count == 0)
+    return NULL;
+
+  // All entries, their addresses and the name share one block that starts
+  // with the first entry, so freeing the list is a single free().
+  size_t ai_size = Align(sizeof(addrinfo));
+  size_t addr_size = Align(sizeof(sockaddr_in6));
+  size_t name_size = strlen(canonical_name) + 1;
+  char* block = static_cast<char*>(
+      calloc(1, count * (ai_size + addr_size) + name_size));
+  if (!block)
+    return NULL;
+
+  char* name = block + count * (ai_size + addr_size);
+  memcpy(name, canonical_name, name_size);
+
+  addrinfo* first = NULL;
+  addrinfo** next = &first;
+  for (size_t i = 0; i < count; i++) {
+    addrinfo* ai = reinterpret_cast<addrinfo*>(block + i * ai_size);
+    char* addr = block + count * ai_size + i * addr_size;
+
+    ai->ai_family = addresses[i].family;
+    ai->ai_addr = reinterpret_cast<sockaddr*>(addr);
+    if (addresses[i].family == AF_INET6) {
+      sockaddr_in6* sin6 = reinterpret_cast<sockaddr_in6*>(addr);
+      sin6->sin6_family = AF_INET6;
+      sin6->sin6_port = port;
+      sin6->sin6_addr = addresses[i].v6;
+      ai->ai_addrlen = sizeof(sockaddr_in6);
+    } else {
+      sockaddr_in* sin = reinterpret_cast<sockaddr_in*>(addr);
+      sin->sin_family = AF_INET;
+      sin->sin_port = port;
+      sin->sin_addr = addresses[i].v4;
+      ai->ai_addrlen = sizeof(sockaddr_in);
+    }
+
+    ai->ai_canonname = name;
+    if (hints && hints->ai_socktype)
+      ai->ai_socktype = hints->ai_socktype;
+    else
+      ai->ai_socktype = SOCK_STREAM;
+    if (hints && hints->ai_protocol)
+      ai->ai_protocol = hints->ai_protocol;
+
+    *next = ai;
+    next = &ai->ai_next;
+  }
+  return first;
+}
+
+void HostResolver::FreeAddrInfo(addrinfo* ai) {
+  free(ai);
+}
@@ -0,0 +1,120 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef HOST_RESOLVER_H
+#define HOST_RESOLVER_H
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "pthread_helpers.h"
+
+// Resolves host names through a backend and caches the answers.
+//
+// Any number of threads may look names up at once.  Lookups of the same name
+// share one backend query, and answers, including failures, are kept for a
+// while so that repeated lookups of a name don't go to the backend at all.
+class HostResolver {
+ public:
+  // An address without a port.
+  struct Address {
+    int family;  // AF_INET or AF_INET6.
+    union {
+      in_addr v4;
+      in6_addr v6;
+    };
+  };
+
+  struct Result {
+    Result() : ok(false) {}
+
+    bool ok;
+    std::string canonical_name;
+    std::vector<Address> addresses;
+  };
+
+  class Query {
+   public:
+    const std::string& hostname() const { return key_.first; }
+    // AF_INET, AF_INET6 or AF_UNSPEC for any.
+    int family() const { return key_.second; }
+
+    // Report the outcome of the query.  Must be called exactly once, from any
+    // thread.
+    void Complete(const Result& result);
+
+   private:
+    friend class HostResolver;
+    typedef std::pair<std::string, int> Key;
+
+    Query(HostResolver* resolver, const Key& key);
+
+    HostResolver* resolver_;
+    Key key_;
+    bool done_;
+    Result result_;
+    // Number of Lookup() calls waiting for the query.
+    int waiters_;
+
+    DISALLOW_COPY_AND_ASSIGN(Query);
+  };
+
+  class Backend {
+   public:
+    virtual ~Backend() {}
+
+    // Start resolving |query|.  Called with the resolver's lock held, so the
+    // query may be completed right away or later from another thread.
+    virtual void Resolve(Query* query) = 0;
+  };
+
+  // Takes ownership of |backend|.
+  explicit HostResolver(Backend* backend);
+  ~HostResolver();
+
+  // Look up |hostname| for |family|, blocking until the backend answers
+  // unless a recent enough answer is cached.
+  void Lookup(const std::string& hostname, int family, Result* result);
+
+  // Build a getaddrinfo() result for |count| |addresses| in a single
+  // allocation.  Release it with FreeAddrInfo().
+  static addrinfo* CreateAddrInfo(const Address* addresses, size_t count,
+                                  uint16_t port, const addrinfo* hints,
+                                  const char* canonical_name);
+  static void FreeAddrInfo(addrinfo* ai);
+
+ private:
+  struct CacheEntry {
+    Result result;
+    int64_t expires_us;
+  };
+  typedef std::map<Query::Key, CacheEntry> Cache;
+  typedef std::map<Query::Key, Query*> QueryMap;
+
+  void OnComplete(Query* query, const Result& result);
+  // Make room for a new cache entry.
+  void TrimCache(int64_t now_us);
+
+  static const size_t kMaxCacheEntries = 256;
+  static const int64_t kPositiveTtlUs = 60 * 1000 * 1000;
+  static const int64_t kNegativeTtlUs = 5 * 1000 * 1000;
+
+  Backend* backend_;
+  // Guards everything below and the queries.
+  Mutex mutex_;
+  Cond cond_;
+  Cache cache_;
+  // Queries the backend is working on.
+  QueryMap queries_;
+
+  DISALLOW_COPY_AND_ASSIGN(HostResolver);
+};
+
+#endif  // HOST_RESOLVER_H
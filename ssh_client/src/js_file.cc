@@ -5,16 +5,44 @@
 #include "js_file.h"
 
 #include <algorithm>
+#include <string>
 
 #include <assert.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 
 #include "ppapi/cpp/module.h"
 
+#include "base64.h"
 #include "file_system.h"
 #include "proxy_stream.h"
 
+namespace {
+
+// Bounds of the adaptive write window.
+const size_t kMinWriteWindow = 4 * 1024;
+const size_t kMaxWriteWindow = 1024 * 1024;
+// Acknowledgements slower than this mean JavaScript has more output queued
+// than it can render promptly, faster ones leave room for a larger window.
+const int64_t kTargetAckLatencyUs = 50 * 1000;
+// Window changes are reported to JavaScript at most this often.
+const int64_t kWriteStatsIntervalUs = 1000 * 1000;
+
+// How much input to ask for at once in canonical mode.  JavaScript returns
+// whatever it has up to this, which is normally the rest of the line.
+const size_t kCanonicalReadSize = 64 * 1024;
+
+int64_t GetTimeUs() {
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+}  // namespace
+
 termios JsFile::tio_ = {};
+Mutex JsFile::tio_mutex_;
 
 JsFileHandler::JsFileHandler(OutputInterface* out)
     : ref_(1), factory_(this), out_(out) {
@@ -25,11 +53,11 @@ JsFileHandler::~JsFileHandler() {
 }
 
 void JsFileHandler::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void JsFileHandler::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -43,9 +71,11 @@ FileStream* JsFileHandler::open(int fd, const char* pathname, int oflag,
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&JsFileHandler::Open, stream, pathname));
 
-  FileSystem* sys = FileSystem::GetFileSystem();
-  while (!stream->is_open())
-    sys->cond().wait(sys->mutex());
+  {
+    Mutex::Lock lock(stream->mutex());
+    while (!stream->is_open())
+      stream->wait_queue().wait(stream->mutex());
+  }
 
   if (stream->fd() == -1) {
     stream->release();
@@ -56,7 +86,11 @@ FileStream* JsFileHandler::open(int fd, const char* pathname, int oflag,
 }
 
 int JsFileHandler::stat(const char* pathname, nacl_abi_stat* out) {
+  // Only terminals live here and asking JavaScript about them would tell us
+  // nothing new.
   memset(out, 0, sizeof(nacl_abi_stat));
+  out->nacl_abi_st_mode = S_IFCHR | 0620;
+  out->nacl_abi_st_nlink = 1;
   return 0;
 }
 
@@ -67,7 +101,11 @@ JsFile::JsFile(int fd, int oflag, OutputInterface* out)
     factory_(this), out_task_sent_(false), is_open_(false),
     is_atty_(false), is_read_ready_(false),
     write_sent_(0), write_acknowledged_(0),
-    on_read_call_count_(0) {
+    on_read_call_count_(0),
+    write_window_(out->GetWriteWindow()),
+    write_window_adaptive_(out->IsWriteWindowAdaptive()),
+    ack_rtt_us_(0), drain_rate_(0), last_ack_us_(0),
+    last_stats_us_(0), stats_changed_(false) {
 }
 
 JsFile::~JsFile() {
@@ -75,86 +113,84 @@ JsFile::~JsFile() {
 }
 
 void JsFile::OnOpen(bool success, bool is_atty) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   is_open_ = true;
   is_atty_ = is_atty;
   if (!success)
     fd_ = -1;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void JsFile::OnRead(const char* buf, size_t size) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
-  if (isatty()) {
-    for (size_t i = 0; i < size; i++) {
-      char c = buf[i];
-      // Transform characters according to input flags.
-      if (c == '\r') {
-        if (tio_.c_iflag & IGNCR)
-          continue;
-        if (tio_.c_iflag & ICRNL)
-          c = '\n';
-      } else if (c == '\n') {
-        if (tio_.c_iflag & INLCR)
-          c = '\r';
-      }
-      if (tio_.c_lflag & ICANON) {
-        if ((tio_.c_lflag & ECHOE) && c == tio_.c_cc[VERASE]) {
-          // Remove previous character in the line if any.
-          // TODO(davidben): This should be IUTF8-aware.
-          if (!in_buf_.empty() && in_buf_.back() != '\n') {
-            in_buf_.pop_back();
-            if (tio_.c_lflag & ECHO)
-              ::write(fd_, "\b \b", 3);
-          }
-          continue;
-        } else if ((tio_.c_lflag & ECHO) ||
-                   ((tio_.c_lflag & ECHONL) && c == '\n')) {
-          ::write(fd_, &c, 1);
-        }
-      } else if (tio_.c_lflag & ECHO) {
-        ::write(fd_, &c, 1);
-      }
-      in_buf_.push_back(c);
-    }
+  Mutex::Lock lock(mutex());
+  QueueInput(buf, size);
+  on_read_call_count_++;
+  wait_queue().broadcast();
+}
+
+bool JsFile::OnReadBase64(const char* data, size_t size) {
+  Mutex::Lock lock(mutex());
+  size_t max_count = Base64DecodedSize(size);
+  size_t room = 0;
+  char* buf = NULL;
+  // Terminal input has to go through the line discipline first.
+  if (!isatty())
+    buf = in_buf_.WriteSpan(max_count, &room);
+  if (room >= max_count) {
+    ssize_t count = Base64Decode(data, size, buf);
+    if (count < 0)
+      return false;
+    in_buf_.Commit(count);
   } else {
-    in_buf_.insert(in_buf_.end(), buf, buf + size);
+    decode_buf_.resize(max_count);
+    ssize_t count = Base64Decode(data, size, &decode_buf_[0]);
+    if (count < 0)
+      return false;
+    QueueInput(&decode_buf_[0], count);
   }
   on_read_call_count_++;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
+  return true;
+}
+
+void JsFile::QueueInput(const char* buf, size_t size) {
+  if (isatty()) {
+    std::string echo;
+    line_discipline_.ProcessInput(GetTermios(), buf, size, &in_buf_, &echo);
+    if (!echo.empty())
+      ::write(fd_, echo.data(), echo.size());
+  } else {
+    in_buf_.Write(buf, size);
+  }
 }
 
 void JsFile::OnWriteAcknowledge(uint64_t count) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(write_acknowledged_ <= write_sent_);
+  UpdateWriteWindow(count, !out_buf_.empty());
   write_acknowledged_ = count;
   PostWriteTask(false);
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void JsFile::OnClose() {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   is_open_ = false;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void JsFile::OnReadReady(bool is_read_ready) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   is_read_ready_ = is_read_ready;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void JsFile::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void JsFile::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -168,69 +204,77 @@ void JsFile::close() {
     pp::Module::Get()->core()->CallOnMainThread(0,
         factory_.NewCallback(&JsFile::Close));
 
-    FileSystem* sys = FileSystem::GetFileSystem();
     while (out_task_sent_)
-      sys->cond().wait(sys->mutex());
+      wait_queue().wait(mutex());
     while (is_open_)
-      sys->cond().wait(sys->mutex());
+      wait_queue().wait(mutex());
 
     fd_ = -1;
   }
 }
 
 int JsFile::read(char* buf, size_t count, size_t* nread) {
-  if (is_open() && in_buf_.empty()) {
-    pp::Module::Get()->core()->CallOnMainThread(0,
-        factory_.NewCallback(&JsFile::Read, count));
-  }
+  iovec iov = { buf, count };
+  return readv(&iov, 1, nread);
+}
 
-  FileSystem* sys = FileSystem::GetFileSystem();
-  if (is_block()) {
-    while (is_open() && in_buf_.empty())
-      sys->cond().wait(sys->mutex());
-  } else if (is_read_ready_) {
-    // We will still "block" waiting for data from JavaScript if we believe
-    // that the data is readily available and just needs to be sent over. If
-    // is_read_ready_ becomes false while we're waiting (another reader gets
-    // the data first), we'll exit the loop with whatever data is available in
-    // in_buf_. If in_buf_ is still empty, the loop below will be exited and
-    // return -1, EAGAIN.
-    while (is_open() && in_buf_.empty() && is_read_ready_)
-      sys->cond().wait(sys->mutex());
-  }
+int JsFile::write(const char* buf, size_t count, size_t* nwrote) {
+  iovec iov = { const_cast<char*>(buf), count };
+  return writev(&iov, 1, nwrote);
+}
 
-  if (isatty() && (tio_.c_lflag & ICANON)) {
-    // Need to wait for the whole line. This code doesn't introduce performance
-    // issue because ICANON is used only during local ssh prompts, ssh session
-    // use raw TTY mode.
-    // TODO(dpolukhin): find better way to detect whole line.
-    while (true) {
-      if (!is_open())
-        break;
+int JsFile::readv(const iovec* iov, int iovcnt, size_t* nread) {
+  size_t count = 0;
+  for (int i = 0; i < iovcnt; i++)
+    count += iov[i].iov_len;
 
-      if (std::find(in_buf_.begin(), in_buf_.end(), '\n') != in_buf_.end()) {
+  if (isatty() && (GetTermios().c_lflag & ICANON)) {
+    // OnRead() assembles lines and only queues them once they are complete.
+    // Ask JavaScript for all of its input until a line turns up, the reader
+    // is woken just once for it.
+    while (is_open() && in_buf_.empty()) {
+      if (!is_block() && !is_read_ready_)
         break;
-      }
-
-      while (is_open() && !is_read_ready_)
-        sys->cond().wait(sys->mutex());
 
       uint64_t old_on_read_call_count = on_read_call_count_;
       pp::Module::Get()->core()->CallOnMainThread(
-          0, factory_.NewCallback(&JsFile::Read, 1));
+          0, factory_.NewCallback(&JsFile::Read, kCanonicalReadSize));
 
       while (is_open() && on_read_call_count_ == old_on_read_call_count)
-        sys->cond().wait(sys->mutex());
+        wait_queue().wait(mutex());
+    }
+
+    // No newline is coming any more, so return what was typed before EOF.
+    if (!is_open())
+      line_discipline_.FlushLine(&in_buf_);
+  } else {
+    if (isatty())
+      line_discipline_.FlushLine(&in_buf_);
+
+    if (is_open() && in_buf_.empty()) {
+      pp::Module::Get()->core()->CallOnMainThread(0,
+          factory_.NewCallback(&JsFile::Read, count));
+    }
+
+    if (is_block()) {
+      while (is_open() && in_buf_.empty())
+        wait_queue().wait(mutex());
+    } else if (is_read_ready_) {
+      // We will still "block" waiting for data from JavaScript if we believe
+      // that the data is readily available and just needs to be sent over. If
+      // is_read_ready_ becomes false while we're waiting (another reader gets
+      // the data first), we'll exit the loop with whatever data is available
+      // in in_buf_. If in_buf_ is still empty, the loop below will be exited
+      // and return -1, EAGAIN.
+      while (is_open() && in_buf_.empty() && is_read_ready_)
+        wait_queue().wait(mutex());
     }
   }
 
   *nread = 0;
-  while (*nread < count) {
-    if (in_buf_.empty())
-      break;
-
-    buf[(*nread)++] = in_buf_.front();
-    in_buf_.pop_front();
+  for (int i = 0; i < iovcnt && !in_buf_.empty(); i++) {
+    *nread += in_buf_.Read(static_cast<char*>(iov[i].iov_base),
+                           iov[i].iov_len);
   }
 
   if (*nread == 0 && !is_block() && is_open()) {
@@ -241,23 +285,23 @@ int JsFile::read(char* buf, size_t count, size_t* nread) {
   return 0;
 }
 
-int JsFile::write(const char* buf, size_t count, size_t* nwrote) {
+int JsFile::writev(const iovec* iov, int iovcnt, size_t* nwrote) {
   if (!is_open())
     return EIO;
 
-  out_buf_.insert(out_buf_.end(), buf, buf + count);
-
-  if (isatty() && (tio_.c_oflag & OPOST) && (tio_.c_oflag & ONLCR)) {
-    // It could be performance issue to do this conversion in-place but
-    // fortunately it's used only for first few lines like password prompt.
-    for (size_t i = out_buf_.size() - count; i < out_buf_.size(); i++) {
-      if (out_buf_[i] == '\n') {
-        out_buf_.insert(out_buf_.begin() + i++, '\r');
-      }
-    }
+  const bool tty = isatty();
+  const termios tio = tty ? GetTermios() : termios();
+  *nwrote = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    const char* buf = static_cast<const char*>(iov[i].iov_base);
+    size_t count = iov[i].iov_len;
+    if (tty)
+      LineDiscipline::ProcessOutput(tio, buf, count, &out_buf_);
+    else
+      out_buf_.Write(buf, count);
+    *nwrote += count;
   }
 
-  *nwrote = count;
   PostWriteTask(true);
   return 0;
 }
@@ -268,6 +312,8 @@ int JsFile::fstat(nacl_abi_stat* out) {
   // expect 0 there.
   out->nacl_abi_st_ino = fd_;
   out->nacl_abi_st_dev = fd_;
+  out->nacl_abi_st_mode = S_IFCHR | 0620;
+  out->nacl_abi_st_nlink = 1;
   return 0;
 }
 
@@ -276,6 +322,7 @@ int JsFile::isatty() {
 }
 
 void JsFile::InitTerminal() {
+  Mutex::Lock lock(tio_mutex_);
   // Some reasonable values that produce good result.
   tio_.c_iflag = ICRNL | IXON | IXOFF | IUTF8;
   tio_.c_oflag = OPOST | ONLCR;
@@ -303,12 +350,18 @@ void JsFile::InitTerminal() {
   tio_.c_cc[VEOL2] = 0;
 }
 
+termios JsFile::GetTermios() {
+  Mutex::Lock lock(tio_mutex_);
+  return tio_;
+}
+
 int JsFile::tcgetattr(termios* termios_p) {
-  *termios_p = tio_;
+  *termios_p = GetTermios();
   return 0;
 }
 
 int JsFile::tcsetattr(int optional_actions, const termios* termios_p) {
+  Mutex::Lock lock(tio_mutex_);
   tio_ = *termios_p;
   return 0;
 }
@@ -343,12 +396,68 @@ bool JsFile::is_read_ready() {
 
 bool JsFile::is_write_ready() {
   size_t not_acknowledged = write_sent_ - write_acknowledged_;
-  return (not_acknowledged + out_buf_.size()) < out_->GetWriteWindow();
+  return (not_acknowledged + out_buf_.size()) < write_window_;
+}
+
+JsFile::WriteStats JsFile::GetWriteStats() {
+  WriteStats stats = { write_window_, ack_rtt_us_, drain_rate_ };
+  return stats;
+}
+
+void JsFile::UpdateWriteWindow(uint64_t count, bool window_limited) {
+  int64_t now = GetTimeUs();
+  int64_t sent_us = -1;
+  while (!write_times_.empty() && write_times_.front().first <= count) {
+    sent_us = write_times_.front().second;
+    write_times_.pop_front();
+  }
+  if (sent_us < 0)
+    return;
+
+  // Smooth the samples like TCP does for its RTT estimate.
+  int64_t rtt = now - sent_us;
+  ack_rtt_us_ = ack_rtt_us_ ? (7 * ack_rtt_us_ + rtt) / 8 : rtt;
+  // Only time spent waiting on JavaScript says how fast it drains data.
+  if (window_limited && last_ack_us_ && now > last_ack_us_) {
+    uint64_t rate =
+        (count - write_acknowledged_) * 1000000 / (now - last_ack_us_);
+    drain_rate_ = drain_rate_ ? (7 * drain_rate_ + rate) / 8 : rate;
+  }
+  last_ack_us_ = now;
+
+  if (!write_window_adaptive_)
+    return;
+
+  size_t window = write_window_;
+  if (ack_rtt_us_ > 2 * kTargetAckLatencyUs) {
+    // Output is piling up in JavaScript, e.g. a slow renderer.  Back off
+    // towards what it drains in the target latency.
+    size_t target = drain_rate_ * kTargetAckLatencyUs / 1000000;
+    window = std::max(std::max(window / 2, target), kMinWriteWindow);
+  } else if (ack_rtt_us_ < kTargetAckLatencyUs && window_limited) {
+    // The window is what holds us back and JavaScript keeps up.
+    window = std::min(window * 2, kMaxWriteWindow);
+  }
+  if (window != write_window_) {
+    write_window_ = window;
+    stats_changed_ = true;
+  }
+
+  // The window can change on every acknowledgement, don't flood JavaScript.
+  if (stats_changed_ && now - last_stats_us_ >= kWriteStatsIntervalUs) {
+    WriteStats stats = GetWriteStats();
+    LOG("JsFile::UpdateWriteWindow: %d window %d, rtt %dus, %d B/s\n",
+        fd_, (int)stats.window, (int)stats.ack_rtt_us, (int)stats.drain_rate);
+    out_->SendWriteStats(fd_, stats.window, stats.ack_rtt_us,
+                         stats.drain_rate);
+    last_stats_us_ = now;
+    stats_changed_ = false;
+  }
 }
 
 void JsFile::PostWriteTask(bool always_post) {
   if (!out_task_sent_ && !out_buf_.empty() &&
-      (write_sent_ - write_acknowledged_) < out_->GetWriteWindow()) {
+      (write_sent_ - write_acknowledged_) < write_window_) {
     if (always_post || !pp::Module::Get()->core()->IsMainThread()) {
       pp::Module::Get()->core()->CallOnMainThread(
           0, factory_.NewCallback(&JsFile::Write));
@@ -365,32 +474,36 @@ void JsFile::Read(int32_t result, size_t size) {
 }
 
 void JsFile::Write(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   out_task_sent_ = false;
 
-  size_t count = std::min(
-      size_t(write_acknowledged_ + out_->GetWriteWindow() - write_sent_),
-      out_buf_.size());
+  // The window may have shrunk below what is already in flight.
+  size_t in_flight = write_sent_ - write_acknowledged_;
+  size_t count = in_flight < write_window_ ?
+      std::min(write_window_ - in_flight, out_buf_.size()) : 0;
   if (count == 0) {
     LOG("JsFile::Write: %d is not ready for write, cached %d\n",
         fd_, out_buf_.size());
     return;
   }
 
-  // Use temporary buffer in vector because std::deque doesn't use continuous
-  // memory inside. Alternative solution is to use vector as out_buf_ but erase
-  // below will require copy for the whole remaining bytes (will be slow with
-  // small writeWindow).
-  std::vector<char> buf(out_buf_.begin(), out_buf_.begin() + count);
-  if (out_->Write(fd_, &buf[0], count)) {
-    write_sent_ += count;
-    out_buf_.erase(out_buf_.begin(), out_buf_.begin() + count);
-    sys->cond().broadcast();
-  } else {
-    assert(0);
-    PostWriteTask(true);
+  // Copy the queued data straight into buffers lent out by the plugin, which
+  // are handed over to JavaScript as they are.
+  while (count) {
+    size_t size = count;
+    char* data = out_->BeginWrite(fd_, &size);
+    out_buf_.Peek(data, size);
+    if (!out_->EndWrite(fd_)) {
+      assert(0);
+      PostWriteTask(true);
+      break;
+    }
+    write_sent_ += size;
+    out_buf_.Consume(size);
+    count -= size;
   }
+  write_times_.push_back(std::make_pair(write_sent_, GetTimeUs()));
+  wait_queue().broadcast();
 }
 
 void JsFile::Close(int32_t result) {
@@ -409,9 +522,8 @@ JsSocket::~JsSocket() {
 bool JsSocket::connect(const char* host, uint16_t port) {
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&JsSocket::Connect, host, port));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (!is_open())
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
 
   if (fd() == -1)
     return false;
@@ -428,7 +540,6 @@ bool JsSocket::is_read_ready() {
 }
 
 void JsSocket::Connect(int32_t result, const char* host, uint16_t port) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   out_->OpenSocket(fd_, host, port, this);
 }
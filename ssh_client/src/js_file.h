@@ -5,12 +5,16 @@
 #ifndef JS_FILE_H
 #define JS_FILE_H
 
-#include <queue>
+#include <deque>
+#include <utility>
+#include <vector>
 
 #include "ppapi/cpp/completion_callback.h"
 
 #include "file_system.h"
+#include "line_discipline.h"
 #include "pthread_helpers.h"
+#include "ring_buffer.h"
 
 class JsFile : public FileStream,
                public InputInterface {
@@ -27,6 +31,7 @@ class JsFile : public FileStream,
 
   virtual void OnOpen(bool success, bool is_atty);
   virtual void OnRead(const char* buf, size_t size);
+  virtual bool OnReadBase64(const char* data, size_t size);
   virtual void OnWriteAcknowledge(uint64_t count);
   virtual void OnClose();
   virtual void OnReadReady(bool is_read_ready);
@@ -38,6 +43,8 @@ class JsFile : public FileStream,
   virtual void close();
   virtual int read(char* buf, size_t count, size_t* nread);
   virtual int write(const char* buf, size_t count, size_t* nwrote);
+  virtual int readv(const iovec* iov, int iovcnt, size_t* nread);
+  virtual int writev(const iovec* iov, int iovcnt, size_t* nwrote);
   virtual int fstat(nacl_abi_stat* out);
 
   virtual int isatty();
@@ -49,8 +56,21 @@ class JsFile : public FileStream,
   virtual bool is_read_ready();
   virtual bool is_write_ready();
 
+  struct WriteStats {
+    // Bytes that may be sent to JavaScript without an acknowledgement.
+    size_t window;
+    // Smoothed time until JavaScript acknowledges data, 0 until it first does.
+    int64_t ack_rtt_us;
+    // Smoothed rate JavaScript consumes data at while writes are queued, in
+    // bytes per second.
+    uint64_t drain_rate;
+  };
+  WriteStats GetWriteStats();
+
  protected:
+  void QueueInput(const char* buf, size_t size);
   void PostWriteTask(bool always_post);
+  void UpdateWriteWindow(uint64_t count, bool window_limited);
 
   void Read(int32_t result, size_t size);
   void Write(int32_t result);
@@ -61,8 +81,13 @@ class JsFile : public FileStream,
   int oflag_;
   OutputInterface* out_;
   pp::CompletionCallbackFactory<JsFile> factory_;
-  std::deque<char> in_buf_;
-  std::deque<char> out_buf_;
+  // In canonical mode this only holds complete lines, the line being typed is
+  // kept by |line_discipline_|.
+  RingBuffer in_buf_;
+  RingBuffer out_buf_;
+  // Decoded base64 input on its way to |line_discipline_|.
+  std::vector<char> decode_buf_;
+  LineDiscipline line_discipline_;
   bool out_task_sent_;
   bool is_open_;
   bool is_atty_;
@@ -70,7 +95,23 @@ class JsFile : public FileStream,
   uint64_t write_sent_;
   uint64_t write_acknowledged_;
   uint64_t on_read_call_count_;
+  size_t write_window_;
+  bool write_window_adaptive_;
+  // Where the data of each Write() ends in the output and when it was sent.
+  std::deque<std::pair<uint64_t, int64_t> > write_times_;
+  int64_t ack_rtt_us_;
+  uint64_t drain_rate_;
+  int64_t last_ack_us_;
+  // When the stats were last sent to JavaScript, and whether the window
+  // changed since.
+  int64_t last_stats_us_;
+  bool stats_changed_;
+
+  // The terminal settings are shared by all tty streams, so they have their
+  // own lock rather than being guarded by any one stream's mutex.
+  static termios GetTermios();
   static termios tio_;
+  static Mutex tio_mutex_;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(JsFile);
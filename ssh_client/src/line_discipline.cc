@@ -0,0 +1,171 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "line_discipline.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+// Finds the next occurrence of any of a few bytes in a buffer.  The position
+// of each byte is remembered until it has been passed, so every byte of the
+// buffer is looked at by memchr() at most once per byte searched for.
+class ByteScanner {
+ public:
+  ByteScanner(const char* buf, size_t size)
+      : buf_(buf), size_(size), count_(0) {
+  }
+
+  void Add(char c) {
+    for (int i = 0; i < count_; i++) {
+      if (chars_[i] == c)
+        return;
+    }
+    chars_[count_] = c;
+    next_[count_] = Find(c, 0);
+    count_++;
+  }
+
+  // Return the position of the first byte searched for at or after |pos|, or
+  // the size of the buffer.
+  size_t Next(size_t pos) {
+    size_t next = size_;
+    for (int i = 0; i < count_; i++) {
+      if (next_[i] < pos)
+        next_[i] = Find(chars_[i], pos);
+      next = std::min(next, next_[i]);
+    }
+    return next;
+  }
+
+ private:
+  size_t Find(char c, size_t pos) {
+    const void* p = memchr(buf_ + pos, c, size_ - pos);
+    return p ? static_cast<const char*>(p) - buf_ : size_;
+  }
+
+  static const int kMaxChars = 3;
+
+  const char* buf_;
+  size_t size_;
+  int count_;
+  char chars_[kMaxChars];
+  size_t next_[kMaxChars];
+};
+
+}  // namespace
+
+LineDiscipline::LineDiscipline() {
+}
+
+bool LineDiscipline::IsRawInput(const termios& tio) {
+  return !(tio.c_iflag & (IGNCR | ICRNL | INLCR)) &&
+         !(tio.c_lflag & (ICANON | ECHO | ECHONL));
+}
+
+void LineDiscipline::ProcessInput(const termios& tio,
+                                  const char* buf, size_t size,
+                                  RingBuffer* in, std::string* echo) {
+  const bool canon = tio.c_lflag & ICANON;
+  if (!canon)
+    FlushLine(in);
+
+  if (IsRawInput(tio)) {
+    in->Write(buf, size);
+    return;
+  }
+
+  const bool erase = canon && (tio.c_lflag & ECHOE);
+  const bool echo_all = tio.c_lflag & ECHO;
+  const bool echo_nl = echo_all || (canon && (tio.c_lflag & ECHONL));
+
+  ByteScanner scanner(buf, size);
+  scanner.Add('\r');
+  scanner.Add('\n');
+  if (erase)
+    scanner.Add(tio.c_cc[VERASE]);
+
+  size_t pos = 0;
+  while (pos < size) {
+    // Everything up to the next special byte passes through unchanged.
+    size_t next = scanner.Next(pos);
+    if (next > pos) {
+      if (canon)
+        line_.append(buf + pos, next - pos);
+      else
+        in->Write(buf + pos, next - pos);
+      if (echo_all)
+        echo->append(buf + pos, next - pos);
+      pos = next;
+      if (pos == size)
+        break;
+    }
+
+    char c = buf[pos++];
+    // Transform characters according to input flags.
+    if (c == '\r') {
+      if (tio.c_iflag & IGNCR)
+        continue;
+      if (tio.c_iflag & ICRNL)
+        c = '\n';
+    } else if (c == '\n') {
+      if (tio.c_iflag & INLCR)
+        c = '\r';
+    }
+
+    if (erase && c == static_cast<char>(tio.c_cc[VERASE])) {
+      // Remove previous character in the line if any.
+      // TODO(davidben): This should be IUTF8-aware.
+      if (!line_.empty()) {
+        line_.resize(line_.size() - 1);
+        if (echo_all)
+          echo->append("\b \b", 3);
+      }
+      continue;
+    }
+
+    if (echo_all || (echo_nl && c == '\n'))
+      echo->push_back(c);
+    if (canon) {
+      line_.push_back(c);
+      if (c == '\n')
+        FlushLine(in);
+    } else {
+      in->Write(&c, 1);
+    }
+  }
+}
+
+void LineDiscipline::FlushLine(RingBuffer* in) {
+  if (!line_.empty()) {
+    in->Write(line_.data(), line_.size());
+    line_.clear();
+  }
+}
+
+void LineDiscipline::ProcessOutput(const termios& tio,
+                                   const char* buf, size_t size,
+                                   RingBuffer* out) {
+  if (!(tio.c_oflag & OPOST) || !(tio.c_oflag & ONLCR)) {
+    out->Write(buf, size);
+    return;
+  }
+
+  // Output is mostly text with some newlines, so this is usually all the
+  // room needed.
+  out->Reserve(size);
+  while (size) {
+    const char* nl = static_cast<const char*>(memchr(buf, '\n', size));
+    if (!nl) {
+      out->Write(buf, size);
+      break;
+    }
+    out->Write(buf, nl - buf);
+    out->Write("\r\n", 2);
+    size -= nl + 1 - buf;
+    buf = nl + 1;
+  }
+}
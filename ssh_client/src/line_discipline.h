@@ -0,0 +1,52 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LINE_DISCIPLINE_H
+#define LINE_DISCIPLINE_H
+
+#include <stddef.h>
+#include <termios.h>
+
+#include <string>
+
+#include "pthread_helpers.h"
+#include "ring_buffer.h"
+
+// Terminal input and output processing as selected by the termios flags:
+// CR/NL translation, echo, erase and, in canonical mode, line assembly.
+//
+// Data is scanned for the few bytes that need special handling with
+// memchr(), runs in between are copied and echoed in bulk.  When no flag
+// asks for any processing the data is appended as is.
+class LineDiscipline {
+ public:
+  LineDiscipline();
+
+  // Process |size| bytes of terminal input according to |tio|.  Bytes for
+  // readers are appended to |in| and anything to echo back to |echo|.  In
+  // canonical mode input is held back until a line is complete, so |in| only
+  // ever receives whole lines.
+  void ProcessInput(const termios& tio, const char* buf, size_t size,
+                    RingBuffer* in, std::string* echo);
+
+  // Pass a partially assembled line on to |in|, e.g. once canonical mode was
+  // turned off.
+  void FlushLine(RingBuffer* in);
+
+  // Append |size| bytes of terminal output to |out|, processed according to
+  // |tio|.
+  static void ProcessOutput(const termios& tio, const char* buf, size_t size,
+                            RingBuffer* out);
+
+ private:
+  // Whether |tio| leaves input untouched.
+  static bool IsRawInput(const termios& tio);
+
+  // The line being edited in canonical mode.
+  std::string line_;
+
+  DISALLOW_COPY_AND_ASSIGN(LineDiscipline);
+};
+
+#endif  // LINE_DISCIPLINE_H
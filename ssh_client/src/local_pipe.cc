@@ -0,0 +1,154 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "local_pipe.h"
+
+#include <assert.h>
+#include <sys/stat.h>
+
+const size_t LocalPipe::kBufSize;
+
+LocalPipe::Shared::Shared() : ref(0), duplex(false) {
+  for (int i = 0; i < 2; i++) {
+    queue[i].set_max_size(kBufSize);
+    open[i] = 0;
+  }
+}
+
+void LocalPipe::CreatePair(bool duplex, LocalPipe** end0, LocalPipe** end1) {
+  Shared* shared = new Shared();
+  shared->duplex = duplex;
+  *end0 = new LocalPipe(shared, 0, duplex ? O_RDWR : O_RDONLY);
+  *end1 = new LocalPipe(shared, 1, duplex ? O_RDWR : O_WRONLY);
+}
+
+LocalPipe::LocalPipe(Shared* shared, int side, int oflag)
+    : ref_(1), shared_(shared), side_(side), oflag_(oflag), closed_(false) {
+  __sync_add_and_fetch(&shared_->ref, 1);
+  Mutex::Lock lock(shared_->mutex);
+  shared_->open[side_]++;
+}
+
+LocalPipe::~LocalPipe() {
+  assert(!ref_);
+  {
+    Mutex::Lock lock(shared_->mutex);
+    if (!closed_)
+      close();
+  }
+  if (!__sync_sub_and_fetch(&shared_->ref, 1))
+    delete shared_;
+}
+
+void LocalPipe::addref() {
+  __sync_add_and_fetch(&ref_, 1);
+}
+
+void LocalPipe::release() {
+  if (!__sync_sub_and_fetch(&ref_, 1))
+    delete this;
+}
+
+FileStream* LocalPipe::dup(int fd) {
+  return new LocalPipe(shared_, side_, oflag_);
+}
+
+void LocalPipe::close() {
+  // shutdown() closes too, before the descriptor is closed.
+  if (closed_)
+    return;
+  closed_ = true;
+  // Nobody can read what is still queued for this end.
+  if (!--shared_->open[side_])
+    in_queue().Clear();
+  // Wake up the peer, and any thread still blocked on this end.
+  wait_queue().broadcast();
+}
+
+int LocalPipe::read(char* buf, size_t count, size_t* nread) {
+  if (closed_ || !is_readable())
+    return EBADF;
+
+  while (in_queue().empty()) {
+    if (is_peer_closed()) {
+      *nread = 0;
+      return 0;
+    }
+    if (oflag_ & O_NONBLOCK)
+      return EAGAIN;
+    wait_queue().wait(mutex());
+    if (closed_)
+      return EBADF;
+  }
+
+  *nread = in_queue().Read(buf, count);
+  // There is room for the writer now.
+  wait_queue().broadcast();
+  return 0;
+}
+
+int LocalPipe::write(const char* buf, size_t count, size_t* nwrote) {
+  if (closed_ || !is_writable())
+    return EBADF;
+
+  *nwrote = 0;
+  while (count) {
+    // SIGPIPE isn't raised, so EPIPE is all the writer gets.
+    if (is_peer_closed())
+      return *nwrote ? 0 : EPIPE;
+
+    size_t n = out_queue().Write(buf, count);
+    if (n) {
+      buf += n;
+      count -= n;
+      *nwrote += n;
+      wait_queue().broadcast();
+      continue;
+    }
+
+    if (oflag_ & O_NONBLOCK)
+      return *nwrote ? 0 : EAGAIN;
+    wait_queue().wait(mutex());
+    if (closed_)
+      return *nwrote ? 0 : EBADF;
+  }
+  return 0;
+}
+
+int LocalPipe::fstat(nacl_abi_stat* out) {
+  memset(out, 0, sizeof(nacl_abi_stat));
+  // openssl uses st_ino and st_dev to distinguish streams and doesn't expect 0
+  // there.
+  out->nacl_abi_st_ino = reinterpret_cast<uintptr_t>(shared_);
+  out->nacl_abi_st_dev = 1;
+  out->nacl_abi_st_mode = (shared_->duplex ? S_IFSOCK : S_IFIFO) | 0600;
+  out->nacl_abi_st_nlink = 1;
+  out->nacl_abi_st_size = in_queue().size();
+  out->nacl_abi_st_blksize = kBufSize;
+  return 0;
+}
+
+int LocalPipe::fcntl(int cmd, va_list ap) {
+  if (cmd == F_GETFL) {
+    return oflag_;
+  } else if (cmd == F_SETFL) {
+    // The access mode can't be changed.
+    oflag_ = (oflag_ & O_ACCMODE) | (va_arg(ap, long) & ~O_ACCMODE);
+    return 0;
+  } else {
+    return -1;
+  }
+}
+
+bool LocalPipe::is_read_ready() {
+  return is_readable() && (!in_queue().empty() || is_peer_closed());
+}
+
+bool LocalPipe::is_write_ready() {
+  return is_writable() && (out_queue().space() || is_peer_closed());
+}
+
+bool LocalPipe::is_exception() {
+  return is_peer_closed();
+}
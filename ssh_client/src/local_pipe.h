@@ -0,0 +1,79 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOCAL_PIPE_H
+#define LOCAL_PIPE_H
+
+#include "file_interfaces.h"
+#include "pthread_helpers.h"
+#include "ring_buffer.h"
+
+// One end of a pipe() or socketpair() within the process.
+//
+// Data written to one end is queued in a ring buffer until the other end
+// reads it, so it never leaves the calling threads.  Both ends share one mutex
+// and wait queue: every stream call runs under the stream's mutex, and
+// sharing it lets a write wake up readers of the other end, and select() on
+// it, without taking a second stream lock.
+class LocalPipe : public FileStream {
+ public:
+  // Create two connected ends.  Unless |duplex| is set, as for pipe(),
+  // |*end0| can only be read from and |*end1| only written to.
+  static void CreatePair(bool duplex, LocalPipe** end0, LocalPipe** end1);
+
+  virtual ~LocalPipe();
+
+  virtual void addref();
+  virtual void release();
+  virtual FileStream* dup(int fd);
+
+  virtual void close();
+  virtual int read(char* buf, size_t count, size_t* nread);
+  virtual int write(const char* buf, size_t count, size_t* nwrote);
+  virtual int fstat(nacl_abi_stat* out);
+
+  virtual int fcntl(int cmd,  va_list ap);
+
+  virtual bool is_read_ready();
+  virtual bool is_write_ready();
+  virtual bool is_exception();
+
+  virtual WaitQueue& wait_queue() { return shared_->wait_queue; }
+  virtual Mutex& mutex() { return shared_->mutex; }
+
+ private:
+  // How much may be queued in each direction, like a Linux pipe.
+  static const size_t kBufSize = 64 * 1024;
+
+  struct Shared {
+    Shared();
+
+    int ref;
+    Mutex mutex;
+    WaitQueue wait_queue;
+    // Data on its way to end 0 and end 1.
+    RingBuffer queue[2];
+    // Open descriptors of each end.
+    int open[2];
+    bool duplex;
+  };
+
+  LocalPipe(Shared* shared, int side, int oflag);
+
+  RingBuffer& in_queue() { return shared_->queue[side_]; }
+  RingBuffer& out_queue() { return shared_->queue[1 - side_]; }
+  bool is_peer_closed() { return !shared_->open[1 - side_]; }
+  bool is_readable() { return (oflag_ & O_ACCMODE) != O_WRONLY; }
+  bool is_writable() { return (oflag_ & O_ACCMODE) != O_RDONLY; }
+
+  int ref_;
+  Shared* shared_;
+  int side_;
+  int oflag_;
+  bool closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalPipe);
+};
+
+#endif  // LOCAL_PIPE_H
@@ -0,0 +1,36 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LOCKED_STREAM_H
+#define LOCKED_STREAM_H
+
+#include "file_interfaces.h"
+#include "pthread_helpers.h"
+
+// Holds a stream's mutex and a reference to the stream for the duration of a
+// syscall, so that a concurrent close() can't destroy it under us.
+class LockedStream {
+ public:
+  explicit LockedStream(FileStream* stream) : stream_(stream) {
+    if (stream_)
+      pthread_mutex_lock(stream_->mutex().get());
+  }
+
+  ~LockedStream() {
+    if (stream_) {
+      pthread_mutex_unlock(stream_->mutex().get());
+      stream_->release();
+    }
+  }
+
+  FileStream* get() const { return stream_; }
+  FileStream* operator->() const { return stream_; }
+
+ private:
+  FileStream* stream_;
+
+  DISALLOW_COPY_AND_ASSIGN(LockedStream);
+};
+
+#endif  // LOCKED_STREAM_H
@@ -0,0 +1,403 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "memory_file.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+namespace {
+
+// Made up device number for st_dev, so st_dev/st_ino pairs are unique.
+const nacl_abi_dev_t kMemoryDevice = 0x746d70;
+
+}  // namespace
+
+const size_t MemoryFileHandler::kBlockSize;
+const size_t MemoryFileHandler::kMaxInodes;
+
+MemoryFileHandler::MemoryFileHandler(const std::string& root, size_t max_bytes)
+    : ref_(1), max_bytes_(max_bytes), used_bytes_(0), next_ino_(1) {
+  Inode* inode;
+  int err = Create(Normalize(root.c_str()), true, &inode);
+  assert(!err);
+  (void)err;
+}
+
+MemoryFileHandler::~MemoryFileHandler() {
+  assert(!ref_);
+  for (InodeMap::iterator it = inodes_.begin(); it != inodes_.end(); ++it) {
+    Inode* inode = it->second;
+    for (size_t i = 0; i < inode->blocks.size(); i++)
+      free(inode->blocks[i]);
+    delete inode;
+  }
+}
+
+void MemoryFileHandler::addref() {
+  __sync_add_and_fetch(&ref_, 1);
+}
+
+void MemoryFileHandler::release() {
+  if (!__sync_sub_and_fetch(&ref_, 1))
+    delete this;
+}
+
+FileStream* MemoryFileHandler::open(int fd, const char* pathname, int oflag,
+                                    int* err) {
+  Mutex::Lock lock(mutex_);
+  std::string path = Normalize(pathname);
+  InodeMap::iterator it = inodes_.find(path);
+  Inode* inode;
+  if (it == inodes_.end()) {
+    if (!(oflag & O_CREAT)) {
+      *err = ENOENT;
+      return NULL;
+    }
+    *err = Create(path, false, &inode);
+    if (*err)
+      return NULL;
+  } else {
+    if ((oflag & O_CREAT) && (oflag & O_EXCL)) {
+      *err = EEXIST;
+      return NULL;
+    }
+    inode = it->second;
+  }
+
+  // Directories can't be listed, so there is nothing to open them for.
+  if (inode->is_dir) {
+    *err = EISDIR;
+    return NULL;
+  }
+
+  if ((oflag & O_TRUNC) && (oflag & O_ACCMODE) != O_RDONLY)
+    TruncateLocked(inode, 0);
+
+  return new MemoryFile(fd, oflag, this, inode);
+}
+
+int MemoryFileHandler::stat(const char* pathname, nacl_abi_stat* out) {
+  Mutex::Lock lock(mutex_);
+  InodeMap::iterator it = inodes_.find(Normalize(pathname));
+  if (it == inodes_.end())
+    return ENOENT;
+  StatLocked(it->second, out);
+  return 0;
+}
+
+int MemoryFileHandler::mkdir(const char* pathname, mode_t mode) {
+  Mutex::Lock lock(mutex_);
+  std::string path = Normalize(pathname);
+  if (inodes_.count(path))
+    return EEXIST;
+  Inode* inode;
+  return Create(path, true, &inode);
+}
+
+int MemoryFileHandler::ReadAt(Inode* inode, int64_t offset, char* buf,
+                              size_t count, size_t* nread) {
+  Mutex::Lock lock(mutex_);
+  *nread = 0;
+  if (offset >= inode->size)
+    return 0;
+  count = std::min<int64_t>(count, inode->size - offset);
+
+  while (count) {
+    size_t index = offset / kBlockSize;
+    size_t skip = offset % kBlockSize;
+    size_t n = std::min(count, kBlockSize - skip);
+    if (index < inode->blocks.size() && inode->blocks[index])
+      memcpy(buf, inode->blocks[index] + skip, n);
+    else
+      memset(buf, 0, n);
+    buf += n;
+    offset += n;
+    count -= n;
+    *nread += n;
+  }
+  return 0;
+}
+
+int MemoryFileHandler::WriteAt(Inode* inode, int64_t* offset, bool append,
+                               const char* buf, size_t count, size_t* nwrote) {
+  Mutex::Lock lock(mutex_);
+  if (append)
+    *offset = inode->size;
+  *nwrote = 0;
+  int64_t pos = *offset;
+  // No file can hold more than all the blocks together.  Checking here also
+  // keeps |index| below small enough to size the block list with.
+  int64_t max_size = max_bytes_;
+  if (count && pos >= max_size)
+    return EFBIG;
+  count = std::min<int64_t>(count, max_size - pos);
+
+  while (count) {
+    size_t index = static_cast<size_t>(pos / kBlockSize);
+    size_t skip = pos % kBlockSize;
+    size_t n = std::min(count, kBlockSize - skip);
+    if (index >= inode->blocks.size())
+      inode->blocks.resize(index + 1);
+    char*& block = inode->blocks[index];
+    if (!block) {
+      if (used_bytes_ + kBlockSize > max_bytes_)
+        break;
+      block = static_cast<char*>(calloc(1, kBlockSize));
+      if (!block)
+        break;
+      used_bytes_ += kBlockSize;
+    }
+    memcpy(block + skip, buf, n);
+    buf += n;
+    pos += n;
+    count -= n;
+    *nwrote += n;
+  }
+
+  if (*nwrote) {
+    inode->size = std::max(inode->size, pos);
+    inode->mtime = time(NULL);
+  }
+  return (count && !*nwrote) ? ENOSPC : 0;
+}
+
+int MemoryFileHandler::Truncate(Inode* inode, int64_t length) {
+  Mutex::Lock lock(mutex_);
+  return TruncateLocked(inode, length);
+}
+
+int64_t MemoryFileHandler::GetSize(Inode* inode) {
+  Mutex::Lock lock(mutex_);
+  return inode->size;
+}
+
+void MemoryFileHandler::Stat(Inode* inode, nacl_abi_stat* out) {
+  Mutex::Lock lock(mutex_);
+  StatLocked(inode, out);
+}
+
+std::string MemoryFileHandler::Normalize(const char* pathname) {
+  std::string path;
+  const char* p = pathname;
+  for (;;) {
+    while (*p == '/')
+      p++;
+    size_t len = strcspn(p, "/");
+    if (!len)
+      break;
+    if (len != 1 || *p != '.') {
+      path += '/';
+      path.append(p, len);
+    }
+    p += len;
+  }
+  return path.empty() ? "/" : path;
+}
+
+int MemoryFileHandler::Create(const std::string& path, bool is_dir,
+                              Inode** inode) {
+  // Only the root has no parent here, as it is created first.
+  if (!inodes_.empty()) {
+    std::string::size_type slash = path.find_last_of('/');
+    InodeMap::iterator parent =
+        inodes_.find(slash ? path.substr(0, slash) : "/");
+    if (parent == inodes_.end())
+      return ENOENT;
+    if (!parent->second->is_dir)
+      return ENOTDIR;
+  }
+  if (inodes_.size() >= kMaxInodes)
+    return ENOSPC;
+
+  *inode = new Inode();
+  (*inode)->is_dir = is_dir;
+  (*inode)->ino = next_ino_++;
+  (*inode)->size = 0;
+  (*inode)->mtime = time(NULL);
+  inodes_[path] = *inode;
+  return 0;
+}
+
+void MemoryFileHandler::StatLocked(Inode* inode, nacl_abi_stat* out) {
+  size_t blocks = 0;
+  for (size_t i = 0; i < inode->blocks.size(); i++) {
+    if (inode->blocks[i])
+      blocks++;
+  }
+
+  memset(out, 0, sizeof(nacl_abi_stat));
+  out->nacl_abi_st_dev = kMemoryDevice;
+  out->nacl_abi_st_ino = inode->ino;
+  out->nacl_abi_st_mode = inode->is_dir ? S_IFDIR | 0700 : S_IFREG | 0600;
+  out->nacl_abi_st_nlink = inode->is_dir ? 2 : 1;
+  out->nacl_abi_st_size = inode->size;
+  out->nacl_abi_st_blksize = kBlockSize;
+  out->nacl_abi_st_blocks = blocks * (kBlockSize / 512);
+  out->nacl_abi_st_atime = inode->mtime;
+  out->nacl_abi_st_mtime = inode->mtime;
+  out->nacl_abi_st_ctime = inode->mtime;
+}
+
+int MemoryFileHandler::TruncateLocked(Inode* inode, int64_t length) {
+  if (length < 0)
+    return EINVAL;
+  if (length > (int64_t)max_bytes_)
+    return EFBIG;
+
+  if (length < inode->size) {
+    size_t keep = (length + kBlockSize - 1) / kBlockSize;
+    for (size_t i = keep; i < inode->blocks.size(); i++) {
+      if (inode->blocks[i]) {
+        free(inode->blocks[i]);
+        used_bytes_ -= kBlockSize;
+      }
+    }
+    if (keep < inode->blocks.size())
+      inode->blocks.resize(keep);
+
+    // Keep the tail of the last block zeroed.
+    size_t tail = length % kBlockSize;
+    if (tail && keep <= inode->blocks.size() && inode->blocks[keep - 1])
+      memset(inode->blocks[keep - 1] + tail, 0, kBlockSize - tail);
+  }
+
+  inode->size = length;
+  inode->mtime = time(NULL);
+  return 0;
+}
+
+//------------------------------------------------------------------------------
+
+MemoryFile::MemoryFile(int fd, int oflag, MemoryFileHandler* handler,
+                       MemoryFileHandler::Inode* inode)
+  : ref_(1), fd_(fd), oflag_(oflag), handler_(handler), inode_(inode),
+    offset_(0) {
+  handler_->addref();
+}
+
+MemoryFile::~MemoryFile() {
+  assert(!ref_);
+  handler_->release();
+}
+
+void MemoryFile::addref() {
+  __sync_add_and_fetch(&ref_, 1);
+}
+
+void MemoryFile::release() {
+  if (!__sync_sub_and_fetch(&ref_, 1))
+    delete this;
+}
+
+FileStream* MemoryFile::dup(int fd) {
+  MemoryFile* file = new MemoryFile(fd, oflag_, handler_, inode_);
+  file->offset_ = offset_;
+  return file;
+}
+
+void MemoryFile::close() {
+  fd_ = -1;
+}
+
+int MemoryFile::read(char* buf, size_t count, size_t* nread) {
+  int err = pread(buf, count, offset_, nread);
+  if (!err)
+    offset_ += *nread;
+  return err;
+}
+
+int MemoryFile::write(const char* buf, size_t count, size_t* nwrote) {
+  if (!is_writable())
+    return EBADF;
+  int err = handler_->WriteAt(inode_, &offset_, oflag_ & O_APPEND, buf, count,
+                              nwrote);
+  if (!err)
+    offset_ += *nwrote;
+  return err;
+}
+
+int MemoryFile::pread(char* buf, size_t count, nacl_abi_off_t offset,
+                      size_t* nread) {
+  if (!is_readable())
+    return EBADF;
+  if (offset < 0)
+    return EINVAL;
+  return handler_->ReadAt(inode_, offset, buf, count, nread);
+}
+
+int MemoryFile::pwrite(const char* buf, size_t count, nacl_abi_off_t offset,
+                       size_t* nwrote) {
+  if (!is_writable())
+    return EBADF;
+  if (offset < 0)
+    return EINVAL;
+  int64_t pos = offset;
+  return handler_->WriteAt(inode_, &pos, false, buf, count, nwrote);
+}
+
+int MemoryFile::fsync() {
+  return 0;
+}
+
+int MemoryFile::ftruncate(nacl_abi_off_t length) {
+  if (!is_writable())
+    return EINVAL;
+  return handler_->Truncate(inode_, length);
+}
+
+int MemoryFile::seek(nacl_abi_off_t offset, int whence,
+                     nacl_abi_off_t* new_offset) {
+  int64_t base;
+  switch (whence) {
+    case SEEK_SET:
+      base = 0;
+      break;
+
+    case SEEK_CUR:
+      base = offset_;
+      break;
+
+    case SEEK_END:
+      base = handler_->GetSize(inode_);
+      break;
+
+    default:
+      if (new_offset)
+        *new_offset = -1;
+      return EINVAL;
+  }
+
+  if (base + offset < 0) {
+    if (new_offset)
+      *new_offset = -1;
+    return EINVAL;
+  }
+
+  offset_ = base + offset;
+  if (new_offset)
+    *new_offset = offset_;
+  return 0;
+}
+
+int MemoryFile::fstat(nacl_abi_stat* out) {
+  handler_->Stat(inode_, out);
+  return 0;
+}
+
+int MemoryFile::fcntl(int cmd, va_list ap) {
+  if (cmd == F_GETFL) {
+    return oflag_;
+  } else if (cmd == F_SETFL) {
+    // The access mode can't be changed.
+    oflag_ = (oflag_ & O_ACCMODE) | (va_arg(ap, long) & ~O_ACCMODE);
+    return 0;
+  } else {
+    return -1;
+  }
+}
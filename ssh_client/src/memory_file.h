@@ -0,0 +1,121 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MEMORY_FILE_H
+#define MEMORY_FILE_H
+
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "file_interfaces.h"
+#include "pthread_helpers.h"
+
+// Serves a subtree, e.g. /tmp, from memory.  Files there don't outlive the
+// session, but reading and writing them never leaves the calling thread.
+//
+// File contents are kept in blocks allocated as they are first written to, so
+// holes take no memory.  All blocks together are limited to |max_bytes|, and
+// so is the size of any one file.
+// Files can't be removed, so the number of files and directories is limited
+// too.
+class MemoryFileHandler : public PathHandler {
+ public:
+  static const size_t kBlockSize = 4096;
+
+  struct Inode {
+    bool is_dir;
+    nacl_abi_ino_t ino;
+    int64_t size;
+    time_t mtime;
+    // Bytes past |size| in the last block are kept zeroed, so a file can grow
+    // without clearing them first.
+    std::vector<char*> blocks;
+  };
+
+  // |root| is the directory the handler is mounted on.
+  MemoryFileHandler(const std::string& root, size_t max_bytes);
+  virtual ~MemoryFileHandler();
+
+  virtual void addref();
+  virtual void release();
+
+  virtual FileStream* open(int fd, const char* pathname, int oflag, int* err);
+  virtual int stat(const char* pathname, nacl_abi_stat* out);
+  virtual int mkdir(const char* pathname, mode_t mode);
+
+  // File operations for MemoryFile.  They return 0 or an errno value.
+  int ReadAt(Inode* inode, int64_t offset, char* buf, size_t count,
+             size_t* nread);
+  // With |append| set, |*offset| is moved to the end of the file first.
+  int WriteAt(Inode* inode, int64_t* offset, bool append, const char* buf,
+              size_t count, size_t* nwrote);
+  int Truncate(Inode* inode, int64_t length);
+  int64_t GetSize(Inode* inode);
+  void Stat(Inode* inode, nacl_abi_stat* out);
+
+ private:
+  typedef std::map<std::string, Inode*> InodeMap;
+
+  static const size_t kMaxInodes = 1024;
+
+  // Return |pathname| without repeated slashes and "." components.
+  static std::string Normalize(const char* pathname);
+  // Create an inode at |path|, whose parent has to be a directory.
+  int Create(const std::string& path, bool is_dir, Inode** inode);
+  void StatLocked(Inode* inode, nacl_abi_stat* out);
+  int TruncateLocked(Inode* inode, int64_t length);
+
+  int ref_;
+  size_t max_bytes_;
+  size_t used_bytes_;
+  nacl_abi_ino_t next_ino_;
+  Mutex mutex_;
+  InodeMap inodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryFileHandler);
+};
+
+class MemoryFile : public FileStream {
+ public:
+  MemoryFile(int fd, int oflag, MemoryFileHandler* handler,
+             MemoryFileHandler::Inode* inode);
+  virtual ~MemoryFile();
+
+  virtual void addref();
+  virtual void release();
+  virtual FileStream* dup(int fd);
+
+  virtual void close();
+  virtual int read(char* buf, size_t count, size_t* nread);
+  virtual int write(const char* buf, size_t count, size_t* nwrote);
+  virtual int pread(char* buf, size_t count, nacl_abi_off_t offset,
+                    size_t* nread);
+  virtual int pwrite(const char* buf, size_t count, nacl_abi_off_t offset,
+                     size_t* nwrote);
+  virtual int fsync();
+  virtual int ftruncate(nacl_abi_off_t length);
+  virtual int seek(nacl_abi_off_t offset, int whence,
+                   nacl_abi_off_t* new_offset);
+  virtual int fstat(nacl_abi_stat* out);
+
+  virtual int fcntl(int cmd,  va_list ap);
+
+ private:
+  bool is_readable() { return (oflag_ & O_ACCMODE) != O_WRONLY; }
+  bool is_writable() { return (oflag_ & O_ACCMODE) != O_RDONLY; }
+
+  int ref_;
+  int fd_;
+  int oflag_;
+  MemoryFileHandler* handler_;
+  MemoryFileHandler::Inode* inode_;
+  int64_t offset_;
+
+  DISALLOW_COPY_AND_ASSIGN(MemoryFile);
+};
+
+#endif  // MEMORY_FILE_H
@@ -0,0 +1,85 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "mount_table.h"
+
+#include <string.h>
+
+namespace {
+
+// Move |*path| past the next component and return its length, or 0 at the
+// end of the path.
+size_t NextComponent(const char** path) {
+  for (;;) {
+    while (**path == '/')
+      (*path)++;
+    size_t len = strcspn(*path, "/");
+    if (len == 1 && **path == '.') {
+      (*path)++;
+      continue;
+    }
+    *path += len;
+    return len;
+  }
+}
+
+}  // namespace
+
+MountTable::MountTable() {
+}
+
+MountTable::~MountTable() {
+  ReleaseNode(&root_);
+}
+
+void MountTable::ReleaseNode(Node* node) {
+  for (std::map<std::string, Node*>::iterator it = node->children.begin();
+       it != node->children.end(); ++it) {
+    ReleaseNode(it->second);
+    delete it->second;
+  }
+  if (node->exact)
+    node->exact->release();
+  if (node->subtree)
+    node->subtree->release();
+}
+
+bool MountTable::Mount(const std::string& path, PathHandler* handler) {
+  Node* node = &root_;
+  const char* p = path.c_str();
+  for (;;) {
+    size_t len = NextComponent(&p);
+    if (!len)
+      break;
+    Node*& child = node->children[std::string(p - len, len)];
+    if (!child)
+      child = new Node();
+    node = child;
+  }
+
+  bool is_subtree = !path.empty() && path[path.size() - 1] == '/';
+  PathHandler** slot = is_subtree ? &node->subtree : &node->exact;
+  if (*slot)
+    return false;
+  *slot = handler;
+  return true;
+}
+
+PathHandler* MountTable::Find(const char* path) const {
+  const Node* node = &root_;
+  PathHandler* handler = root_.subtree;
+  for (;;) {
+    size_t len = NextComponent(&path);
+    if (!len)
+      break;
+    std::map<std::string, Node*>::const_iterator it =
+        node->children.find(std::string(path - len, len));
+    if (it == node->children.end())
+      return handler;
+    node = it->second;
+    if (node->subtree)
+      handler = node->subtree;
+  }
+  return node->exact ? node->exact : handler;
+}
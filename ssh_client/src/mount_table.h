@@ -0,0 +1,55 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef MOUNT_TABLE_H
+#define MOUNT_TABLE_H
+
+#include <map>
+#include <string>
+
+#include "file_interfaces.h"
+#include "pthread_helpers.h"
+
+// Maps paths to the handlers serving them.
+//
+// Handlers are mounted either on a single path, e.g. "/dev/null", or on a whole
+// subtree when the path ends in a slash, e.g. "/tmp/".  Mounts are kept in a
+// trie of path components, so a lookup takes one step per component of the
+// path and picks the most specific mount: an exact mount of the path itself,
+// or else the deepest subtree mount above it.
+//
+// Empty and "." components are skipped, so "//tmp/./x" finds the same handler
+// as "/tmp/x".  ".." is not resolved.
+class MountTable {
+ public:
+  MountTable();
+  // Releases the mounted handlers.
+  ~MountTable();
+
+  // Mount |handler| on |path|.  Ownership of the reference is taken.  Return
+  // false if something is mounted there already.
+  bool Mount(const std::string& path, PathHandler* handler);
+
+  // Return the handler for |path| or NULL if there is none.  No reference is
+  // added.
+  PathHandler* Find(const char* path) const;
+
+ private:
+  struct Node {
+    Node() : exact(NULL), subtree(NULL) {}
+
+    std::map<std::string, Node*> children;
+    PathHandler* exact;
+    PathHandler* subtree;
+  };
+
+  // Release the handlers mounted on |node| and below, and free its children.
+  static void ReleaseNode(Node* node);
+
+  Node root_;
+
+  DISALLOW_COPY_AND_ASSIGN(MountTable);
+};
+
+#endif  // MOUNT_TABLE_H
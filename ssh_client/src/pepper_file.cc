@@ -5,6 +5,9 @@
 #include "pepper_file.h"
 
 #include <assert.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 
 #include "nacl_io/pepper_interface.h"
 #include "ppapi/c/pp_errors.h"
@@ -13,10 +16,44 @@
 
 #include "file_system.h"
 
-const size_t PepperFile::kBufSize;
+const size_t PepperFile::kBlockSize;
+const size_t PepperFile::kMinReadAhead;
+const size_t PepperFile::kMaxReadAhead;
+const size_t PepperFile::kMaxBlocks;
+const size_t PepperFile::kMaxWriteBehind;
+
+namespace {
+
+// The HTML5 file system has no notion of owners or permissions, so report
+// what OpenSSH expects of the user's own files.
+void FileInfoToStat(const PP_FileInfo& info, nacl_abi_stat* out) {
+  memset(out, 0, sizeof(nacl_abi_stat));
+  switch (info.type) {
+    case PP_FILETYPE_REGULAR:
+      out->nacl_abi_st_mode = S_IFREG | 0600;
+      break;
+    case PP_FILETYPE_DIRECTORY:
+      out->nacl_abi_st_mode = S_IFDIR | 0700;
+      break;
+    case PP_FILETYPE_OTHER:
+      break;
+  }
+  out->nacl_abi_st_nlink = 1;
+  out->nacl_abi_st_size = info.size;
+  // stdio sizes its buffers from this.
+  out->nacl_abi_st_blksize = PepperFile::kBlockSize;
+  out->nacl_abi_st_blocks = (info.size + 511) / 512;
+  out->nacl_abi_st_atime = info.last_access_time;
+  out->nacl_abi_st_mtime = info.last_modified_time;
+  out->nacl_abi_st_ctime = info.last_modified_time;
+}
+
+}  // namespace
+
+const size_t PepperFileHandler::kMaxStatEntries;
 
 PepperFileHandler::PepperFileHandler(pp::FileSystem* file_system)
-    : ref_(1), file_system_(file_system) {
+    : ref_(1), file_system_(file_system), factory_(this), generation_(0) {
   assert(file_system);
 }
 
@@ -25,18 +62,24 @@ PepperFileHandler::~PepperFileHandler() {
 }
 
 void PepperFileHandler::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void PepperFileHandler::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
 FileStream* PepperFileHandler::open(int fd, const char* pathname, int oflag,
                                     int* err) {
-  PepperFile* file = new PepperFile(fd, oflag, file_system_);
-  int32_t ret = file->open(pathname);
+  PepperFile* file = new PepperFile(fd, oflag, file_system_, this);
+  int32_t ret;
+  {
+    Mutex::Lock lock(file->mutex());
+    ret = file->open(pathname);
+  }
+  if (oflag & (O_CREAT | O_TRUNC))
+    Invalidate(pathname);
   if (ret == 0) {
     return file;
   } else {
@@ -47,27 +90,105 @@ FileStream* PepperFileHandler::open(int fd, const char* pathname, int oflag,
 }
 
 int PepperFileHandler::stat(const char* pathname, nacl_abi_stat* out) {
-  memset(out, 0, sizeof(nacl_abi_stat));
-  return 0;
+  Mutex::Lock lock(mutex_);
+  StatCache::iterator it = stat_cache_.find(pathname);
+  if (it != stat_cache_.end()) {
+    if (!it->second.err)
+      *out = it->second.st;
+    return it->second.err;
+  }
+
+  uint32_t generation = generation_;
+  PP_FileInfo info;
+  int32_t result = PP_OK_COMPLETIONPENDING;
+  pp::Module::Get()->core()->CallOnMainThread(0,
+      factory_.NewCallback(&PepperFileHandler::Query, pathname, &info,
+                           &result));
+  while (result == PP_OK_COMPLETIONPENDING)
+    cond_.wait(mutex_);
+
+  StatEntry entry;
+  if (result == PP_OK) {
+    entry.err = 0;
+    FileInfoToStat(info, &entry.st);
+    *out = entry.st;
+  } else {
+    entry.err = nacl_io::PPErrorToErrno(result);
+  }
+
+  // Other failures may well be transient.
+  if ((result == PP_OK || result == PP_ERROR_FILENOTFOUND) &&
+      generation == generation_) {
+    if (stat_cache_.size() >= kMaxStatEntries)
+      stat_cache_.clear();
+    stat_cache_[pathname] = entry;
+  }
+  return entry.err;
+}
+
+void PepperFileHandler::Invalidate(const char* pathname) {
+  Mutex::Lock lock(mutex_);
+  stat_cache_.erase(pathname);
+  generation_++;
+}
+
+void PepperFileHandler::InvalidateWithAncestors(const char* pathname) {
+  Mutex::Lock lock(mutex_);
+  std::string path(pathname);
+  while (!path.empty()) {
+    stat_cache_.erase(path);
+    std::string::size_type slash = path.find_last_of('/');
+    if (slash == std::string::npos)
+      break;
+    path.resize(slash);
+  }
+  generation_++;
+}
+
+void PepperFileHandler::Query(int32_t result, const char* pathname,
+                              PP_FileInfo* info, int32_t* pres) {
+  Mutex::Lock lock(mutex_);
+  pp::FileRef* file_ref = new pp::FileRef(*file_system_, pathname);
+  result = file_ref->Query(factory_.NewCallbackWithOutput(
+      &PepperFileHandler::OnQuery, file_ref, info, pres));
+  if (result != PP_OK_COMPLETIONPENDING) {
+    delete file_ref;
+    *pres = result;
+    cond_.broadcast();
+  }
+}
+
+void PepperFileHandler::OnQuery(int32_t result, const PP_FileInfo& info,
+                                pp::FileRef* file_ref, PP_FileInfo* out,
+                                int32_t* pres) {
+  Mutex::Lock lock(mutex_);
+  delete file_ref;
+  *out = info;
+  *pres = result;
+  cond_.broadcast();
 }
 
 //------------------------------------------------------------------------------
 
-PepperFile::PepperFile(int fd, int oflag, pp::FileSystem* file_system)
+PepperFile::PepperFile(int fd, int oflag, pp::FileSystem* file_system,
+                       PepperFileHandler* handler)
   : ref_(1), fd_(fd), oflag_(oflag), factory_(this), file_system_(file_system),
-    file_io_(NULL), offset_(0), file_info_(), write_sent_(false) {
+    handler_(handler), file_io_(NULL), offset_(0), file_info_(),
+    read_ahead_(kMinReadAhead), next_fetch_(-1), pending_offset_(0) {
+  handler_->addref();
 }
 
 PepperFile::~PepperFile() {
   assert(!ref_);
+  handler_->release();
 }
 
 void PepperFile::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void PepperFile::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -77,115 +198,100 @@ FileStream* PepperFile::dup(int fd) {
 }
 
 int32_t PepperFile::open(const char* pathname) {
+  pathname_ = pathname;
   int32_t result = PP_OK_COMPLETIONPENDING;
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&PepperFile::Open, pathname, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
   return result;
 }
 
 void PepperFile::close() {
+  // There is nobody left to report a failure to.
+  FlushWrites();
+  blocks_.clear();
+
   int32_t result = PP_OK_COMPLETIONPENDING;
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&PepperFile::Close, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
 }
 
 int PepperFile::read(char* buf, size_t count, size_t* nread) {
-  if (!is_open())
-    return EIO;
-
-  FileSystem* sys = FileSystem::GetFileSystem();
-  if (is_block() && in_buf_.empty()) {
-    int32_t result = PP_OK_COMPLETIONPENDING;
-    pp::Module::Get()->core()->CallOnMainThread(0,
-        factory_.NewCallback(&PepperFile::Read, count, &result));
-    while (result == PP_OK_COMPLETIONPENDING)
-      sys->cond().wait(sys->mutex());
-    if (result < 0) {
-      *nread = -1;
-      return EIO;
-    }
-  }
+  int err = ReadAt(offset_, buf, count, nread);
+  if (!err)
+    offset_ += *nread;
+  return err;
+}
 
-  *nread = 0;
-  while (*nread < count) {
-    if (in_buf_.empty())
-      break;
+int PepperFile::write(const char* buf, size_t count, size_t* nwrote) {
+  if (oflag_ & O_APPEND)
+    offset_ = file_info_.size;
+  int err = WriteAt(offset_, buf, count, nwrote);
+  if (!err)
+    offset_ += *nwrote;
+  return err;
+}
 
-    buf[(*nread)++] = in_buf_.front();
-    offset_++;
-    in_buf_.pop_front();
-  }
+int PepperFile::pread(char* buf, size_t count, nacl_abi_off_t offset,
+                      size_t* nread) {
+  if (offset < 0)
+    return EINVAL;
+  return ReadAt(offset, buf, count, nread);
+}
 
-  return 0;
+int PepperFile::pwrite(const char* buf, size_t count, nacl_abi_off_t offset,
+                       size_t* nwrote) {
+  if (offset < 0)
+    return EINVAL;
+  return WriteAt(offset, buf, count, nwrote);
 }
 
-int PepperFile::write(const char* buf, size_t count, size_t* nwrote) {
+int PepperFile::fsync() {
   if (!is_open())
-    return EIO;
-
-  out_buf_.insert(out_buf_.end(), buf, buf + count);
-  if (is_block()) {
-    int32_t result = PP_OK_COMPLETIONPENDING;
-    pp::Module::Get()->core()->CallOnMainThread(0,
-        factory_.NewCallback(&PepperFile::Write, &result));
-    FileSystem* sys = FileSystem::GetFileSystem();
-    while (result == PP_OK_COMPLETIONPENDING)
-      sys->cond().wait(sys->mutex());
-    if ((size_t)result != count) {
-      *nwrote = -1;
-      return EIO;
-    } else {
-      *nwrote = count;
-      return 0;
-    }
-  } else {
-    if (!write_sent_) {
-      write_sent_ = true;
-      pp::Module::Get()->core()->CallOnMainThread(0,
-        factory_.NewCallback(&PepperFile::Write, (int32_t*)NULL));
-    }
-    *nwrote = count;
-    return 0;
-  }
+    return EBADF;
+  return FlushWrites();
 }
 
 int PepperFile::seek(nacl_abi_off_t offset, int whence,
                      nacl_abi_off_t* new_offset) {
+  // The cache is keyed by file offset, so there is nothing to drop here.
+  int64_t base;
   switch (whence) {
     case SEEK_SET:
-      offset_ = offset;
-      if (new_offset)
-        *new_offset = offset_;
-      return 0;
+      base = 0;
+      break;
 
     case SEEK_CUR:
-      offset_ += offset;
-      if (new_offset)
-        *new_offset = offset_;
-      return 0;
+      base = offset_;
+      break;
 
     case SEEK_END:
-      offset_ = file_info_.size + offset;
-      if (new_offset)
-        *new_offset = offset_;
-      return 0;
+      base = file_info_.size;
+      break;
 
     default:
       if (new_offset)
         *new_offset = -1;
       return EINVAL;
   }
+
+  if (base + offset < 0) {
+    if (new_offset)
+      *new_offset = -1;
+    return EINVAL;
+  }
+
+  offset_ = base + offset;
+  if (new_offset)
+    *new_offset = offset_;
+  return 0;
 }
 
 int PepperFile::fstat(nacl_abi_stat* out) {
-  memset(out, 0, sizeof(nacl_abi_stat));
-  out->nacl_abi_st_size = file_info_.size;
+  FileInfoToStat(file_info_, out);
   return 0;
 }
 
@@ -193,34 +299,166 @@ int PepperFile::fcntl(int cmd, va_list ap) {
   if (cmd == F_GETFL) {
     return oflag_;
   } else if (cmd == F_SETFL) {
-    int oflag = va_arg(ap, long);
-    if (is_block() && (oflag & O_NONBLOCK)) {
-      pp::Module::Get()->core()->CallOnMainThread(0,
-          factory_.NewCallback(&PepperFile::Read,
-                                       kBufSize, (int32_t*)NULL));
-    }
-    oflag_ = oflag;
+    // Regular files are always ready, so O_NONBLOCK changes nothing.
+    oflag_ = va_arg(ap, long);
     return 0;
   } else {
     return -1;
   }
 }
 
-bool PepperFile::is_read_ready() {
-  return !in_buf_.empty();
+bool PepperFile::is_exception() {
+  return !is_open();
+}
+
+int PepperFile::ReadAt(int64_t offset, char* buf, size_t count,
+                       size_t* nread) {
+  if (!is_open())
+    return EIO;
+
+  *nread = 0;
+  while (count) {
+    int64_t index = offset / kBlockSize;
+    const std::vector<char>* block;
+    int err = GetBlock(index, &block);
+    if (err)
+      return *nread ? 0 : err;
+
+    size_t skip = offset - index * kBlockSize;
+    if (skip >= block->size())
+      break;
+    size_t n = std::min(count, block->size() - skip);
+    memcpy(buf, &(*block)[skip], n);
+    buf += n;
+    count -= n;
+    offset += n;
+    *nread += n;
+  }
+  return 0;
+}
+
+int PepperFile::WriteAt(int64_t offset, const char* buf, size_t count,
+                        size_t* nwrote) {
+  if (!is_open())
+    return EIO;
+  // Check now: write-behind would only fail later, when the data is flushed.
+  if ((oflag_ & O_ACCMODE) == O_RDONLY)
+    return EBADF;
+
+  if (!pending_.empty() &&
+      offset != pending_offset_ + (int64_t)pending_.size()) {
+    int err = FlushWrites();
+    if (err)
+      return err;
+  }
+
+  if (pending_.empty())
+    pending_offset_ = offset;
+  pending_.insert(pending_.end(), buf, buf + count);
+  InvalidateBlocks(offset, count);
+  file_info_.size = std::max(file_info_.size, (int64_t)(offset + count));
+
+  if (pending_.size() >= kMaxWriteBehind) {
+    int err = FlushWrites();
+    if (err)
+      return err;
+  }
+
+  *nwrote = count;
+  return 0;
 }
 
-bool PepperFile::is_write_ready() {
-  return out_buf_.size() < kBufSize;
+int PepperFile::GetBlock(int64_t index, const std::vector<char>** block) {
+  int64_t block_offset = index * kBlockSize;
+  BlockMap::iterator it = blocks_.find(index);
+  // A short block is stale once the file has grown past it.
+  if (it != blocks_.end() && (it->second.size() == kBlockSize ||
+      block_offset + (int64_t)it->second.size() >= file_info_.size)) {
+    *block = &it->second;
+    return 0;
+  }
+
+  // Pepper has to see the pending writes before we read anything back.
+  int err = FlushWrites();
+  if (err)
+    return err;
+
+  if (index == next_fetch_)
+    read_ahead_ = std::min(read_ahead_ * 2, kMaxReadAhead);
+  else
+    read_ahead_ = kMinReadAhead;
+
+  // Don't fetch again what is cached already.
+  size_t count = read_ahead_;
+  BlockMap::iterator next = blocks_.upper_bound(index);
+  if (next != blocks_.end())
+    count = std::min(count, (size_t)(next->first - index));
+
+  int32_t result = PP_OK_COMPLETIONPENDING;
+  pp::Module::Get()->core()->CallOnMainThread(0,
+      factory_.NewCallback(&PepperFile::Read, block_offset,
+                           count * kBlockSize, &result));
+  while (result == PP_OK_COMPLETIONPENDING)
+    wait_queue().wait(mutex());
+  if (result < 0)
+    return EIO;
+
+  size_t fetched = (result + kBlockSize - 1) / kBlockSize;
+  if (!fetched)
+    fetched = 1;
+  while (!blocks_.empty() && blocks_.size() + fetched > kMaxBlocks)
+    blocks_.erase(blocks_.begin());
+
+  for (size_t i = 0; i < fetched; i++) {
+    size_t start = i * kBlockSize;
+    size_t end = std::min(start + kBlockSize, (size_t)result);
+    std::vector<char>& data = blocks_[index + i];
+    data.assign(read_buf_.begin() + std::min(start, end),
+                read_buf_.begin() + end);
+  }
+  read_buf_.clear();
+  next_fetch_ = index + fetched;
+
+  *block = &blocks_[index];
+  return 0;
 }
 
-bool PepperFile::is_exception() {
-  return !is_open();
+void PepperFile::InvalidateBlocks(int64_t offset, size_t count) {
+  if (!count)
+    return;
+  BlockMap::iterator first = blocks_.lower_bound(offset / kBlockSize);
+  BlockMap::iterator last =
+      blocks_.upper_bound((offset + count - 1) / kBlockSize);
+  blocks_.erase(first, last);
+}
+
+int PepperFile::FlushWrites() {
+  if (pending_.empty())
+    return 0;
+
+  write_buf_.swap(pending_);
+  pending_.clear();
+  size_t sent = 0;
+  while (sent < write_buf_.size()) {
+    int32_t result = PP_OK_COMPLETIONPENDING;
+    pp::Module::Get()->core()->CallOnMainThread(0,
+        factory_.NewCallback(&PepperFile::Write, pending_offset_ + sent,
+                             sent, &result));
+    while (result == PP_OK_COMPLETIONPENDING)
+      wait_queue().wait(mutex());
+    if (result <= 0)
+      break;
+    sent += result;
+  }
+  bool ok = sent == write_buf_.size();
+  write_buf_.clear();
+  handler_->Invalidate(pathname_.c_str());
+  return ok ? 0 : EIO;
 }
 
 void PepperFile::Open(int32_t result, const char* pathname, int32_t* pres) {
   FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   pp::FileRef file_ref(*file_system_, pathname);
   file_io_ = new pp::FileIO(sys->instance());
   int open_flags;
@@ -237,12 +475,11 @@ void PepperFile::Open(int32_t result, const char* pathname, int32_t* pres) {
   *pres = file_io_->Open(file_ref, open_flags,
       factory_.NewCallback(&PepperFile::OnOpen, pres));
   if (*pres != PP_OK_COMPLETIONPENDING)
-    sys->cond().broadcast();
+    wait_queue().broadcast();
 }
 
 void PepperFile::OnOpen(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   if (result == PP_OK) {
     result = file_io_->Query(&file_info_,
         factory_.NewCallback(&PepperFile::OnQuery, pres));
@@ -252,108 +489,61 @@ void PepperFile::OnOpen(int32_t result, int32_t* pres) {
   delete file_io_;
   file_io_ = NULL;
   *pres = result;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void PepperFile::OnQuery(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   if (result == PP_OK) {
-    if (oflag_ & O_APPEND) {
+    if (oflag_ & O_APPEND)
       offset_ = file_info_.size;
-    } else {
-      if (!is_block())
-        Read(PP_OK, kBufSize, NULL);
-    }
   } else {
     delete file_io_;
     file_io_ = NULL;
   }
   *pres = result;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
-void PepperFile::Read(int32_t result, size_t count, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+void PepperFile::Read(int32_t result, int64_t offset, size_t count,
+                      int32_t* pres) {
+  Mutex::Lock lock(mutex());
   assert(file_io_);
   read_buf_.resize(count);
-  result = file_io_->Read(offset_, &read_buf_[0], read_buf_.size(),
+  *pres = file_io_->Read(offset, &read_buf_[0], read_buf_.size(),
       factory_.NewCallback(&PepperFile::OnRead, pres));
-  if (result != PP_OK_COMPLETIONPENDING) {
-    delete file_io_;
-    file_io_ = NULL;
-    if (pres)
-      *pres = result;
-    sys->cond().broadcast();
-  }
+  if (*pres != PP_OK_COMPLETIONPENDING)
+    wait_queue().broadcast();
 }
 
 void PepperFile::OnRead(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
-  if (result >= 0) {
-    in_buf_.insert(in_buf_.end(), &read_buf_[0], &read_buf_[0] + result);
-    if (result && !is_block() && in_buf_.size() < kBufSize)
-      Read(PP_OK, kBufSize, NULL);
-  } else {
-    delete file_io_;
-    file_io_ = NULL;
-  }
-  if (pres)
-    *pres = result;
-  sys->cond().broadcast();
+  Mutex::Lock lock(mutex());
+  *pres = result;
+  wait_queue().broadcast();
 }
 
-void PepperFile::Write(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+void PepperFile::Write(int32_t result, int64_t offset, size_t start,
+                       int32_t* pres) {
+  Mutex::Lock lock(mutex());
   assert(file_io_);
-  if (result == PP_OK) {
-    if (write_buf_.size()) {
-      // Previous write operation is in progress.
-      pp::Module::Get()->core()->CallOnMainThread(1,
-          factory_.NewCallback(&PepperFile::Write, &result));
-      return;
-    }
-    assert(out_buf_.size());
-    write_buf_.swap(out_buf_);
-    result = file_io_->Write(offset_, &write_buf_[0], write_buf_.size(),
-        factory_.NewCallback(&PepperFile::OnWrite, pres));
-    write_sent_ = false;
-  } else {
-    result = PP_ERROR_FAILED;
-  }
-  if (result != PP_OK_COMPLETIONPENDING) {
-    delete file_io_;
-    file_io_ = NULL;
-    if (pres)
-      *pres = result;
-    sys->cond().broadcast();
-  }
+  *pres = file_io_->Write(offset, &write_buf_[start],
+      write_buf_.size() - start,
+      factory_.NewCallback(&PepperFile::OnWrite, pres));
+  if (*pres != PP_OK_COMPLETIONPENDING)
+    wait_queue().broadcast();
 }
 
 void PepperFile::OnWrite(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
-  if ((size_t)result != write_buf_.size()) {
-    delete file_io_;
-    file_io_ = NULL;
-  } else {
-    offset_ += result;
-  }
-  if (pres)
-    *pres = result;
-  write_buf_.clear();
-  sys->cond().broadcast();
+  Mutex::Lock lock(mutex());
+  *pres = result;
+  wait_queue().broadcast();
 }
 
 void PepperFile::Close(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   delete file_io_;
   file_io_ = NULL;
   if (pres)
     *pres = PP_OK;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
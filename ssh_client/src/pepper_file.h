@@ -5,11 +5,13 @@
 #ifndef PEPPER_FILE_H
 #define PEPPER_FILE_H
 
-#include <deque>
+#include <map>
+#include <string>
 #include <vector>
 
 #include "ppapi/utility/completion_callback_factory.h"
 #include "ppapi/cpp/file_io.h"
+#include "ppapi/cpp/file_ref.h"
 #include "ppapi/cpp/file_system.h"
 
 #include "file_interfaces.h"
@@ -26,19 +28,55 @@ class PepperFileHandler : public PathHandler {
   virtual FileStream* open(int fd, const char* pathname, int oflag, int* err);
   virtual int stat(const char* pathname, nacl_abi_stat* out);
 
+  // Forget the cached metadata of |pathname|, e.g. after it was written to.
+  void Invalidate(const char* pathname);
+  // Like Invalidate(), for |pathname| and every directory above it.
+  void InvalidateWithAncestors(const char* pathname);
+
  private:
+  // The result of querying a path.  Paths that don't exist are cached too,
+  // with |err| set, so that probing for missing files is cheap.
+  struct StatEntry {
+    int err;
+    nacl_abi_stat st;
+  };
+  typedef std::map<std::string, StatEntry> StatCache;
+
+  void Query(int32_t result, const char* pathname, PP_FileInfo* info,
+             int32_t* pres);
+  void OnQuery(int32_t result, const PP_FileInfo& info,
+               pp::FileRef* file_ref, PP_FileInfo* out, int32_t* pres);
+
+  static const size_t kMaxStatEntries = 256;
+
   int ref_;
   pp::FileSystem* file_system_;
+  pp::CompletionCallbackFactory<PepperFileHandler> factory_;
+  Mutex mutex_;
+  Cond cond_;
+  StatCache stat_cache_;
+  // Bumped by every invalidation, so that queries which raced with one don't
+  // put stale results into the cache.
+  uint32_t generation_;
 
   DISALLOW_COPY_AND_ASSIGN(PepperFileHandler);
 };
 
+// A file in the HTML5 file system.  Reads and writes go through a cache of
+// page sized blocks: sequential reads fetch a growing window of blocks ahead
+// of the caller and contiguous writes are collected and sent to Pepper in one
+// go, so small stdio sized calls don't each take a trip to the main thread.
+// Pending writes are sent before anything is read back from Pepper, and on
+// fsync() and close().
 class PepperFile : public FileStream {
  public:
-  PepperFile(int fd, int oflag, pp::FileSystem* file_system);
+  // Room in a block of the cache.  Also reported as the preferred I/O size.
+  static const size_t kBlockSize = 4096;
+
+  PepperFile(int fd, int oflag, pp::FileSystem* file_system,
+             PepperFileHandler* handler);
   virtual ~PepperFile();
 
-  bool is_block() { return !(oflag_ & O_NONBLOCK); }
   bool is_open() { return file_io_ != NULL; }
 
   int32_t open(const char* pathname);
@@ -50,44 +88,74 @@ class PepperFile : public FileStream {
   virtual void close();
   virtual int read(char* buf, size_t count, size_t* nread);
   virtual int write(const char* buf, size_t count, size_t* nwrote);
+  virtual int pread(char* buf, size_t count, nacl_abi_off_t offset,
+                    size_t* nread);
+  virtual int pwrite(const char* buf, size_t count, nacl_abi_off_t offset,
+                     size_t* nwrote);
+  virtual int fsync();
   virtual int seek(nacl_abi_off_t offset, int whence,
                    nacl_abi_off_t* new_offset);
   virtual int fstat(nacl_abi_stat* out);
 
   virtual int fcntl(int cmd,  va_list ap);
 
-  virtual bool is_read_ready();
-  virtual bool is_write_ready();
   virtual bool is_exception();
 
  private:
+  typedef std::map<int64_t, std::vector<char> > BlockMap;
+
+  int ReadAt(int64_t offset, char* buf, size_t count, size_t* nread);
+  int WriteAt(int64_t offset, const char* buf, size_t count, size_t* nwrote);
+  // Return cached block |index|, fetching it and the blocks after it if
+  // needed.  A block shorter than kBlockSize ends at the end of the file.
+  int GetBlock(int64_t index, const std::vector<char>** block);
+  // Drop cached blocks overlapping |count| bytes at |offset|.
+  void InvalidateBlocks(int64_t offset, size_t count);
+  // Send the pending writes to Pepper.  Return 0 or an errno value.
+  int FlushWrites();
+
   void Open(int32_t result, const char* pathname, int32_t* pres);
   void OnOpen(int32_t result, int32_t* pres);
   void OnQuery(int32_t result, int32_t* pres);
 
-  void Read(int32_t result, size_t count, int32_t* pres);
+  void Read(int32_t result, int64_t offset, size_t count, int32_t* pres);
   void OnRead(int32_t result, int32_t* pres);
 
-  void Write(int32_t result, int32_t* pres);
+  void Write(int32_t result, int64_t offset, size_t start, int32_t* pres);
   void OnWrite(int32_t result, int32_t* pres);
 
   void Close(int32_t result, int32_t* pres);
 
-  static const size_t kBufSize = 64 * 1024;
+  // Read-ahead starts at kMinReadAhead blocks and doubles with every
+  // sequential fetch up to kMaxReadAhead blocks.
+  static const size_t kMinReadAhead = 4;
+  static const size_t kMaxReadAhead = 16;
+  static const size_t kMaxBlocks = 64;
+  // Pending writes are sent once they reach this many bytes.
+  static const size_t kMaxWriteBehind = 64 * 1024;
 
   int ref_;
   int fd_;
   int oflag_;
   pp::CompletionCallbackFactory<PepperFile> factory_;
   pp::FileSystem* file_system_;
+  // Told about writes, to keep its metadata cache up to date.
+  PepperFileHandler* handler_;
+  std::string pathname_;
   pp::FileIO* file_io_;
   int64_t offset_;
+  // |file_info_.size| includes the pending writes.
   PP_FileInfo file_info_;
-  std::deque<char> in_buf_;
-  std::vector<char> out_buf_;
+  BlockMap blocks_;
+  size_t read_ahead_;
+  // Block following the last fetch, to tell sequential reads from random ones.
+  int64_t next_fetch_;
+  // Contiguous bytes written at |pending_offset_| but not sent yet.
+  std::vector<char> pending_;
+  int64_t pending_offset_;
+  // Buffers of the Pepper call in flight.
   std::vector<char> read_buf_;
   std::vector<char> write_buf_;
-  bool write_sent_;
 
   DISALLOW_COPY_AND_ASSIGN(PepperFile);
 };
@@ -0,0 +1,83 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pepper_resolver_backend.h"
+
+#include <sys/socket.h>
+
+#include "ppapi/cpp/module.h"
+#include "ppapi/cpp/private/net_address_private.h"
+
+PepperResolverBackend::PepperResolverBackend(pp::Instance* instance)
+    : instance_(instance), factory_(this) {
+}
+
+PepperResolverBackend::~PepperResolverBackend() {
+}
+
+void PepperResolverBackend::Resolve(HostResolver::Query* query) {
+  pp::Module::Get()->core()->CallOnMainThread(0,
+      factory_.NewCallback(&PepperResolverBackend::StartResolve, query));
+}
+
+void PepperResolverBackend::StartResolve(int32_t result,
+                                         HostResolver::Query* query) {
+  if (!pp::HostResolverPrivate::IsAvailable()) {
+    query->Complete(HostResolver::Result());
+    return;
+  }
+
+  PP_HostResolver_Private_Hint hint = {
+      PP_NETADDRESSFAMILY_PRIVATE_UNSPECIFIED,
+      PP_HOST_RESOLVER_PRIVATE_FLAGS_CANONNAME,
+  };
+  if (query->family() == AF_INET)
+    hint.family = PP_NETADDRESSFAMILY_PRIVATE_IPV4;
+  else if (query->family() == AF_INET6)
+    hint.family = PP_NETADDRESSFAMILY_PRIVATE_IPV6;
+
+  pp::HostResolverPrivate* resolver = new pp::HostResolverPrivate(instance_);
+  result = resolver->Resolve(query->hostname(), 0, hint,
+      factory_.NewCallback(&PepperResolverBackend::OnResolve, query,
+                           resolver));
+  if (result != PP_OK_COMPLETIONPENDING) {
+    delete resolver;
+    query->Complete(HostResolver::Result());
+  }
+}
+
+void PepperResolverBackend::OnResolve(int32_t result,
+                                      HostResolver::Query* query,
+                                      pp::HostResolverPrivate* resolver) {
+  HostResolver::Result res;
+  if (result == PP_OK) {
+    pp::Var name = resolver->GetCanonicalName();
+    if (name.is_string())
+      res.canonical_name = name.AsString();
+
+    size_t size = resolver->GetSize();
+    for (size_t i = 0; i < size; i++) {
+      PP_NetAddress_Private netaddr = {};
+      if (!resolver->GetNetAddress(i, &netaddr))
+        continue;
+
+      HostResolver::Address addr = {};
+      PP_NetAddressFamily_Private family =
+          pp::NetAddressPrivate::GetFamily(netaddr);
+      if (family == PP_NETADDRESSFAMILY_PRIVATE_IPV4) {
+        addr.family = AF_INET;
+        pp::NetAddressPrivate::GetAddress(netaddr, &addr.v4, sizeof(addr.v4));
+      } else if (family == PP_NETADDRESSFAMILY_PRIVATE_IPV6) {
+        addr.family = AF_INET6;
+        pp::NetAddressPrivate::GetAddress(netaddr, &addr.v6, sizeof(addr.v6));
+      } else {
+        continue;
+      }
+      res.addresses.push_back(addr);
+    }
+    res.ok = !res.addresses.empty();
+  }
+  delete resolver;
+  query->Complete(res);
+}
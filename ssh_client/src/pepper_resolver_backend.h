@@ -0,0 +1,34 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PEPPER_RESOLVER_BACKEND_H
+#define PEPPER_RESOLVER_BACKEND_H
+
+#include "ppapi/cpp/instance.h"
+#include "ppapi/cpp/private/host_resolver_private.h"
+#include "ppapi/utility/completion_callback_factory.h"
+
+#include "host_resolver.h"
+#include "pthread_helpers.h"
+
+// Resolves names with pp::HostResolverPrivate.
+class PepperResolverBackend : public HostResolver::Backend {
+ public:
+  explicit PepperResolverBackend(pp::Instance* instance);
+  virtual ~PepperResolverBackend();
+
+  virtual void Resolve(HostResolver::Query* query);
+
+ private:
+  void StartResolve(int32_t result, HostResolver::Query* query);
+  void OnResolve(int32_t result, HostResolver::Query* query,
+                 pp::HostResolverPrivate* resolver);
+
+  pp::Instance* instance_;
+  pp::CompletionCallbackFactory<PepperResolverBackend> factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(PepperResolverBackend);
+};
+
+#endif  // PEPPER_RESOLVER_BACKEND_H
@@ -0,0 +1,123 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "poll_set.h"
+
+#include <assert.h>
+
+PollSet::PollSet()
+    : queue_waiter_(this), woken_(false), nready_(0), started_(false) {
+}
+
+PollSet::~PollSet() {
+  for (size_t i = 0; i < queues_.size(); i++) {
+    Mutex::Lock lock(*queues_[i].second);
+    queues_[i].first->RemoveWaiter(&queue_waiter_);
+  }
+  for (size_t i = 0; i < entries_.size(); i++) {
+    FileStream* stream = entries_[i].stream;
+    if (started_) {
+      Mutex::Lock lock(stream->mutex());
+      stream->wait_queue().RemoveWaiter(&entries_[i]);
+    }
+    stream->release();
+  }
+}
+
+void PollSet::Add(FileStream* stream, short events) {
+  assert(!started_);
+  stream->addref();
+  entries_.resize(entries_.size() + 1);
+  Entry& entry = entries_.back();
+  entry.set = this;
+  entry.stream = stream;
+  entry.events = events;
+  entry.revents = 0;
+  entry.changed = false;
+}
+
+void PollSet::Watch(WaitQueue* queue, Mutex* mutex) {
+  Mutex::Lock lock(*mutex);
+  queue->AddWaiter(&queue_waiter_);
+  queues_.push_back(std::make_pair(queue, mutex));
+}
+
+void PollSet::Start() {
+  assert(!started_);
+  // |entries_| doesn't change from now on so the entries can be registered.
+  started_ = true;
+  changed_.reserve(entries_.size());
+  for (size_t i = 0; i < entries_.size(); i++) {
+    Entry& entry = entries_[i];
+    Mutex::Lock lock(entry.stream->mutex());
+    entry.stream->wait_queue().AddWaiter(&entry);
+    entry.Check();
+    if (entry.revents)
+      nready_++;
+  }
+}
+
+int PollSet::Update() {
+  assert(started_);
+  std::vector<Entry*> changed;
+  {
+    Mutex::Lock lock(mutex_);
+    changed.swap(changed_);
+    for (size_t i = 0; i < changed.size(); i++)
+      changed[i]->changed = false;
+    woken_ = false;
+  }
+
+  // Streams are checked without |mutex_| held to keep the lock order.  If a
+  // stream changes again in the meantime it's simply put back on the list.
+  for (size_t i = 0; i < changed.size(); i++) {
+    Entry* entry = changed[i];
+    bool was_ready = entry->revents != 0;
+    {
+      Mutex::Lock lock(entry->stream->mutex());
+      entry->Check();
+    }
+    if (was_ready != (entry->revents != 0))
+      nready_ += was_ready ? -1 : 1;
+  }
+  return nready_;
+}
+
+int PollSet::Wait(const timespec* abstime) {
+  Mutex::Lock lock(mutex_);
+  while (!woken_) {
+    int ret = abstime ? cond_.timedwait(mutex_, abstime) : cond_.wait(mutex_);
+    if (ret)
+      return ret;
+  }
+  return 0;
+}
+
+void PollSet::Entry::Wake(WaitQueue* queue) {
+  Mutex::Lock lock(set->mutex_);
+  if (!changed) {
+    changed = true;
+    set->changed_.push_back(this);
+  }
+  set->woken_ = true;
+  set->cond_.signal();
+}
+
+void PollSet::Entry::Check() {
+  revents = 0;
+  if ((events & POLLIN) && stream->is_read_ready())
+    revents |= POLLIN;
+  if ((events & POLLOUT) && stream->is_write_ready())
+    revents |= POLLOUT;
+  // None of the streams carry out-of-band data, so POLLPRI is never set.  An
+  // exception is a hang up or a stream that isn't open.
+  if ((events & POLLHUP) && stream->is_exception())
+    revents |= POLLHUP;
+}
+
+void PollSet::QueueWaiter::Wake(WaitQueue* queue) {
+  Mutex::Lock lock(set_->mutex_);
+  set_->woken_ = true;
+  set_->cond_.signal();
+}
@@ -0,0 +1,92 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef POLL_SET_H
+#define POLL_SET_H
+
+#include <poll.h>
+#include <time.h>
+
+#include <utility>
+#include <vector>
+
+#include "file_interfaces.h"
+#include "pthread_helpers.h"
+
+// The streams a poll() or select() call is waiting on.
+//
+// Every stream is checked once when the set is started.  After that each entry
+// is a Waiter on its stream's wait queue, and a stream that changes state puts
+// its entry on a list of changed entries.  A wakeup thus only rechecks the
+// streams that changed, so waiting costs O(changed streams) rather than a scan
+// of every descriptor for every event type.
+//
+// Streams wake the set while holding their own mutex, so the set has a mutex
+// of its own that only guards the list of changed entries.  It is always taken
+// after a stream mutex, never before.
+class PollSet {
+ public:
+  PollSet();
+  ~PollSet();
+
+  // Watch |stream| for the POLLIN, POLLOUT and POLLHUP bits in |events|.
+  // POLLPRI may be asked for but is never reported.  The stream is pinned
+  // until the set is destroyed.  Must be called before Start().
+  void Add(FileStream* stream, short events);
+
+  // Also wake up the waiting thread when |queue| is woken.  |mutex| is the
+  // lock guarding |queue|.
+  void Watch(WaitQueue* queue, Mutex* mutex);
+
+  // Register with the streams' wait queues and check all of them once.
+  void Start();
+
+  // Recheck the streams that changed since the last call.  Returns the number
+  // of entries with events.
+  int Update();
+
+  // Block until a watched queue is woken, or until |abstime| if it is not
+  // NULL.  Returns right away if something was woken since the last Update().
+  int Wait(const timespec* abstime);
+
+  size_t size() const { return entries_.size(); }
+  short revents(size_t i) const { return entries_[i].revents; }
+
+ private:
+  struct Entry : public Waiter {
+    virtual void Wake(WaitQueue* queue);
+    void Check();
+
+    PollSet* set;
+    FileStream* stream;
+    short events;
+    short revents;
+    bool changed;
+  };
+
+  class QueueWaiter : public Waiter {
+   public:
+    explicit QueueWaiter(PollSet* set) : set_(set) {}
+    virtual void Wake(WaitQueue* queue);
+
+   private:
+    PollSet* set_;
+  };
+
+  std::vector<Entry> entries_;
+  std::vector<std::pair<WaitQueue*, Mutex*> > queues_;
+  QueueWaiter queue_waiter_;
+
+  // Guards the members below.
+  Mutex mutex_;
+  Cond cond_;
+  std::vector<Entry*> changed_;
+  bool woken_;
+  int nready_;
+  bool started_;
+
+  DISALLOW_COPY_AND_ASSIGN(PollSet);
+};
+
+#endif  // POLL_SET_H
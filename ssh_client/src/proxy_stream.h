@@ -19,10 +19,10 @@ class ProxyStream : public FileStream {
   }
 
   void addref() {
-    ++ref_;
+    __sync_add_and_fetch(&ref_, 1);
   }
   void release() {
-    if (!--ref_)
+    if (!__sync_sub_and_fetch(&ref_, 1))
       delete this;
   }
   virtual FileStream* dup(int fd) {
@@ -37,6 +37,12 @@ class ProxyStream : public FileStream {
   virtual int write(const char* buf, size_t count, size_t* nwrote) {
     return orig_->write(buf, count, nwrote);
   }
+  virtual int readv(const iovec* iov, int iovcnt, size_t* nread) {
+    return orig_->readv(iov, iovcnt, nread);
+  }
+  virtual int writev(const iovec* iov, int iovcnt, size_t* nwrote) {
+    return orig_->writev(iov, iovcnt, nwrote);
+  }
 
   virtual int seek(nacl_abi_off_t offset, int whence,
                    nacl_abi_off_t* new_offset) {
@@ -61,6 +67,14 @@ class ProxyStream : public FileStream {
   virtual int ioctl(int request, va_list ap) {
     return orig_->ioctl(request, ap);
   }
+  virtual int setsockopt(int level, int optname,
+                         const void* optval, socklen_t optlen) {
+    return orig_->setsockopt(level, optname, optval, optlen);
+  }
+  virtual int getsockopt(int level, int optname,
+                         void* optval, socklen_t* optlen) {
+    return orig_->getsockopt(level, optname, optval, optlen);
+  }
 
   virtual bool is_read_ready() {
     return orig_->is_read_ready();
@@ -72,6 +86,13 @@ class ProxyStream : public FileStream {
     return orig_->is_exception();
   }
 
+  virtual WaitQueue& wait_queue() {
+    return orig_->wait_queue();
+  }
+  virtual Mutex& mutex() {
+    return orig_->mutex();
+  }
+
  private:
   int ref_;
   int fd_;
@@ -6,9 +6,13 @@
 #define PTHREAD_HELPERS_H
 
 #include <assert.h>
+#include <errno.h>
 #include <stdint.h>
 #include <pthread.h>
 
+#include <algorithm>
+#include <vector>
+
 // A macro to disallow the evil copy constructor and operator= functions
 // This should be used in the private: declarations for a class
 #define DISALLOW_COPY_AND_ASSIGN(TypeName)      \
@@ -117,6 +121,58 @@ class Cond {
   DISALLOW_COPY_AND_ASSIGN(Cond);
 };
 
+class WaitQueue;
+
+// Something blocked on several WaitQueues at once, e.g. select().
+class Waiter {
+ public:
+  virtual ~Waiter() {}
+
+  // Called whenever |queue| is woken, with the mutex guarding it held.
+  virtual void Wake(WaitQueue* queue) = 0;
+};
+
+// The threads blocked on the state of a single object.  Threads that only care
+// about this object wait on it directly, while Waiters registered with it are
+// notified as well.  A state change thus only wakes up the threads interested
+// in that object rather than every blocked thread.
+class WaitQueue {
+ public:
+  WaitQueue() {}
+
+  int wait(Mutex& mutex) {  // NOLINT(runtime/references)
+    return cond_.wait(mutex);
+  }
+
+  int timedwait(Mutex& mutex,  // NOLINT(runtime/references)
+                const timespec* abstime) {
+    return cond_.timedwait(mutex, abstime);
+  }
+
+  void broadcast() {
+    cond_.broadcast();
+    for (size_t i = 0; i < waiters_.size(); i++)
+      waiters_[i]->Wake(this);
+  }
+
+  // A Waiter may be added more than once; each add needs a matching remove.
+  void AddWaiter(Waiter* waiter) {
+    waiters_.push_back(waiter);
+  }
+
+  void RemoveWaiter(Waiter* waiter) {
+    std::vector<Waiter*>::iterator it =
+        std::find(waiters_.begin(), waiters_.end(), waiter);
+    assert(it != waiters_.end());
+    waiters_.erase(it);
+  }
+
+ private:
+  Cond cond_;
+  std::vector<Waiter*> waiters_;
+  DISALLOW_COPY_AND_ASSIGN(WaitQueue);
+};
+
 #ifndef NDEBUG
 #define LOG(format, args...) \
   debug_log(format , ## args)
@@ -0,0 +1,131 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ring_buffer.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+const size_t kMinCapacity = 256;
+}  // namespace
+
+const size_t RingBuffer::npos;
+const size_t RingBuffer::kUnlimited;
+
+RingBuffer::RingBuffer(size_t max_size)
+    : buf_(NULL), mask_(0), begin_(0), end_(0), max_size_(max_size) {
+}
+
+RingBuffer::~RingBuffer() {
+  free(buf_);
+}
+
+size_t RingBuffer::space() const {
+  if (max_size_ == kUnlimited)
+    return npos - size();
+  return max_size_ > size() ? max_size_ - size() : 0;
+}
+
+void RingBuffer::Reserve(size_t count) {
+  size_t needed = size() + count;
+  if (buf_ && needed <= capacity())
+    return;
+
+  size_t new_capacity = buf_ ? capacity() : kMinCapacity;
+  while (new_capacity < needed)
+    new_capacity *= 2;
+
+  char* new_buf = static_cast<char*>(malloc(new_capacity));
+  assert(new_buf);
+  size_t old_size = size();
+  if (buf_) {
+    Peek(new_buf, old_size);
+    free(buf_);
+  }
+  buf_ = new_buf;
+  mask_ = new_capacity - 1;
+  begin_ = 0;
+  end_ = old_size;
+}
+
+size_t RingBuffer::Write(const char* buf, size_t count) {
+  count = std::min(count, space());
+  if (!count)
+    return 0;
+
+  Reserve(count);
+  size_t pos = end_ & mask_;
+  size_t first = std::min(count, capacity() - pos);
+  memcpy(buf_ + pos, buf, first);
+  memcpy(buf_, buf + first, count - first);
+  end_ += count;
+  return count;
+}
+
+size_t RingBuffer::Peek(char* buf, size_t count) const {
+  count = std::min(count, size());
+  if (!count)
+    return 0;
+
+  size_t pos = begin_ & mask_;
+  size_t first = std::min(count, capacity() - pos);
+  memcpy(buf, buf_ + pos, first);
+  memcpy(buf + first, buf_, count - first);
+  return count;
+}
+
+size_t RingBuffer::Read(char* buf, size_t count) {
+  count = Peek(buf, count);
+  Consume(count);
+  return count;
+}
+
+const char* RingBuffer::ReadSpan(size_t* count) const {
+  if (empty()) {
+    *count = 0;
+    return buf_;
+  }
+  size_t pos = begin_ & mask_;
+  *count = std::min(size(), capacity() - pos);
+  return buf_ + pos;
+}
+
+void RingBuffer::Consume(size_t count) {
+  assert(count <= size());
+  begin_ += count;
+}
+
+char* RingBuffer::WriteSpan(size_t min_count, size_t* count) {
+  min_count = std::min(min_count, space());
+  Reserve(min_count);
+  size_t pos = end_ & mask_;
+  size_t free_count = capacity() - size();
+  if (capacity() - pos < min_count && begin_ != end_) {
+    // The free space wraps around; compact the data to the front so that it
+    // is contiguous.
+    char* new_buf = static_cast<char*>(malloc(capacity()));
+    assert(new_buf);
+    size_t old_size = Peek(new_buf, size());
+    free(buf_);
+    buf_ = new_buf;
+    begin_ = 0;
+    end_ = old_size;
+    pos = end_;
+  } else if (begin_ == end_) {
+    // Start over at the beginning of the buffer so that the span is as long
+    // as possible.
+    begin_ = end_ = pos = 0;
+  }
+  *count = std::min(std::min(free_count, capacity() - pos), space());
+  return buf_ + pos;
+}
+
+void RingBuffer::Commit(size_t count) {
+  assert(count <= capacity() - size());
+  end_ += count;
+}
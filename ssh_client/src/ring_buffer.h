@@ -0,0 +1,78 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stddef.h>
+
+#include "pthread_helpers.h"
+
+// A byte queue stored in a power-of-two sized circular buffer.
+//
+// Data is copied in and out with memcpy in at most two pieces.  Consumers that
+// can work on the buffer in place use ReadSpan()/Consume() and
+// WriteSpan()/Commit() to avoid a copy altogether.  The buffer grows by
+// doubling when a write doesn't fit, up to an optional size limit after which
+// writes are cut short.
+class RingBuffer {
+ public:
+  static const size_t npos = static_cast<size_t>(-1);
+  static const size_t kUnlimited = 0;
+
+  // |max_size| limits how many bytes can be queued, kUnlimited for no limit.
+  explicit RingBuffer(size_t max_size = kUnlimited);
+  ~RingBuffer();
+
+  size_t size() const { return end_ - begin_; }
+  bool empty() const { return begin_ == end_; }
+  size_t capacity() const { return mask_ + 1; }
+
+  size_t max_size() const { return max_size_; }
+  void set_max_size(size_t max_size) { max_size_ = max_size; }
+
+  // Number of bytes that can still be written before hitting the size limit.
+  size_t space() const;
+
+  // Append up to |count| bytes of |buf|.  Returns the number of bytes written,
+  // which is less than |count| only if the size limit was reached.
+  size_t Write(const char* buf, size_t count);
+
+  // Copy up to |count| bytes to |buf| and remove them from the queue.
+  size_t Read(char* buf, size_t count);
+
+  // Copy up to |count| bytes to |buf| without removing them.
+  size_t Peek(char* buf, size_t count) const;
+
+  // Return the longest contiguous run of queued bytes at the front, and its
+  // length in |*count|.  Consume() removes bytes once they have been used.
+  const char* ReadSpan(size_t* count) const;
+  void Consume(size_t count);
+
+  // Return a contiguous run of free space at the back of at least |min_count|
+  // bytes if the size limit allows, and its length in |*count|.  The space is
+  // only queued once Commit() is called.  Any other write invalidates the span.
+  char* WriteSpan(size_t min_count, size_t* count);
+  void Commit(size_t count);
+
+  void Clear() { begin_ = end_ = 0; }
+
+  // Make room for at least |count| more bytes.  Writes that fit in the room
+  // reserved never move the queued data, so a span passed to an asynchronous
+  // call stays valid as long as the buffer doesn't grow.
+  void Reserve(size_t count);
+
+ private:
+  char* buf_;
+  size_t mask_;
+  // Positions of the first and one past the last queued byte.  They only ever
+  // increase and are reduced modulo the capacity on access.
+  size_t begin_;
+  size_t end_;
+  size_t max_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(RingBuffer);
+};
+
+#endif  // RING_BUFFER_H
@@ -4,6 +4,9 @@
 
 #include "ssh_plugin.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 #include <stdio.h>
 #include <string.h>
 #include <resolv.h>
@@ -11,11 +14,16 @@
 #include "ppapi/cpp/module.h"
 #include "ppapi/cpp/var_array_buffer.h"
 
+#include "base64.h"
 #include "file_system.h"
 
 const char kMessageNameAttr[] = "name";
 const char kMessageArgumentsAttr[] = "arguments";
 
+// Both directions may wrap several calls into a single message with this name
+// whose arguments are [name, arguments] pairs.
+const char kBatchMethodId[] = "batch";
+
 // These are C++ the method names as JavaScript sees them.
 const char kStartSessionMethodId[] = "startSession";
 const char kOnOpenFileMethodId[] = "onOpenFile";
@@ -28,6 +36,37 @@ const char kOnResizeMethodId[] = "onResize";
 const char kOnExitAcknowledgeMethodId[] = "onExitAcknowledge";
 const char kOnReadPassMethodId[] = "onReadPass";
 
+enum MethodId {
+  kUnknownMethod,
+  kBatchMethod,
+  kStartSessionMethod,
+  kOnOpenMethod,
+  kOnReadMethod,
+  kOnWriteAcknowledgeMethod,
+  kOnCloseMethod,
+  kOnReadReadyMethod,
+  kOnResizeMethod,
+  kOnExitAcknowledgeMethod,
+  kOnReadPassMethod,
+};
+
+const struct {
+  const char* name;
+  MethodId id;
+} kMethods[] = {
+  { kBatchMethodId, kBatchMethod },
+  { kStartSessionMethodId, kStartSessionMethod },
+  { kOnOpenFileMethodId, kOnOpenMethod },
+  { kOnOpenSocketMethodId, kOnOpenMethod },
+  { kOnReadMethodId, kOnReadMethod },
+  { kOnWriteAcknowledgeMethodId, kOnWriteAcknowledgeMethod },
+  { kOnCloseMethodId, kOnCloseMethod },
+  { kOnReadReadyMethodId, kOnReadReadyMethod },
+  { kOnResizeMethodId, kOnResizeMethod },
+  { kOnExitAcknowledgeMethodId, kOnExitAcknowledgeMethod },
+  { kOnReadPassMethodId, kOnReadPassMethod },
+};
+
 // Known startSession attributes.
 const char kUsernameAttr[] = "username";
 const char kHostAttr[] = "host";
@@ -38,6 +77,7 @@ const char kUseJsSocketAttr[] = "useJsSocket";
 const char kEnvironmentAttr[] = "environment";
 const char kArgumentsAttr[] = "arguments";
 const char kWriteWindowAttr[] = "writeWindow";
+const char kWriteWindowAutoAttr[] = "writeWindowAuto";
 const char kAuthAgentAppID[] = "authAgentAppID";
 const char kSubsystemAttr[] = "subsystem";
 
@@ -50,11 +90,35 @@ const char kWriteMethodId[] = "write";
 const char kReadMethodId[] = "read";
 const char kCloseMethodId[] = "close";
 const char kreadPassMethodId[] = "readPass";
+const char kWriteStatsMethodId[] = "writeStats";
+const char kSetCapabilitiesMethodId[] = "setCapabilities";
+
+// Capabilities the plugin tells JavaScript about.
+const char kArrayBufferInputCapability[] = "arrayBufferInput";
 
 const size_t kDefaultWriteWindow = 64 * 1024;
+// Largest ArrayBuffer sent to JavaScript in a single write message.
+const size_t kMaxWriteSize = 32 * 1024;
 
 extern "C" int ssh_main(int ac, const char** av, const char *subsystem);
 
+namespace {
+
+MethodId GetMethodId(const std::string& function) {
+  typedef std::unordered_map<std::string, MethodId> MethodMap;
+  // Only used on the main thread.
+  static MethodMap* methods = NULL;
+  if (!methods) {
+    methods = new MethodMap();
+    for (size_t i = 0; i < sizeof(kMethods) / sizeof(kMethods[0]); i++)
+      (*methods)[kMethods[i].name] = kMethods[i].id;
+  }
+  MethodMap::const_iterator it = methods->find(function);
+  return it != methods->end() ? it->second : kUnknownMethod;
+}
+
+}  // namespace
+
 //------------------------------------------------------------------------------
 
 SshPluginInstance* SshPluginInstance::instance_ = NULL;
@@ -63,7 +127,11 @@ SshPluginInstance::SshPluginInstance(PP_Instance instance)
     : pp::Instance(instance),
       core_(pp::Module::Get()->core()),
       openssh_thread_(NULL),
+      write_window_(kDefaultWriteWindow),
+      write_window_adaptive_(false),
       factory_(this),
+      flush_posted_(false),
+      write_buf_fd_(-1),
       file_system_(this, this) {
   instance_ = this;
 }
@@ -90,35 +158,99 @@ void SshPluginInstance::HandleMessage(const pp::Var& message_data) {
 
 void SshPluginInstance::Invoke(const std::string& function,
                                const pp::VarArray& args) {
-  if (function == kStartSessionMethodId) {
-    StartSession(args);
-  } else if (function == kOnOpenFileMethodId ||
-             function == kOnOpenSocketMethodId) {
-    OnOpen(args);
-  } else if (function == kOnReadMethodId) {
-    OnRead(args);
-  } else if (function == kOnWriteAcknowledgeMethodId) {
-    OnWriteAcknowledge(args);
-  } else if (function == kOnCloseMethodId) {
-    OnClose(args);
-  } else if (function == kOnReadReadyMethodId) {
-    OnReadReady(args);
-  } else if (function == kOnResizeMethodId) {
-    OnResize(args);
-  } else if (function == kOnExitAcknowledgeMethodId) {
-    OnExitAcknowledge(args);
-  } else if (function == kOnReadPassMethodId) {
-    OnReadPass(args);
-  } else {
-    PrintLogImpl(0, function + ": Unknown function");
+  switch (GetMethodId(function)) {
+    case kBatchMethod:
+      InvokeBatch(args);
+      break;
+    case kStartSessionMethod:
+      StartSession(args);
+      break;
+    case kOnOpenMethod:
+      OnOpen(args);
+      break;
+    case kOnReadMethod:
+      OnRead(args);
+      break;
+    case kOnWriteAcknowledgeMethod:
+      OnWriteAcknowledge(args);
+      break;
+    case kOnCloseMethod:
+      OnClose(args);
+      break;
+    case kOnReadReadyMethod:
+      OnReadReady(args);
+      break;
+    case kOnResizeMethod:
+      OnResize(args);
+      break;
+    case kOnExitAcknowledgeMethod:
+      OnExitAcknowledge(args);
+      break;
+    case kOnReadPassMethod:
+      OnReadPass(args);
+      break;
+    case kUnknownMethod:
+      PrintLogImpl(0, function + ": Unknown function");
+      break;
+  }
+}
+
+void SshPluginInstance::InvokeBatch(const pp::VarArray& calls) {
+  for (uint32_t i = 0; i < calls.GetLength(); i++) {
+    const pp::Var call_var = calls.Get(i);
+    if (!call_var.is_array()) {
+      PrintLogImpl(0, "batch: call is not an array\n");
+      continue;
+    }
+
+    const pp::VarArray call(call_var);
+    const pp::Var function_var = call.Get(0);
+    const pp::Var args_var = call.Get(1);
+    if (!function_var.is_string() || !args_var.is_array()) {
+      PrintLogImpl(0, "batch: invalid call\n");
+      continue;
+    }
+
+    const std::string function = function_var.AsString();
+    // Batches don't nest.
+    if (function != kBatchMethodId)
+      Invoke(function, pp::VarArray(args_var));
   }
 }
 
 void SshPluginInstance::InvokeJS(const std::string& function,
                                  const pp::VarArray& args) {
+  // The queue isn't locked, so only the main thread may add to it.
+  assert(core_->IsMainThread());
+  pp::VarArray call;
+  call.SetLength(2);
+  call.Set(0, pp::Var(function));
+  call.Set(1, args);
+  pending_calls_.Set(pending_calls_.GetLength(), call);
+
+  if (!flush_posted_) {
+    flush_posted_ = true;
+    core_->CallOnMainThread(0, factory_.NewCallback(
+        &SshPluginInstance::FlushJS));
+  }
+}
+
+void SshPluginInstance::FlushJS(int32_t result) {
+  flush_posted_ = false;
+  uint32_t count = pending_calls_.GetLength();
+  if (!count)
+    return;
+
   pp::VarDictionary dict;
-  dict.Set(kMessageNameAttr, pp::Var(function));
-  dict.Set(kMessageArgumentsAttr, args);
+  if (count == 1) {
+    const pp::VarArray call(pending_calls_.Get(0));
+    dict.Set(kMessageNameAttr, call.Get(0));
+    dict.Set(kMessageArgumentsAttr, call.Get(1));
+  } else {
+    dict.Set(kMessageNameAttr, pp::Var(kBatchMethodId));
+    dict.Set(kMessageArgumentsAttr, pending_calls_);
+  }
+  pending_calls_ = pp::VarArray();
   PostMessage(dict);
 }
 
@@ -176,27 +308,39 @@ bool SshPluginInstance::OpenSocket(int fd, const char* host, uint16_t port,
 }
 
 bool SshPluginInstance::Write(int fd, const char* data, size_t size) {
-  const size_t kMaxWriteSize = 32 * 1024;
-  pp::VarArray call_args;
-  size_t start = 0;
-
-  call_args.SetLength(2);
-  call_args.Set(0, fd);
+  while (size) {
+    size_t chunk_size = size;
+    char* buf = BeginWrite(fd, &chunk_size);
+    memcpy(buf, data, chunk_size);
+    if (!EndWrite(fd))
+      return false;
+    data += chunk_size;
+    size -= chunk_size;
+  }
+  return true;
+}
 
-  while (start < size) {
-    size_t chunk_size = ((size - start) <= kMaxWriteSize) ? (size - start)
-                                                          : kMaxWriteSize;
+char* SshPluginInstance::BeginWrite(int fd, size_t* size) {
+  assert(write_buf_fd_ == -1);
+  *size = std::min(*size, kMaxWriteSize);
+  write_buf_ = pp::VarArrayBuffer(*size);
+  write_buf_fd_ = fd;
+  return static_cast<char*>(write_buf_.Map());
+}
 
-    pp::VarArrayBuffer arr(chunk_size);
-    char* buf = static_cast<char*>(arr.Map());
-    memcpy(buf, data + start, chunk_size);
-    arr.Unmap();
+bool SshPluginInstance::EndWrite(int fd) {
+  assert(write_buf_fd_ == fd);
+  write_buf_.Unmap();
 
-    call_args.Set(1, arr);
+  pp::VarArray call_args;
+  call_args.SetLength(2);
+  call_args.Set(0, fd);
+  call_args.Set(1, write_buf_);
+  InvokeJS(kWriteMethodId, call_args);
 
-    start += chunk_size;
-    InvokeJS(kWriteMethodId, call_args);
-  }
+  // Drop our reference so the buffer belongs to JavaScript alone.
+  write_buf_ = pp::VarArrayBuffer();
+  write_buf_fd_ = -1;
   return true;
 }
 
@@ -217,7 +361,8 @@ bool SshPluginInstance::Close(int fd) {
   return true;
 }
 
-void SshPluginInstance::ReadPass(const char* prompt, size_t size, bool echo) {
+void SshPluginInstance::ReadPassImpl(int32_t result, const std::string& prompt,
+                                     size_t size, bool echo) {
   pp::VarArray call_args;
   call_args.SetLength(3);
   call_args.Set(0, prompt);
@@ -226,13 +371,29 @@ void SshPluginInstance::ReadPass(const char* prompt, size_t size, bool echo) {
   InvokeJS(kreadPassMethodId, call_args);
 }
 
+void SshPluginInstance::ReadPass(const char* prompt, size_t size, bool echo) {
+  core_->CallOnMainThread(0, factory_.NewCallback(
+      &SshPluginInstance::ReadPassImpl, std::string(prompt), size, echo));
+}
+
 size_t SshPluginInstance::GetWriteWindow() {
-  if (session_args_.HasKey(kWriteWindowAttr)) {
-    const pp::Var arg = session_args_.Get(kWriteWindowAttr);
-    if (arg.is_number())
-      return arg.AsInt();
-  }
-  return kDefaultWriteWindow;
+  return write_window_;
+}
+
+bool SshPluginInstance::IsWriteWindowAdaptive() {
+  return write_window_adaptive_;
+}
+
+void SshPluginInstance::SendWriteStats(int fd, size_t window,
+                                       int64_t ack_rtt_us,
+                                       uint64_t drain_rate) {
+  pp::VarArray call_args;
+  call_args.SetLength(4);
+  call_args.Set(0, fd);
+  call_args.Set(1, (double)window);
+  call_args.Set(2, (double)ack_rtt_us);
+  call_args.Set(3, (double)drain_rate);
+  InvokeJS(kWriteStatsMethodId, call_args);
 }
 
 void SshPluginInstance::SessionThreadImpl() {
@@ -313,6 +474,14 @@ void SshPluginInstance::StartSession(const pp::VarArray& args) {
 
   session_args_ = pp::VarDictionary(session_arg);
 
+  // Ask for input as ArrayBuffers, those are passed on without any decoding.
+  pp::VarDictionary capabilities;
+  capabilities.Set(kArrayBufferInputCapability, true);
+  pp::VarArray call_args;
+  call_args.SetLength(1);
+  call_args.Set(0, capabilities);
+  InvokeJS(kSetCapabilitiesMethodId, call_args);
+
   if (session_args_.HasKey(kTerminalWidthAttr) &&
       session_args_.Get(kTerminalWidthAttr).is_number() &&
       session_args_.HasKey(kTerminalHeightAttr) &&
@@ -321,6 +490,17 @@ void SshPluginInstance::StartSession(const pp::VarArray& args) {
         session_args_.Get(kTerminalWidthAttr).AsInt(),
         session_args_.Get(kTerminalHeightAttr).AsInt());
   }
+  // The session thread reads these without locking, so they have to be set
+  // before it starts.
+  if (session_args_.HasKey(kWriteWindowAttr) &&
+      session_args_.Get(kWriteWindowAttr).is_number() &&
+      session_args_.Get(kWriteWindowAttr).AsInt() > 0) {
+    write_window_ = session_args_.Get(kWriteWindowAttr).AsInt();
+  }
+  if (session_args_.HasKey(kWriteWindowAutoAttr) &&
+      session_args_.Get(kWriteWindowAutoAttr).is_bool()) {
+    write_window_adaptive_ = session_args_.Get(kWriteWindowAutoAttr).AsBool();
+  }
   if (session_args_.HasKey(kUseJsSocketAttr) &&
       session_args_.Get(kUseJsSocketAttr).is_bool()) {
     file_system_.UseJsSocket(session_args_.Get(kUseJsSocketAttr).AsBool());
@@ -380,25 +560,30 @@ void SshPluginInstance::OnRead(const pp::VarArray& args) {
     return;
   }
 
-  if (data.is_string()) {
-    const std::string& str = data.AsString();
-    std::vector<char> buf(str.size() * 3 / 4);
-    int res = b64_pton(str.c_str(), (unsigned char*)&buf[0], buf.size());
-    assert(res >= 0);
-    it->second->OnRead(&buf[0], res);
-  } else if (data.is_array()) {
-    const pp::VarArray arr(data);
-    std::vector<char> buf(arr.GetLength());
-    for (size_t i = 0; i < buf.size(); ++i)
-      buf[i] = arr.Get(i).AsInt();
-    it->second->OnRead(&buf[0], buf.size());
-  } else if (data.is_array_buffer()) {
+  if (data.is_array_buffer()) {
     pp::VarArrayBuffer arr(data);
     const char* buf = static_cast<char*>(arr.Map());
     it->second->OnRead(buf, arr.ByteLength());
     arr.Unmap();
+  } else if (data.is_string()) {
+    // Base64 from streams sent before the capabilities arrived, or from
+    // older callers.  It goes straight into the stream's buffer.
+    const std::string str = data.AsString();
+    if (!it->second->OnReadBase64(str.data(), str.size())) {
+      // Might be wrapped in whitespace, which only b64_pton() skips.  The
+      // buffer is kept around so this doesn't allocate every time.
+      read_buf_.resize(Base64DecodedSize(str.size()));
+      int res = b64_pton(str.c_str(), (unsigned char*)&read_buf_[0],
+                         read_buf_.size());
+      if (res < 0) {
+        PrintLogImpl(0, "onRead: invalid base64 data\n");
+        return;
+      }
+      it->second->OnRead(&read_buf_[0], res);
+    }
   } else {
-    PrintLogImpl(0, "onRead: invalid data argument (not string or array)\n");
+    PrintLogImpl(0, "onRead: invalid data argument "
+                    "(not string or ArrayBuffer)\n");
   }
 }
 
@@ -7,11 +7,13 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "ppapi/cpp/completion_callback.h"
 #include "ppapi/cpp/instance.h"
 #include "ppapi/cpp/var.h"
 #include "ppapi/cpp/var_array.h"
+#include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 
 #include "pthread_helpers.h"
@@ -35,10 +37,15 @@ class SshPluginInstance : public pp::Instance,
   virtual bool OpenSocket(int fd, const char* host, uint16_t port,
                           InputInterface* stream);
   virtual bool Write(int fd, const char* data, size_t size);
+  virtual char* BeginWrite(int fd, size_t* size);
+  virtual bool EndWrite(int fd);
   virtual bool Read(int fd, size_t size);
   virtual bool Close(int fd);
   virtual void ReadPass(const char* prompt, size_t size, bool echo);
   virtual size_t GetWriteWindow();
+  virtual bool IsWriteWindowAdaptive();
+  virtual void SendWriteStats(int fd, size_t window, int64_t ack_rtt_us,
+                              uint64_t drain_rate);
   virtual void SendExitCode(int error);
 
  private:
@@ -58,20 +65,38 @@ class SshPluginInstance : public pp::Instance,
   static void* SessionThread(void* arg);
 
   void Invoke(const std::string& function, const pp::VarArray& args);
+  void InvokeBatch(const pp::VarArray& calls);
+  // Queue a call to JavaScript.  Calls queued while handling one event are
+  // sent together by FlushJS() in a single message.
   void InvokeJS(const std::string& function, const pp::VarArray& args);
+  void FlushJS(int32_t result);
 
   void PrintLog(const std::string& msg);
   void PrintLogImpl(int32_t result, const std::string& msg);
 
   void SendExitCodeImpl(int32_t result, int error);
 
+  void ReadPassImpl(int32_t result, const std::string& prompt, size_t size,
+                    bool echo);
+
   static SshPluginInstance* instance_;
 
   pp::Core* core_;
   pthread_t openssh_thread_;
   pp::VarDictionary session_args_;
+  // Cached from |session_args_| when the session starts.
+  size_t write_window_;
+  bool write_window_adaptive_;
   pp::CompletionCallbackFactory<SshPluginInstance> factory_;
   InputStreams streams_;
+  // Scratch space for base64 input that OnReadBase64() can't take.
+  std::vector<char> read_buf_;
+  // Calls to JavaScript waiting for FlushJS(), as [name, arguments] pairs.
+  pp::VarArray pending_calls_;
+  bool flush_posted_;
+  // The buffer lent out by BeginWrite() and the descriptor it's for, or -1.
+  pp::VarArrayBuffer write_buf_;
+  int write_buf_fd_;
   FileSystem file_system_;
 
   DISALLOW_COPY_AND_ASSIGN(SshPluginInstance);
@@ -4,9 +4,11 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <netdb.h>
+#include <poll.h>
 #include <pthread.h>
 #include <pwd.h>
 #include <readpassphrase.h>
+#include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -14,6 +16,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 
 #include "nacl-mounts/base/irt_syscalls.h"
@@ -181,6 +184,66 @@ ssize_t write(int fd, const void* buf, size_t count) {
   return ret;
 }
 
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("fd=%i, iov=%p, iovcnt=%i", fd, iov, iovcnt);
+  ssize_t rv;
+  ssize_t ret = HANDLE_ERRNO(
+      FileSystem::GetFileSystem()->readv(fd, iov, iovcnt, (size_t*)&rv), rv);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("fd=%i, iov=%p, iovcnt=%i", fd, iov, iovcnt);
+  ssize_t rv;
+  ssize_t ret = HANDLE_ERRNO(
+      FileSystem::GetFileSystem()->writev(fd, iov, iovcnt, (size_t*)&rv), rv);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("fd=%i, buf=%p, count=%zu, offset=%lli", fd, buf, count,
+       (long long)offset);
+  ssize_t rv;
+  ssize_t ret = HANDLE_ERRNO(
+      FileSystem::GetFileSystem()->pread(fd, (char*)buf, count, offset,
+                                         (size_t*)&rv), rv);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("fd=%i, buf=%p, count=%zu, offset=%lli", fd, buf, count,
+       (long long)offset);
+  ssize_t rv;
+  ssize_t ret = HANDLE_ERRNO(
+      FileSystem::GetFileSystem()->pwrite(fd, (const char*)buf, count, offset,
+                                          (size_t*)&rv), rv);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+int fsync(int fd) {
+  LOG_SYSCALL_ENTER();
+  LOG("fd=%i", fd);
+  int ret = HANDLE_ERRNO(FileSystem::GetFileSystem()->fsync(fd), 0);
+  LOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+int ftruncate(int fd, off_t length) {
+  LOG_SYSCALL_ENTER();
+  LOG("fd=%i, length=%lli", fd, (long long)length);
+  int ret = HANDLE_ERRNO(FileSystem::GetFileSystem()->ftruncate(fd, length), 0);
+  LOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
 static int WRAP(seek)(int fd, nacl_abi_off_t offset, int whence,
                nacl_abi_off_t* new_offset) {
   LOG("SYSCALL: seek: fd=%d offset=%d whence=%d\n", fd, (int)offset, whence);
@@ -217,6 +280,14 @@ int dup2(int oldfd, int newfd) {
   return ret;
 }
 
+int pipe(int pipefd[2]) {
+  LOG_SYSCALL_ENTER();
+  LOG("pipefd=%p", pipefd);
+  int ret = HANDLE_ERRNO(FileSystem::GetFileSystem()->pipe(pipefd), 0);
+  LOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
 static int WRAP(stat)(const char* pathname, struct nacl_abi_stat* buf) {
   return FileSystem::GetFileSystem()->stat(pathname, buf);
 }
@@ -309,6 +380,34 @@ int select(int nfds, fd_set* readfds, fd_set* writefds,
   return ret;
 }
 
+int poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("fds=%p, nfds=%u, timeout=%d", fds, (unsigned)nfds, timeout);
+  timespec ts;
+  if (timeout >= 0) {
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+  }
+  int ret = FileSystem::GetFileSystem()->poll(
+      fds, nfds, timeout >= 0 ? &ts : NULL);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+// We don't have real signals, so the signal mask is ignored.
+int ppoll(struct pollfd* fds, nfds_t nfds, const struct timespec* timeout,
+          const sigset_t* sigmask) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("fds=%p, nfds=%u, timeout=%p({tv_sec=%" PRIu64 ", tv_nsec=%" PRIu64
+       "}), sigmask=%p",
+       fds, (unsigned)nfds, timeout,
+       timeout ? (uint64_t)timeout->tv_sec : 0,
+       timeout ? (uint64_t)timeout->tv_nsec : 0, sigmask);
+  int ret = FileSystem::GetFileSystem()->poll(fds, nfds, timeout);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
 //------------------------------------------------------------------------------
 
 // Wrap exit and _exit so JavaScript gets our exit code. We don't wrap
@@ -481,17 +580,18 @@ int listen(int sockfd, int backlog) {
 
 int setsockopt(int socket, int level, int option_name,
                const void* option_value, socklen_t option_len) {
-  LOG_SYSCALL_STUB(0, "socket=%i, level=%i, optname=%i, optval=%p, optlen=%i",
-                   socket, level, option_name, option_value, option_len);
-  return 0;
+  LOG("SYSCALL: setsockopt(socket=%i, level=%i, optname=%i, optlen=%i)\n",
+      socket, level, option_name, option_len);
+  return FileSystem::GetFileSystem()->setsockopt(
+      socket, level, option_name, option_value, option_len);
 }
 
 int getsockopt(int socket, int level, int option_name,
                void* option_value, socklen_t* option_len) {
-  LOG_SYSCALL_STUB(0, "socket=%i, level=%i, optname=%i, optval=%p, optlen=%p",
-                   socket, level, option_name, option_value, option_len);
-  memset(option_value, 0, *option_len);
-  return 0;
+  LOG("SYSCALL: getsockopt(socket=%i, level=%i, optname=%i)\n",
+      socket, level, option_name);
+  return FileSystem::GetFileSystem()->getsockopt(
+      socket, level, option_name, option_value, option_len);
 }
 
 int shutdown(int s, int how) {
@@ -602,11 +702,52 @@ ssize_t recvfrom(int socket, void* buffer, size_t len, int flags,
   return ret;
 }
 
+ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("sockfd=%i, msg=%p, flags=%i", sockfd, msg, flags);
+  ssize_t ret = FileSystem::GetFileSystem()->sendmsg(sockfd, msg, flags);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("sockfd=%i, msg=%p, flags=%i", sockfd, msg, flags);
+  ssize_t ret = FileSystem::GetFileSystem()->recvmsg(sockfd, msg, flags);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+             int flags) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("sockfd=%i, msgvec=%p, vlen=%u, flags=%i", sockfd, msgvec, vlen, flags);
+  int ret = FileSystem::GetFileSystem()->sendmmsg(sockfd, msgvec, vlen, flags);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
+// Unlike Linux, |timeout| bounds the wait for the first datagram; the rest
+// are only taken if already received.
+int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+             int flags, struct timespec* timeout) {
+  VLOG_SYSCALL_ENTER();
+  VLOG("sockfd=%i, msgvec=%p, vlen=%u, flags=%i, timeout=%p",
+       sockfd, msgvec, vlen, flags, timeout);
+  int ret = FileSystem::GetFileSystem()->recvmmsg(
+      sockfd, msgvec, vlen, flags, timeout);
+  VLOG_SYSCALL_EXIT(ret);
+  return ret;
+}
+
 int socketpair(int domain, int type, int protocol, int socket_vector[2]) {
-  LOG_SYSCALL_STUB(-1, "domain=%i, type=%i, protocol=%i, sv=%p",
-                   domain, type, protocol, socket_vector);
-  errno = EACCES;
-  return -1;
+  LOG_SYSCALL_ENTER();
+  LOG("domain=%i, type=%i, protocol=%i, sv=%p",
+      domain, type, protocol, socket_vector);
+  int ret = HANDLE_ERRNO(FileSystem::GetFileSystem()->socketpair(
+      domain, type, protocol, socket_vector), 0);
+  LOG_SYSCALL_EXIT(ret);
+  return ret;
 }
 
 int clock_gettime(clockid_t clk_id, struct timespec* tp) {
@@ -27,11 +27,11 @@ TCPServerSocket::~TCPServerSocket() {
 }
 
 void TCPServerSocket::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void TCPServerSocket::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -52,9 +52,8 @@ void TCPServerSocket::close() {
     int32_t result = PP_OK_COMPLETIONPENDING;
     pp::Module::Get()->core()->CallOnMainThread(0,
         factory_.NewCallback(&TCPServerSocket::Close, &result));
-    FileSystem* sys = FileSystem::GetFileSystem();
     while (result == PP_OK_COMPLETIONPENDING)
-      sys->cond().wait(sys->mutex());
+      wait_queue().wait(mutex());
   }
 }
 
@@ -85,9 +84,8 @@ bool TCPServerSocket::listen(int backlog) {
   int32_t result = PP_OK_COMPLETIONPENDING;
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&TCPServerSocket::Listen, backlog, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
   return result == PP_OK;
 }
 
@@ -106,7 +104,7 @@ PP_Resource TCPServerSocket::accept() {
 
 void TCPServerSocket::Listen(int32_t result, int backlog, int32_t* pres) {
   FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(!socket_);
   socket_ = new pp::TCPServerSocketPrivate(sys->instance());
 
@@ -122,12 +120,11 @@ void TCPServerSocket::Listen(int32_t result, int backlog, int32_t* pres) {
   }
 
   if (*pres != PP_OK_COMPLETIONPENDING)
-    sys->cond().broadcast();
+    wait_queue().broadcast();
 }
 
 void TCPServerSocket::Accept(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(socket_);
   if (result == PP_OK) {
     result = socket_->Accept(&resource_,
@@ -137,21 +134,19 @@ void TCPServerSocket::Accept(int32_t result, int32_t* pres) {
   }
   if (pres)
     *pres = result;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void TCPServerSocket::OnAccept(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(socket_);
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void TCPServerSocket::Close(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   delete socket_;
   socket_ = NULL;
   *pres = PP_OK;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
@@ -6,16 +6,29 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <string.h>
 
 #include "ppapi/c/pp_errors.h"
 #include "ppapi/cpp/module.h"
+#include "ppapi/cpp/var.h"
 
 #include "file_system.h"
 
+const size_t TCPSocket::kDefaultBufSize;
+const size_t TCPSocket::kMinReadSize;
+const size_t TCPSocket::kMaxBufSize;
+const int32_t TCPSocket::kLingerTimeoutMs;
+
 TCPSocket::TCPSocket(int fd, int oflag)
   : ref_(1), fd_(fd), oflag_(oflag), factory_(this), socket_(NULL),
-    read_buf_(kBufSize), read_sent_(false), write_sent_(false) {
+    in_buf_(kDefaultBufSize), out_buf_(kDefaultBufSize),
+    recv_buf_size_(kDefaultBufSize), send_buf_size_(kDefaultBufSize),
+    read_sent_(false), write_sent_(false), write_size_(0), no_delay_(false),
+    closing_(false) {
+  in_buf_.Reserve(kDefaultBufSize);
+  out_buf_.Reserve(kDefaultBufSize);
 }
 
 TCPSocket::~TCPSocket() {
@@ -24,11 +37,11 @@ TCPSocket::~TCPSocket() {
 }
 
 void TCPSocket::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void TCPSocket::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -40,9 +53,8 @@ bool TCPSocket::connect(const char* host, uint16_t port) {
   int32_t result = PP_OK_COMPLETIONPENDING;
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&TCPSocket::Connect, host, port, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
   return result == PP_OK;
 }
 
@@ -50,34 +62,47 @@ bool TCPSocket::accept(PP_Resource resource) {
   int32_t result = PP_OK_COMPLETIONPENDING;
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&TCPSocket::Accept, resource, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
   return result == PP_OK;
 }
 
 void TCPSocket::close() {
-  if (socket_) {
-    int32_t result = PP_OK_COMPLETIONPENDING;
-    pp::Module::Get()->core()->CallOnMainThread(0,
-        factory_.NewCallback(&TCPSocket::Close, &result));
-    FileSystem* sys = FileSystem::GetFileSystem();
-    while (result == PP_OK_COMPLETIONPENDING)
-      sys->cond().wait(sys->mutex());
-  }
+  if (!socket_ || closing_)
+    return;
+
+  // Like the kernel, queued data is still sent after close() returns.  The
+  // main thread shuts the socket down once |out_buf_| has drained, or after
+  // kLingerTimeoutMs if the peer stops reading, so close() never waits on the
+  // network.  The reference taken here keeps the buffers alive until then.
+  closing_ = true;
+  addref();
+  bool pending = write_sent_ || !out_buf_.empty();
+  pp::Module::Get()->core()->CallOnMainThread(pending ? kLingerTimeoutMs : 0,
+      factory_.NewCallback(&TCPSocket::Close));
+  PostWriteTask(true);
 }
 
 int TCPSocket::read(char* buf, size_t count, size_t* nread) {
+  iovec iov = { buf, count };
+  return readv(&iov, 1, nread);
+}
+
+int TCPSocket::write(const char* buf, size_t count, size_t* nwrote) {
+  iovec iov = { const_cast<char*>(buf), count };
+  return writev(&iov, 1, nwrote);
+}
+
+int TCPSocket::readv(const iovec* iov, int iovcnt, size_t* nread) {
   if (is_block()) {
-    FileSystem* sys = FileSystem::GetFileSystem();
     while (in_buf_.empty() && is_open())
-      sys->cond().wait(sys->mutex());
+      wait_queue().wait(mutex());
   }
 
-  *nread = std::min(count, in_buf_.size());
-  if (*nread) {
-    std::copy(in_buf_.begin(), in_buf_.begin() + *nread, buf);
-    in_buf_.erase(in_buf_.begin(), in_buf_.begin() + *nread);
+  *nread = 0;
+  for (int i = 0; i < iovcnt && !in_buf_.empty(); i++) {
+    *nread += in_buf_.Read(static_cast<char*>(iov[i].iov_base),
+                           iov[i].iov_len);
   }
 
   if (*nread == 0) {
@@ -94,29 +119,35 @@ int TCPSocket::read(char* buf, size_t count, size_t* nread) {
   return 0;
 }
 
-int TCPSocket::write(const char* buf, size_t count, size_t* nwrote) {
-  if (!is_open())
+int TCPSocket::writev(const iovec* iov, int iovcnt, size_t* nwrote) {
+  if (!is_open() || closing_)
     return EIO;
 
-  out_buf_.insert(out_buf_.end(), buf, buf + count);
-  if (is_block()) {
-    int32_t result = PP_OK_COMPLETIONPENDING;
-    PostWriteTask(&result, true);
-    FileSystem* sys = FileSystem::GetFileSystem();
-    while (result == PP_OK_COMPLETIONPENDING)
-      sys->cond().wait(sys->mutex());
-    if ((size_t)result != count) {
-      *nwrote = -1;
-      return EIO;
-    } else {
-      *nwrote = count;
-      return 0;
+  // Like with a kernel socket the data is only queued.  Blocking writes wait
+  // for room in the send buffer, non-blocking ones take what fits.  All the
+  // segments go out with the same Pepper write when they fit.
+  size_t written = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    const char* buf = static_cast<const char*>(iov[i].iov_base);
+    size_t count = iov[i].iov_len;
+    size_t done = out_buf_.Write(buf, count);
+    while (done < count && is_block() && is_open()) {
+      PostWriteTask(true);
+      wait_queue().wait(mutex());
+      done += out_buf_.Write(buf + done, count - done);
     }
-  } else {
-    PostWriteTask(NULL, true);
-    *nwrote = count;
-    return 0;
+    written += done;
+    if (done < count)
+      break;
   }
+  PostWriteTask(true);
+
+  if (written == 0) {
+    *nwrote = -1;
+    return is_open() ? EAGAIN : EIO;
+  }
+  *nwrote = written;
+  return 0;
 }
 
 int TCPSocket::fcntl(int cmd, va_list ap) {
@@ -130,12 +161,79 @@ int TCPSocket::fcntl(int cmd, va_list ap) {
   }
 }
 
+int TCPSocket::setsockopt(int level, int optname,
+                          const void* optval, socklen_t optlen) {
+  int value;
+  if (level == SOL_SOCKET && optname == SO_RCVBUF) {
+    int err = FileSystem::GetIntOption(optval, optlen, &value);
+    if (!err)
+      set_recv_buf_size(std::max(value, 0));
+    return err;
+  } else if (level == SOL_SOCKET && optname == SO_SNDBUF) {
+    int err = FileSystem::GetIntOption(optval, optlen, &value);
+    if (!err)
+      set_send_buf_size(std::max(value, 0));
+    return err;
+  } else if (level == IPPROTO_TCP && optname == TCP_NODELAY) {
+    int err = FileSystem::GetIntOption(optval, optlen, &value);
+    if (err)
+      return err;
+    if (!is_open())
+      return ENOTCONN;
+
+    int32_t result = PP_OK_COMPLETIONPENDING;
+    pp::Module::Get()->core()->CallOnMainThread(0,
+        factory_.NewCallback(&TCPSocket::SetNoDelay, value != 0, &result));
+    while (result == PP_OK_COMPLETIONPENDING)
+      wait_queue().wait(mutex());
+    if (result != PP_OK)
+      return EINVAL;
+    no_delay_ = value != 0;
+    return 0;
+  }
+  return ENOPROTOOPT;
+}
+
+int TCPSocket::getsockopt(int level, int optname,
+                          void* optval, socklen_t* optlen) {
+  if (level == SOL_SOCKET && optname == SO_RCVBUF)
+    return FileSystem::SetIntOption(recv_buf_size_, optval, optlen);
+  if (level == SOL_SOCKET && optname == SO_SNDBUF)
+    return FileSystem::SetIntOption(send_buf_size_, optval, optlen);
+  if (level == IPPROTO_TCP && optname == TCP_NODELAY)
+    return FileSystem::SetIntOption(no_delay_, optval, optlen);
+  return ENOPROTOOPT;
+}
+
 bool TCPSocket::is_read_ready() {
   return !is_open() || !in_buf_.empty();
 }
 
 bool TCPSocket::is_write_ready() {
-  return !is_open() || out_buf_.size() < kBufSize;
+  return !is_open() || out_buf_.space() > 0;
+}
+
+void TCPSocket::set_recv_buf_size(size_t size) {
+  recv_buf_size_ = std::min(std::max(size, kMinReadSize), kMaxBufSize);
+  ResizeBuffers();
+}
+
+void TCPSocket::set_send_buf_size(size_t size) {
+  send_buf_size_ = std::min(std::max(size, kMinReadSize), kMaxBufSize);
+  ResizeBuffers();
+}
+
+void TCPSocket::ResizeBuffers() {
+  // A buffer Pepper is working on can't move, so a new size only takes
+  // effect once the pending call completes.
+  if (!read_sent_ && in_buf_.max_size() != recv_buf_size_) {
+    in_buf_.set_max_size(recv_buf_size_);
+    in_buf_.Reserve(in_buf_.space());
+  }
+  if (!write_sent_ && out_buf_.max_size() != send_buf_size_) {
+    out_buf_.set_max_size(send_buf_size_);
+    out_buf_.Reserve(out_buf_.space());
+  }
 }
 
 bool TCPSocket::is_exception() {
@@ -143,7 +241,8 @@ bool TCPSocket::is_exception() {
 }
 
 void TCPSocket::PostReadTask() {
-  if (is_open() && !read_sent_ && in_buf_.size() < kBufSize / 2) {
+  if (is_open() && !closing_ && !read_sent_ &&
+      in_buf_.space() >= std::min(kMinReadSize, in_buf_.max_size())) {
     read_sent_ = true;
     if (!pp::Module::Get()->core()->IsMainThread()) {
       pp::Module::Get()->core()->CallOnMainThread(
@@ -155,15 +254,15 @@ void TCPSocket::PostReadTask() {
   }
 }
 
-void TCPSocket::PostWriteTask(int32_t* pres, bool always_post) {
+void TCPSocket::PostWriteTask(bool always_post) {
   if (is_open() && !write_sent_ && !out_buf_.empty()) {
     write_sent_ = true;
     if (always_post || !pp::Module::Get()->core()->IsMainThread()) {
       pp::Module::Get()->core()->CallOnMainThread(0,
-          factory_.NewCallback(&TCPSocket::Write, pres));
+          factory_.NewCallback(&TCPSocket::Write));
     } else {
       // If on main Pepper thread and delay is not required call it directly.
-      Write(PP_OK, pres);
+      Write(PP_OK);
     }
   }
 }
@@ -171,152 +270,163 @@ void TCPSocket::PostWriteTask(int32_t* pres, bool always_post) {
 void TCPSocket::Connect(int32_t result, const char* host, uint16_t port,
                         int32_t* pres) {
   FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(!socket_);
   socket_ = new pp::TCPSocketPrivate(sys->instance());
   *pres = socket_->Connect(host, port,
       factory_.NewCallback(&TCPSocket::OnConnect, pres));
   if (*pres != PP_OK_COMPLETIONPENDING)
-    sys->cond().broadcast();
+    wait_queue().broadcast();
 }
 
 void TCPSocket::OnConnect(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   if (result == PP_OK) {
     PostReadTask();
   } else {
-    delete socket_;
-    socket_ = NULL;
+    ResetSocket();
   }
   *pres = result;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void TCPSocket::Read(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
 
   if (!is_open()) {
     read_sent_ = false;
-    sys->cond().broadcast();
+    wait_queue().broadcast();
     return;
   }
 
-  result = socket_->Read(&read_buf_[0], read_buf_.size(),
-      factory_.NewCallback(&TCPSocket::OnRead));
+  // Only one read can be pending in Pepper, so keep it as large as the free
+  // space allows and re-arm it as soon as it completes.
+  size_t size;
+  char* buf = in_buf_.WriteSpan(kMinReadSize, &size);
+  result = socket_->Read(buf, size, factory_.NewCallback(&TCPSocket::OnRead));
   if (result != PP_OK_COMPLETIONPENDING) {
-    delete socket_;
-    socket_ = NULL;
+    ResetSocket();
     read_sent_ = false;
-    sys->cond().broadcast();
+    wait_queue().broadcast();
   }
 }
 
 void TCPSocket::OnRead(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
 
   read_sent_ = false;
   if (!is_open()) {
-    sys->cond().broadcast();
+    wait_queue().broadcast();
     return;
   }
 
   if (result > 0) {
-    in_buf_.insert(in_buf_.end(),
-                   read_buf_.begin(), read_buf_.begin() + result);
+    in_buf_.Commit(result);
+    ResizeBuffers();
     PostReadTask();
   } else {
-    delete socket_;
-    socket_ = NULL;
+    ResetSocket();
   }
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
-void TCPSocket::Write(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+void TCPSocket::Write(int32_t result) {
+  Mutex::Lock lock(mutex());
 
   if (!is_open()) {
-    if (pres)
-      *pres = PP_ERROR_FAILED;
     write_sent_ = false;
-    sys->cond().broadcast();
+    wait_queue().broadcast();
     return;
   }
 
-  if (write_buf_.size()) {
-    // Previous write operation is in progress.
-    PostWriteTask(pres, true);
-    return;
-  }
-  assert(out_buf_.size());
-  write_buf_.swap(out_buf_);
-  result = socket_->Write(&write_buf_[0], write_buf_.size(),
-      factory_.NewCallback(&TCPSocket::OnWrite, pres));
+  assert(!out_buf_.empty());
+  const char* data = out_buf_.ReadSpan(&write_size_);
+  result = socket_->Write(data, write_size_,
+      factory_.NewCallback(&TCPSocket::OnWrite));
   if (result != PP_OK_COMPLETIONPENDING) {
-    LOG("TCPSocket::Write: failed %d %d %d\n", fd_, result, write_buf_.size());
-    delete socket_;
-    socket_ = NULL;
-    if (pres)
-      *pres = result;
+    LOG("TCPSocket::Write: failed %d %d %d\n", fd_, result, write_size_);
+    ResetSocket();
     write_sent_ = false;
-    sys->cond().broadcast();
+    write_size_ = 0;
+    wait_queue().broadcast();
   }
 }
 
-void TCPSocket::OnWrite(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+void TCPSocket::OnWrite(int32_t result) {
+  Mutex::Lock lock(mutex());
 
   write_sent_ = false;
   if (!is_open()) {
-    if (pres)
-      *pres = PP_ERROR_FAILED;
-    sys->cond().broadcast();
+    write_size_ = 0;
+    wait_queue().broadcast();
     return;
   }
 
-  if (result < 0 || (size_t)result > write_buf_.size()) {
+  if (result < 0 || (size_t)result > write_size_) {
     // Write error.
     LOG("TCPSocket::OnWrite: close socket %d\n", fd_);
-    delete socket_;
-    socket_ = NULL;
-  } else if ((size_t)result < write_buf_.size()) {
-    // Partial write. Insert remaining bytes at the beginning of out_buf_.
-    out_buf_.insert(out_buf_.begin(), &write_buf_[result], &*write_buf_.end());
+    ResetSocket();
+  } else {
+    // After a partial write the rest simply stays at the front of out_buf_.
+    out_buf_.Consume(result);
+    if (closing_ && out_buf_.empty())
+      ResetSocket();
   }
-  if (pres)
-    *pres = result;
-  write_buf_.clear();
-  sys->cond().broadcast();
-
-  if (!is_block()) {
-    // For async sockets some more data could be written while Pepper sends
-    // previous portion so check do we have some data to write. For sync case,
-    // we always wait write operation completion.
-    PostWriteTask(NULL, false);
+  write_size_ = 0;
+  ResizeBuffers();
+  wait_queue().broadcast();
+
+  // More data could have been queued while Pepper was sending.
+  PostWriteTask(false);
+}
+
+void TCPSocket::SetNoDelay(int32_t result, bool no_delay, int32_t* pres) {
+  Mutex::Lock lock(mutex());
+  if (!is_open()) {
+    *pres = PP_ERROR_FAILED;
+  } else {
+    *pres = socket_->SetOption(PP_TCPSOCKETOPTION_PRIVATE_NO_DELAY,
+        pp::Var(no_delay), factory_.NewCallback(&TCPSocket::OnSetNoDelay,
+                                                pres));
   }
+  if (*pres != PP_OK_COMPLETIONPENDING)
+    wait_queue().broadcast();
 }
 
-void TCPSocket::Close(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+void TCPSocket::OnSetNoDelay(int32_t result, int32_t* pres) {
+  Mutex::Lock lock(mutex());
+  *pres = result;
+  wait_queue().broadcast();
+}
+
+void TCPSocket::Close(int32_t result) {
+  Mutex::Lock lock(mutex());
+  if (is_open())
+    ResetSocket();
+  wait_queue().broadcast();
+}
+
+void TCPSocket::ResetSocket() {
   delete socket_;
   socket_ = NULL;
-  if (pres)
-    *pres = PP_OK;
-  sys->cond().broadcast();
+  if (closing_) {
+    // Drop the reference close() took once the caller let go of the lock.
+    closing_ = false;
+    pp::Module::Get()->core()->CallOnMainThread(0,
+        factory_.NewCallback(&TCPSocket::OnClosed));
+  }
+}
+
+void TCPSocket::OnClosed(int32_t result) {
+  release();
 }
 
 bool TCPSocket::Accept(int32_t result, PP_Resource resource, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(!socket_);
   socket_ = new pp::TCPSocketPrivate(pp::PassRef(), resource);
   PostReadTask();
   *pres = PP_OK;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
   return true;
 }
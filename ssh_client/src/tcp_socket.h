@@ -5,13 +5,12 @@
 #ifndef SOCKET_H
 #define SOCKET_H
 
-#include <vector>
-
 #include "ppapi/cpp/completion_callback.h"
 #include "ppapi/cpp/private/tcp_socket_private.h"
 
 #include "file_system.h"
 #include "pthread_helpers.h"
+#include "ring_buffer.h"
 
 class TCPSocket : public FileStream {
  public:
@@ -26,6 +25,10 @@ class TCPSocket : public FileStream {
   bool connect(const char* host, uint16_t port);
   bool accept(PP_Resource resource);
 
+  // Limits on how much received data and data waiting to be sent is queued.
+  void set_recv_buf_size(size_t size);
+  void set_send_buf_size(size_t size);
+
   virtual void addref();
   virtual void release();
   virtual FileStream* dup(int fd);
@@ -33,8 +36,14 @@ class TCPSocket : public FileStream {
   virtual void close();
   virtual int read(char* buf, size_t count, size_t* nread);
   virtual int write(const char* buf, size_t count, size_t* nwrote);
+  virtual int readv(const iovec* iov, int iovcnt, size_t* nread);
+  virtual int writev(const iovec* iov, int iovcnt, size_t* nwrote);
 
   virtual int fcntl(int cmd,  va_list ap);
+  virtual int setsockopt(int level, int optname,
+                         const void* optval, socklen_t optlen);
+  virtual int getsockopt(int level, int optname,
+                         void* optval, socklen_t* optlen);
 
   virtual bool is_read_ready();
   virtual bool is_write_ready();
@@ -42,7 +51,8 @@ class TCPSocket : public FileStream {
 
  private:
   void PostReadTask();
-  void PostWriteTask(int32_t* pres, bool always_post);
+  void PostWriteTask(bool always_post);
+  void ResizeBuffers();
 
   void Connect(int32_t result, const char* host, uint16_t port, int32_t* pres);
   void OnConnect(int32_t result, int32_t* pres);
@@ -50,26 +60,45 @@ class TCPSocket : public FileStream {
   void Read(int32_t result);
   void OnRead(int32_t result);
 
-  void Write(int32_t result, int32_t* pres);
-  void OnWrite(int32_t result, int32_t* pres);
+  void Write(int32_t result);
+  void OnWrite(int32_t result);
+
+  void SetNoDelay(int32_t result, bool no_delay, int32_t* pres);
+  void OnSetNoDelay(int32_t result, int32_t* pres);
 
-  void Close(int32_t result, int32_t* pres);
+  void Close(int32_t result);
+  // Deletes the Pepper socket; called with the lock held.
+  void ResetSocket();
+  void OnClosed(int32_t result);
 
   bool Accept(int32_t result, PP_Resource resource, int32_t* pres);
 
-  static const size_t kBufSize = 64 * 1024;
+  static const size_t kDefaultBufSize = 256 * 1024;
+  // Smallest read worth asking Pepper for.
+  static const size_t kMinReadSize = 4 * 1024;
+  static const size_t kMaxBufSize = 4 * 1024 * 1024;
+  // How long data queued before close() may take to go out.
+  static const int32_t kLingerTimeoutMs = 30 * 1000;
 
   int ref_;
   int fd_;
   int oflag_;
   pp::CompletionCallbackFactory<TCPSocket> factory_;
   pp::TCPSocketPrivate* socket_;
-  std::vector<char> in_buf_;
-  std::vector<char> out_buf_;
-  std::vector<char> read_buf_;
-  std::vector<char> write_buf_;
+  // Pepper reads straight into the free space of |in_buf_| and writes
+  // straight from the data queued in |out_buf_|.  Neither buffer is
+  // reallocated while such a call is pending.
+  RingBuffer in_buf_;
+  RingBuffer out_buf_;
+  size_t recv_buf_size_;
+  size_t send_buf_size_;
   bool read_sent_;
   bool write_sent_;
+  // Number of bytes of |out_buf_| passed to the pending Pepper write.
+  size_t write_size_;
+  bool no_delay_;
+  // close() was called and the socket stays open only to send |out_buf_|.
+  bool closing_;
 
   DISALLOW_COPY_AND_ASSIGN(TCPSocket);
 };
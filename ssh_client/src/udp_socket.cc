@@ -11,25 +11,39 @@
 #include "ppapi/c/pp_errors.h"
 #include "ppapi/cpp/module.h"
 #include "ppapi/cpp/private/net_address_private.h"
+#include "ppapi/cpp/var.h"
 
 #include "file_system.h"
 
+const size_t UDPSocket::kDefaultBufSize;
+const size_t UDPSocket::kMaxBufSize;
+const size_t UDPSocket::kMaxDatagramSize;
+
 UDPSocket::UDPSocket(int fd, int oflag)
   : ref_(1), fd_(fd), oflag_(oflag), factory_(this), socket_(NULL),
-    read_buf_(kBufSize), read_sent_(false), write_sent_(false) {
+    recv_buf_size_(kDefaultBufSize), send_buf_size_(kDefaultBufSize),
+    reuse_addr_(false), broadcast_(false),
+    read_dgram_(NULL), write_dgram_(NULL),
+    read_sent_(false), write_sent_(false) {
 }
 
 UDPSocket::~UDPSocket() {
   assert(!socket_);
   assert(!ref_);
+  in_queue_.Clear(&pool_);
+  out_queue_.Clear(&pool_);
+  if (read_dgram_)
+    pool_.Free(read_dgram_);
+  if (write_dgram_)
+    pool_.Free(write_dgram_);
 }
 
 void UDPSocket::addref() {
-  ++ref_;
+  __sync_add_and_fetch(&ref_, 1);
 }
 
 void UDPSocket::release() {
-  if (!--ref_)
+  if (!__sync_sub_and_fetch(&ref_, 1))
     delete this;
 }
 
@@ -41,9 +55,8 @@ bool UDPSocket::bind(const sockaddr* saddr, socklen_t addrlen) {
   int32_t result = PP_OK_COMPLETIONPENDING;
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&UDPSocket::Bind, saddr, addrlen, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
   return result == PP_OK;
 }
 
@@ -52,63 +65,184 @@ int UDPSocket::getsockname(sockaddr* name, socklen_t* namelen) {
   pp::Module::Get()->core()->CallOnMainThread(0,
       factory_.NewCallback(&UDPSocket::GetBoundAddress,
                            name, namelen, &result));
-  FileSystem* sys = FileSystem::GetFileSystem();
   while (result == PP_OK_COMPLETIONPENDING)
-    sys->cond().wait(sys->mutex());
+    wait_queue().wait(mutex());
   return result == PP_OK ? 0 : -1;
 }
 
 ssize_t UDPSocket::sendto(const char* buf, size_t len, int flags,
                           const sockaddr* dest_addr, socklen_t addrlen) {
-  if (!is_open()) {
-    // UDP sockets allow to send data without bind but Pepper requires bind
-    // before send/receive so bind it to any address now.
-    sockaddr_in saddr = { AF_INET };
-    if (!bind((sockaddr*)&saddr, sizeof(saddr)))
-      return -1;
-  }
-  out_queue_.resize(out_queue_.size() + 1);
-  memcpy(&out_queue_.back().first, dest_addr,
-         std::min(addrlen, sizeof(sockaddr_in6)));
-  out_queue_.back().second.assign(buf, buf + len);
-  PostWriteTask();
-  return 0;
+  iovec iov = { const_cast<char*>(buf), len };
+  msghdr msg = {};
+  msg.msg_name = const_cast<sockaddr*>(dest_addr);
+  msg.msg_namelen = addrlen;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  return sendmsg(&msg, flags);
 }
 
 ssize_t UDPSocket::recvfrom(char* buffer, size_t len, int flags,
                             sockaddr* addr, socklen_t* addrlen) {
+  iovec iov = { buffer, len };
+  msghdr msg = {};
+  msg.msg_name = addr;
+  msg.msg_namelen = addrlen ? *addrlen : 0;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  ssize_t ret = recvmsg(&msg, flags);
+  if (addrlen)
+    *addrlen = msg.msg_namelen;
+  return ret;
+}
+
+ssize_t UDPSocket::sendmsg(const msghdr* msg, int flags) {
+  if (!EnsureBound())
+    return -1;
+
+  ssize_t len = QueueDatagram(msg);
+  PostWriteTask();
+  return len;
+}
+
+ssize_t UDPSocket::recvmsg(msghdr* msg, int flags) {
   if (is_block()) {
-    FileSystem* sys = FileSystem::GetFileSystem();
     while (in_queue_.empty() && is_open())
-      sys->cond().wait(sys->mutex());
+      wait_queue().wait(mutex());
   }
 
-  if (!in_queue_.empty()) {
-    *addrlen = std::min(*addrlen, sizeof(sockaddr_in6));
-    memcpy(addr, &in_queue_.front().first, *addrlen);
-    len = std::min(len, in_queue_.front().second.size());
-    std::copy(in_queue_.front().second.begin(),
-              in_queue_.front().second.begin() + len,
-              (char*)buffer);
-    if (flags != MSG_PEEK) {
-      if (len == in_queue_.front().second.size()) {
-        in_queue_.pop_front();
+  if (!in_queue_.empty())
+    return DequeueDatagram(msg, flags);
+
+  errno = is_open() ? EAGAIN : EACCES;
+  return -1;
+}
+
+int UDPSocket::sendmmsg(mmsghdr* msgvec, unsigned int vlen, int flags) {
+  if (!EnsureBound())
+    return -1;
+
+  // Hand the whole batch to Pepper in one go.  Only the first failure is
+  // reported, as for a single datagram.
+  unsigned int i = 0;
+  for (; i < vlen; i++) {
+    ssize_t len = QueueDatagram(&msgvec[i].msg_hdr);
+    if (len < 0)
+      break;
+    msgvec[i].msg_len = len;
+  }
+  PostWriteTask();
+  return i || !vlen ? i : -1;
+}
+
+int UDPSocket::recvmmsg(mmsghdr* msgvec, unsigned int vlen, int flags,
+                        const timespec* deadline) {
+  if (vlen && is_block()) {
+    while (in_queue_.empty() && is_open()) {
+      if (deadline) {
+        if (wait_queue().timedwait(mutex(), deadline) && errno == ETIMEDOUT)
+          break;
       } else {
-        in_queue_.front().second.erase(in_queue_.front().second.begin(),
-                                       in_queue_.front().second.begin() + len);
+        wait_queue().wait(mutex());
       }
     }
-    PostReadTask();
-    return len;
-  } else {
+  }
+
+  // A peeked datagram stays in the queue, so there is only one to take.
+  if (flags & MSG_PEEK)
+    vlen = std::min(vlen, 1U);
+
+  unsigned int i = 0;
+  for (; i < vlen && !in_queue_.empty(); i++)
+    msgvec[i].msg_len = DequeueDatagram(&msgvec[i].msg_hdr, flags);
+  if (i || !vlen)
+    return i;
+
+  errno = is_open() ? EAGAIN : EACCES;
+  return -1;
+}
+
+bool UDPSocket::EnsureBound() {
+  if (is_open())
+    return true;
+
+  // UDP sockets allow to send data without bind but Pepper requires bind
+  // before send/receive so bind it to any address now.
+  sockaddr_in saddr = { AF_INET };
+  return bind((sockaddr*)&saddr, sizeof(saddr));
+}
+
+ssize_t UDPSocket::QueueDatagram(const msghdr* msg) {
+  size_t iovlen = msg->msg_iovlen;
+  size_t len = 0;
+  for (size_t i = 0; i < iovlen; i++)
+    len += msg->msg_iov[i].iov_len;
+  if (len > kMaxDatagramSize) {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+  // A message always fits into an empty queue, otherwise wait for room.
+  while (!out_queue_.empty() && out_queue_.bytes() + len > send_buf_size_) {
+    if (!is_block()) {
+      errno = EAGAIN;
+      return -1;
+    }
+    // Earlier datagrams of a batch may not be on their way yet.
+    PostWriteTask();
+    wait_queue().wait(mutex());
     if (!is_open()) {
-      errno = EACCES;
+      errno = EIO;
       return -1;
-    } else {
-      errno = EAGAIN;
-      return 0;
     }
   }
+
+  Datagram* datagram = pool_.Alloc(len);
+  if (!datagram) {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  // The segments are gathered into a single datagram.
+  memset(&datagram->addr, 0, sizeof(datagram->addr));
+  if (msg->msg_name) {
+    memcpy(&datagram->addr, msg->msg_name,
+           std::min(msg->msg_namelen, sizeof(sockaddr_in6)));
+  }
+  char* data = datagram->data();
+  for (size_t i = 0; i < iovlen; i++) {
+    memcpy(data, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+    data += msg->msg_iov[i].iov_len;
+  }
+  datagram->size = len;
+  out_queue_.PushBack(datagram);
+  return len;
+}
+
+ssize_t UDPSocket::DequeueDatagram(msghdr* msg, int flags) {
+  Datagram* datagram = in_queue_.front();
+  if (msg->msg_name) {
+    msg->msg_namelen = std::min(msg->msg_namelen, sizeof(sockaddr_in6));
+    memcpy(msg->msg_name, &datagram->addr, msg->msg_namelen);
+  }
+  msg->msg_controllen = 0;
+  msg->msg_flags = 0;
+
+  size_t iovlen = msg->msg_iovlen;
+  size_t len = 0;
+  for (size_t i = 0; i < iovlen && len < datagram->size; i++) {
+    size_t n = std::min(msg->msg_iov[i].iov_len, datagram->size - len);
+    memcpy(msg->msg_iov[i].iov_base, datagram->data() + len, n);
+    len += n;
+  }
+  // Whatever doesn't fit is dropped along with the datagram.
+  if (len < datagram->size)
+    msg->msg_flags |= MSG_TRUNC;
+
+  if (!(flags & MSG_PEEK)) {
+    pool_.Free(in_queue_.PopFront());
+    PostReadTask();
+  }
+  return len;
 }
 
 void UDPSocket::close() {
@@ -116,9 +250,8 @@ void UDPSocket::close() {
     int32_t result = PP_OK_COMPLETIONPENDING;
     pp::Module::Get()->core()->CallOnMainThread(0,
         factory_.NewCallback(&UDPSocket::Close, &result));
-    FileSystem* sys = FileSystem::GetFileSystem();
     while (result == PP_OK_COMPLETIONPENDING)
-      sys->cond().wait(sys->mutex());
+      wait_queue().wait(mutex());
   }
 }
 
@@ -143,12 +276,71 @@ int UDPSocket::fcntl(int cmd, va_list ap) {
   }
 }
 
+int UDPSocket::setsockopt(int level, int optname,
+                          const void* optval, socklen_t optlen) {
+  if (level != SOL_SOCKET)
+    return ENOPROTOOPT;
+
+  int value;
+  int err = FileSystem::GetIntOption(optval, optlen, &value);
+  if (err)
+    return err;
+
+  size_t size = std::min(std::max((size_t)std::max(value, 0), kBufSize),
+                         kMaxBufSize);
+  switch (optname) {
+    case SO_RCVBUF:
+      recv_buf_size_ = size;
+      PostReadTask();
+      return 0;
+
+    case SO_SNDBUF:
+      send_buf_size_ = size;
+      wait_queue().broadcast();
+      return 0;
+
+    case SO_REUSEADDR:
+    case SO_BROADCAST:
+      if (is_open()) {
+        LOG("UDPSocket::setsockopt: %d option %d after bind\n", fd_, optname);
+        return EINVAL;
+      }
+      if (optname == SO_REUSEADDR)
+        reuse_addr_ = value != 0;
+      else
+        broadcast_ = value != 0;
+      return 0;
+
+    default:
+      return ENOPROTOOPT;
+  }
+}
+
+int UDPSocket::getsockopt(int level, int optname,
+                          void* optval, socklen_t* optlen) {
+  if (level != SOL_SOCKET)
+    return ENOPROTOOPT;
+
+  switch (optname) {
+    case SO_RCVBUF:
+      return FileSystem::SetIntOption(recv_buf_size_, optval, optlen);
+    case SO_SNDBUF:
+      return FileSystem::SetIntOption(send_buf_size_, optval, optlen);
+    case SO_REUSEADDR:
+      return FileSystem::SetIntOption(reuse_addr_, optval, optlen);
+    case SO_BROADCAST:
+      return FileSystem::SetIntOption(broadcast_, optval, optlen);
+    default:
+      return ENOPROTOOPT;
+  }
+}
+
 bool UDPSocket::is_read_ready() {
   return !in_queue_.empty();
 }
 
 bool UDPSocket::is_write_ready() {
-  return true;
+  return out_queue_.bytes() < send_buf_size_;
 }
 
 bool UDPSocket::is_exception() {
@@ -156,19 +348,27 @@ bool UDPSocket::is_exception() {
 }
 
 void UDPSocket::Close(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
+  Mutex::Lock lock(mutex());
   delete socket_;
   socket_ = NULL;
   *pres = PP_OK;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void UDPSocket::Bind(int32_t result, const sockaddr* saddr, socklen_t addrlen,
                      int32_t* pres) {
   FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   assert(!socket_);
   socket_ = new pp::UDPSocketPrivate(sys->instance());
+  if (reuse_addr_) {
+    socket_->SetSocketFeature(PP_UDPSOCKETFEATURE_PRIVATE_ADDRESS_REUSE,
+                              pp::Var(true));
+  }
+  if (broadcast_) {
+    socket_->SetSocketFeature(PP_UDPSOCKETFEATURE_PRIVATE_BROADCAST,
+                              pp::Var(true));
+  }
 
   PP_NetAddress_Private addr = {};
   if (FileSystem::CreateNetAddress(saddr, addrlen, &addr)) {
@@ -181,12 +381,11 @@ void UDPSocket::Bind(int32_t result, const sockaddr* saddr, socklen_t addrlen,
   }
 
   if (*pres != PP_OK_COMPLETIONPENDING)
-    sys->cond().broadcast();
+    wait_queue().broadcast();
 }
 
 void UDPSocket::OnBind(int32_t result, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   if (result == PP_OK) {
     PostReadTask();
   } else {
@@ -195,13 +394,12 @@ void UDPSocket::OnBind(int32_t result, int32_t* pres) {
     socket_ = NULL;
   }
   *pres = result;
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void UDPSocket::GetBoundAddress(int32_t result, sockaddr* name,
                                 socklen_t* namelen, int32_t* pres) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
   PP_NetAddress_Private addr = {};
   if (socket_ && socket_->GetBoundAddress(&addr)) {
     LOG("UDPSocket::GetBoundAddress: %d %s\n",
@@ -214,109 +412,130 @@ void UDPSocket::GetBoundAddress(int32_t result, sockaddr* name,
   } else {
     *pres = PP_ERROR_FAILED;
   }
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void UDPSocket::Read(int32_t result) {
   FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
 
   if (!is_open()) {
     socket_ = new pp::UDPSocketPrivate(sys->instance());
   }
 
-  result = socket_->RecvFrom(&read_buf_[0], read_buf_.size(),
+  // Pepper receives into room for the largest datagram, so nothing is ever
+  // cut short.  The buffer is reused until a datagram too large for a pool
+  // slot takes it over.
+  if (!read_dgram_)
+    read_dgram_ = pool_.Alloc(kMaxDatagramSize);
+  if (!read_dgram_) {
+    LOG("UDPSocket::Read: %d out of memory\n", fd_);
+    read_sent_ = false;
+    return;
+  }
+
+  result = socket_->RecvFrom(read_dgram_->data(), kMaxDatagramSize,
       factory_.NewCallback(&UDPSocket::OnRead));
   if (result != PP_OK_COMPLETIONPENDING) {
     delete socket_;
     socket_ = NULL;
+    pool_.Free(read_dgram_);
+    read_dgram_ = NULL;
     read_sent_ = false;
-    sys->cond().broadcast();
+    wait_queue().broadcast();
   }
 }
 
 void UDPSocket::OnRead(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
 
   read_sent_ = false;
   if (!is_open()) {
-    sys->cond().broadcast();
+    wait_queue().broadcast();
     return;
   }
 
   PP_NetAddress_Private addr = {};
-  if (result > 0 && socket_->GetRecvFromAddress(&addr)) {
+  if (result >= 0 && socket_->GetRecvFromAddress(&addr)) {
     LOG("UDPSocket::OnRead: %d %s\n",
         fd_, pp::NetAddressPrivate::Describe(addr, true).c_str());
-    in_queue_.resize(in_queue_.size() + 1);
-    socklen_t slen;
-    FileSystem::CreateSocketAddress(
-        addr, (sockaddr*)&in_queue_.back().first, &slen);
-    in_queue_.back().second.assign(read_buf_.begin(),
-                                   read_buf_.begin() + result);
+    Datagram* datagram = read_dgram_;
+    if ((size_t)result <= DatagramPool::kSlotSize) {
+      // Keep the large buffer for the next receive and queue small
+      // datagrams in pool slots.
+      datagram = pool_.Alloc(result);
+      if (datagram)
+        memcpy(datagram->data(), read_dgram_->data(), result);
+    } else {
+      read_dgram_ = NULL;
+    }
+
+    if (datagram) {
+      socklen_t slen;
+      FileSystem::CreateSocketAddress(addr, (sockaddr*)&datagram->addr, &slen);
+      datagram->size = result;
+      in_queue_.PushBack(datagram);
+    }
     PostReadTask();
   } else {
     delete socket_;
     socket_ = NULL;
   }
-  sys->cond().broadcast();
+  wait_queue().broadcast();
 }
 
 void UDPSocket::Write(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
 
-  assert(!write_buf_.size());
+  assert(!write_dgram_);
+  write_dgram_ = out_queue_.PopFront();
   FileSystem::CreateNetAddress(
-      (sockaddr*)&out_queue_.front().first, sizeof(sockaddr_in6), &write_addr_);
+      (sockaddr*)&write_dgram_->addr, sizeof(sockaddr_in6), &write_addr_);
   LOG("UDPSocket::Write: %d %s\n",
       fd_, pp::NetAddressPrivate::Describe(write_addr_, true).c_str());
-  write_buf_.swap(out_queue_.front().second);
-  out_queue_.pop_front();
-  result = socket_->SendTo(&write_buf_[0], write_buf_.size(), &write_addr_,
-      factory_.NewCallback(&UDPSocket::OnWrite));
+  result = socket_->SendTo(write_dgram_->data(), write_dgram_->size,
+      &write_addr_, factory_.NewCallback(&UDPSocket::OnWrite));
   if (result != PP_OK_COMPLETIONPENDING) {
     LOG("UDPSocket::Write: failed %d %d\n", fd_, result);
     delete socket_;
     socket_ = NULL;
+    pool_.Free(write_dgram_);
+    write_dgram_ = NULL;
     write_sent_ = false;
-    sys->cond().broadcast();
+    wait_queue().broadcast();
   }
 }
 
 void UDPSocket::OnWrite(int32_t result) {
-  FileSystem* sys = FileSystem::GetFileSystem();
-  Mutex::Lock lock(sys->mutex());
+  Mutex::Lock lock(mutex());
 
+  Datagram* datagram = write_dgram_;
+  write_dgram_ = NULL;
   write_sent_ = false;
   if (!is_open()) {
-    sys->cond().broadcast();
+    pool_.Free(datagram);
+    wait_queue().broadcast();
     return;
   }
 
-  if (result < 0 || (size_t)result > write_buf_.size()) {
+  if (result < 0 || (size_t)result > datagram->size) {
     // Write error.
     LOG("TCPSocket::OnWrite: close socket %d\n", fd_);
     delete socket_;
     socket_ = NULL;
-  } else if ((size_t)result < write_buf_.size()) {
+  } else if ((size_t)result < datagram->size) {
     // Partial write.
     assert(0);
   }
-  write_buf_.clear();
-  sys->cond().broadcast();
+  pool_.Free(datagram);
+  wait_queue().broadcast();
 
-  if (!is_block()) {
-    // For async sockets some more data could be written while Pepper sends
-    // previous portion so check do we have some data to write. For sync case,
-    // we always wait write operation completion.
-    PostWriteTask();
-  }
+  // More messages could have been queued while Pepper was sending.
+  PostWriteTask();
 }
 
 void UDPSocket::PostReadTask() {
-  if (is_open() && !read_sent_ && in_queue_.size() < kQueueSize) {
+  if (is_open() && !read_sent_ && in_queue_.bytes() < recv_buf_size_) {
     read_sent_ = true;
     if (!pp::Module::Get()->core()->IsMainThread()) {
       pp::Module::Get()->core()->CallOnMainThread(
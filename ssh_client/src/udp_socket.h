@@ -8,13 +8,10 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 
-#include <deque>
-#include <utility>
-#include <vector>
-
 #include "ppapi/cpp/completion_callback.h"
 #include "ppapi/cpp/private/udp_socket_private.h"
 
+#include "datagram_pool.h"
 #include "file_system.h"
 #include "pthread_helpers.h"
 
@@ -34,6 +31,13 @@ class UDPSocket : public FileStream {
                  const sockaddr* dest_addr, socklen_t addrlen);
   ssize_t recvfrom(char* buffer, size_t len, int flags,
                    sockaddr* addr, socklen_t* addrlen);
+  ssize_t sendmsg(const msghdr* msg, int flags);
+  ssize_t recvmsg(msghdr* msg, int flags);
+  // Queue or take up to |vlen| datagrams at once.  recvmmsg() blocks only for
+  // the first datagram, and no longer than |deadline| if it isn't NULL.
+  int sendmmsg(mmsghdr* msgvec, unsigned int vlen, int flags);
+  int recvmmsg(mmsghdr* msgvec, unsigned int vlen, int flags,
+               const timespec* deadline);
 
   virtual void addref();
   virtual void release();
@@ -44,13 +48,23 @@ class UDPSocket : public FileStream {
   virtual int write(const char* buf, size_t count, size_t* nwrote);
 
   virtual int fcntl(int cmd, va_list ap);
+  virtual int setsockopt(int level, int optname,
+                         const void* optval, socklen_t optlen);
+  virtual int getsockopt(int level, int optname,
+                         void* optval, socklen_t* optlen);
 
   virtual bool is_read_ready();
   virtual bool is_write_ready();
   virtual bool is_exception();
 
  private:
-  typedef std::deque<std::pair<sockaddr_in6, std::vector<char> > > MessageQueue;
+  // Bind to any address if the socket isn't bound yet.
+  bool EnsureBound();
+  // Copy |msg| into a datagram and append it to |out_queue_|.
+  ssize_t QueueDatagram(const msghdr* msg);
+  // Copy the first received datagram into |msg|.  The queue must not be
+  // empty.
+  ssize_t DequeueDatagram(msghdr* msg, int flags);
 
   void Close(int32_t result, int32_t* pres);
 
@@ -70,21 +84,33 @@ class UDPSocket : public FileStream {
   void PostReadTask();
   void PostWriteTask();
 
-  // Number of messages in incoming queue that we can read ahead.
-  static const size_t kQueueSize = 16;
+  // Default number of bytes of messages queued in each direction.
+  static const size_t kDefaultBufSize = 256 * 1024;
+  static const size_t kMaxBufSize = 4 * 1024 * 1024;
 
-  // Read buffer size for incoming message.
+  // Lower bound for SO_RCVBUF and SO_SNDBUF.
   static const size_t kBufSize = 64 * 1024;
+  // Largest UDP payload.
+  static const size_t kMaxDatagramSize = 64 * 1024;
 
   int ref_;
   int fd_;
   int oflag_;
   pp::CompletionCallbackFactory<UDPSocket> factory_;
   pp::UDPSocketPrivate* socket_;
-  MessageQueue in_queue_;
-  MessageQueue out_queue_;
-  std::vector<char> read_buf_;
-  std::vector<char> write_buf_;
+  DatagramPool pool_;
+  // Payload bytes in the queues are limited by SO_RCVBUF and SO_SNDBUF.
+  DatagramQueue in_queue_;
+  DatagramQueue out_queue_;
+  size_t recv_buf_size_;
+  size_t send_buf_size_;
+  // Pepper only takes these before the socket is bound.
+  bool reuse_addr_;
+  bool broadcast_;
+  // Datagrams Pepper is receiving into and sending from.  |read_dgram_| has
+  // room for kMaxDatagramSize bytes.
+  Datagram* read_dgram_;
+  Datagram* write_dgram_;
   PP_NetAddress_Private write_addr_;
   bool read_sent_;
   bool write_sent_;
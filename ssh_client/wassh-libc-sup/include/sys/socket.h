@@ -36,6 +36,14 @@ ssize_t sendto(int, const void*, size_t, int, const struct sockaddr*,
 ssize_t recv(int, void*, size_t, int);
 ssize_t recvfrom(int, void*, size_t, int, struct sockaddr*, socklen_t*);
 
+struct timespec;
+struct mmsghdr {
+  struct msghdr msg_hdr;
+  unsigned int msg_len;
+};
+int sendmmsg(int, struct mmsghdr*, unsigned int, int);
+int recvmmsg(int, struct mmsghdr*, unsigned int, int, struct timespec*);
+
 int getsockopt(int, int, int, void*, socklen_t*);
 int setsockopt(int, int, int, const void*, socklen_t);
 int socketpair(int, int, int, int[2]);
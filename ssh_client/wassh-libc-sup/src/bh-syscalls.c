@@ -57,6 +57,16 @@ __wasi_fd_t fd_dup2(__wasi_fd_t oldfd, __wasi_fd_t newfd) {
   return newfd;
 }
 
+SYSCALL(fd_pipe)(__wasi_fd_t* fds);
+int fd_pipe(__wasi_fd_t fds[2]) {
+  __wasi_errno_t error = __wassh_fd_pipe(fds);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
 SYSCALL(readpassphrase)(const char* prompt, __wasi_size_t prompt_len,
                         char* buf, __wasi_size_t buf_len, int echo);
 char* wassh_readpassphrase(const char* prompt, char* buf, size_t buf_len,
@@ -121,6 +131,17 @@ __wasi_fd_t sock_create(int domain, int type, int protocol) {
   return ret;
 }
 
+SYSCALL(sock_create_pair)(int domain, int type, int protocol,
+                          __wasi_fd_t* fds);
+int sock_create_pair(int domain, int type, int protocol, __wasi_fd_t fds[2]) {
+  __wasi_errno_t error = __wassh_sock_create_pair(domain, type, protocol, fds);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return 0;
+}
+
 SYSCALL(sock_connect)(__wasi_fd_t sock, int domain, const uint8_t* addr,
                       uint16_t port);
 int sock_connect(__wasi_fd_t sock, int domain, const uint8_t* addr,
@@ -166,6 +187,35 @@ int sock_set_opt(__wasi_fd_t sock, int level, int optname, int optvalue) {
   return 0;
 }
 
+SYSCALL(sock_send_datagrams)(__wasi_fd_t sock, struct wassh_datagram* dgrams,
+                              __wasi_size_t count, __wasi_size_t* nsent);
+int sock_send_datagrams(__wasi_fd_t sock, struct wassh_datagram* dgrams,
+                        size_t count) {
+  __wasi_size_t nsent;
+  __wasi_errno_t error = __wassh_sock_send_datagrams(sock, dgrams, count,
+                                                     &nsent);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return nsent;
+}
+
+SYSCALL(sock_recv_datagrams)(__wasi_fd_t sock, struct wassh_datagram* dgrams,
+                              __wasi_size_t count, int flags,
+                              __wasi_size_t* nrecv);
+int sock_recv_datagrams(__wasi_fd_t sock, struct wassh_datagram* dgrams,
+                        size_t count, int flags) {
+  __wasi_size_t nrecv;
+  __wasi_errno_t error = __wassh_sock_recv_datagrams(sock, dgrams, count,
+                                                     flags, &nrecv);
+  if (error != 0) {
+    errno = error;
+    return -1;
+  }
+  return nrecv;
+}
+
 SYSCALL(tty_get_window_size)(__wasi_fd_t fd, struct winsize* winsize);
 int tty_get_window_size(__wasi_fd_t fd, struct winsize* winsize) {
   __wasi_errno_t error = __wassh_tty_get_window_size(fd, winsize);
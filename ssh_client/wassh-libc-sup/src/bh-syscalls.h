@@ -22,20 +22,43 @@ __BEGIN_DECLS
 
 struct winsize;
 
+// One datagram for sock_send_datagrams & sock_recv_datagrams.  The layout is
+// part of the syscall ABI; see docs/WASI-extensions.md.
+struct wassh_datagram {
+  // The payload, scattered over |iovs_len| buffers.
+  const __wasi_iovec_t* iovs;
+  __wasi_size_t iovs_len;
+  // Bytes sent or received.
+  __wasi_size_t len;
+  // The peer: AF_INET or AF_INET6 with the address in network order, or
+  // AF_UNSPEC for the connected peer.
+  int domain;
+  uint8_t addr[16];
+  uint16_t port;
+  // Receive results (__WASI_ROFLAGS_*).
+  uint16_t flags;
+};
+
 int sock_accept(__wasi_fd_t sock, __wasi_fd_t* newsock);
 int sock_bind(__wasi_fd_t sock, int domain, const uint8_t* addr,
               uint16_t port);
 int sock_listen(__wasi_fd_t sock, int backlog);
 void sock_register_fake_addr(int idx, const char* name);
 __wasi_fd_t sock_create(int domain, int type, int protocol);
+int sock_create_pair(int domain, int type, int protocol, __wasi_fd_t fds[2]);
 int sock_connect(__wasi_fd_t sock, int domain, const uint8_t* addr,
                  uint16_t port);
 int sock_get_name(__wasi_fd_t sock, int* family, uint16_t* port, uint8_t* addr,
                   bool remote);
 int sock_get_opt(__wasi_fd_t sock, int level, int optname, int* optvalue);
 int sock_set_opt(__wasi_fd_t sock, int level, int optname, int optvalue);
+int sock_send_datagrams(__wasi_fd_t sock, struct wassh_datagram* dgrams,
+                        size_t count);
+int sock_recv_datagrams(__wasi_fd_t sock, struct wassh_datagram* dgrams,
+                        size_t count, int flags);
 __wasi_fd_t fd_dup(__wasi_fd_t oldfd);
 __wasi_fd_t fd_dup2(__wasi_fd_t oldfd, __wasi_fd_t newfd);
+int fd_pipe(__wasi_fd_t fds[2]);
 int tty_get_window_size(__wasi_fd_t fd, struct winsize* winsize);
 int tty_set_window_size(__wasi_fd_t fd, const struct winsize* winsize);
 char* wassh_readpassphrase(const char* prompt, char* buf, size_t buf_len,
@@ -65,19 +65,149 @@ static bool is_localhost(const char* node) {
   return false;
 }
 
-// Return addresses in the 0.0.0.0/8 "current network" pool.
-static uint32_t next_fake_addr(const char* node) {
-  static uint32_t fake_addr = 0;
-  sock_register_fake_addr(fake_addr, node);
-  return fake_addr++;
+// Fake addresses stand in for names that the JS side resolves once a socket
+// connects to them.  A name gets one index that is used for both families:
+// 0.0.0.0/8 "current network" addresses for IPv4 and the 100::/64 "discard"
+// pool for IPv6.  The JS side looks names up only in connect(), so mappings
+// can be reclaimed whenever nothing is about to connect to them; the least
+// recently used ones are dropped once there are too many.
+#define FAKE_ADDR_POOL_SIZE (1u << 24)
+#define FAKE_ADDR_MAX_ENTRIES 4096
+// Number of hash buckets; must be a power of two.
+#define FAKE_ADDR_BUCKETS 8192
+
+struct fake_addr {
+  char* name;
+  uint32_t idx;
+  // Hash chains for lookups by name and by index.
+  struct fake_addr* name_next;
+  struct fake_addr* idx_next;
+  // Position in the LRU list, most recently used first.
+  struct fake_addr* lru_prev;
+  struct fake_addr* lru_next;
+};
+
+static struct fake_addr* fake_addrs_by_name[FAKE_ADDR_BUCKETS];
+static struct fake_addr* fake_addrs_by_idx[FAKE_ADDR_BUCKETS];
+static struct fake_addr* fake_addrs_lru_head;
+static struct fake_addr* fake_addrs_lru_tail;
+static size_t fake_addrs_count;
+// Where to look for an unused index next.  0 is skipped as 0.0.0.0 is the
+// "any" address.
+static uint32_t fake_addrs_next_idx = 1;
+
+// FNV-1a.
+static uint32_t fake_addr_name_hash(const char* name) {
+  uint32_t hash = 2166136261u;
+  while (*name) {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash & (FAKE_ADDR_BUCKETS - 1);
+}
+
+static uint32_t fake_addr_idx_hash(uint32_t idx) {
+  return idx & (FAKE_ADDR_BUCKETS - 1);
+}
+
+static struct fake_addr* fake_addr_find_idx(uint32_t idx) {
+  struct fake_addr* entry = fake_addrs_by_idx[fake_addr_idx_hash(idx)];
+  while (entry && entry->idx != idx)
+    entry = entry->idx_next;
+  return entry;
+}
+
+static void fake_addr_lru_unlink(struct fake_addr* entry) {
+  if (entry->lru_prev)
+    entry->lru_prev->lru_next = entry->lru_next;
+  else
+    fake_addrs_lru_head = entry->lru_next;
+  if (entry->lru_next)
+    entry->lru_next->lru_prev = entry->lru_prev;
+  else
+    fake_addrs_lru_tail = entry->lru_prev;
+}
+
+static void fake_addr_lru_push(struct fake_addr* entry) {
+  entry->lru_prev = NULL;
+  entry->lru_next = fake_addrs_lru_head;
+  if (fake_addrs_lru_head)
+    fake_addrs_lru_head->lru_prev = entry;
+  else
+    fake_addrs_lru_tail = entry;
+  fake_addrs_lru_head = entry;
 }
 
-// Return addresses in the 100::/64 "discard" pool.
-static struct in6_addr* next_fake_addr6(const char* node) {
-  static struct in6_addr fake_addr = {1};
-  // TODO(vapier): This only handles 256 IPv6 hosts.  Do we care?
-  fake_addr.s6_addr[15] = next_fake_addr(node);
-  return &fake_addr;
+// Drop the least recently used mapping.
+static void fake_addr_evict(void) {
+  struct fake_addr* entry = fake_addrs_lru_tail;
+  if (!entry)
+    return;
+
+  struct fake_addr** pp = &fake_addrs_by_name[fake_addr_name_hash(entry->name)];
+  while (*pp != entry)
+    pp = &(*pp)->name_next;
+  *pp = entry->name_next;
+
+  pp = &fake_addrs_by_idx[fake_addr_idx_hash(entry->idx)];
+  while (*pp != entry)
+    pp = &(*pp)->idx_next;
+  *pp = entry->idx_next;
+
+  fake_addr_lru_unlink(entry);
+  --fake_addrs_count;
+
+  // Let the JS side forget it too.
+  sock_register_fake_addr(entry->idx, "");
+  free(entry->name);
+  free(entry);
+}
+
+// Return the index for |node|, allocating one if needed, or 0 on failure.
+static uint32_t get_fake_addr(const char* node) {
+  uint32_t hash = fake_addr_name_hash(node);
+  struct fake_addr* entry = fake_addrs_by_name[hash];
+  while (entry && strcmp(entry->name, node))
+    entry = entry->name_next;
+  if (entry) {
+    fake_addr_lru_unlink(entry);
+    fake_addr_lru_push(entry);
+    return entry->idx;
+  }
+
+  if (fake_addrs_count >= FAKE_ADDR_MAX_ENTRIES)
+    fake_addr_evict();
+
+  // Go through the whole pool before reusing an index.
+  uint32_t idx = 0;
+  for (uint32_t i = 1; i < FAKE_ADDR_POOL_SIZE && !idx; ++i) {
+    if (!fake_addr_find_idx(fake_addrs_next_idx))
+      idx = fake_addrs_next_idx;
+    if (++fake_addrs_next_idx == FAKE_ADDR_POOL_SIZE)
+      fake_addrs_next_idx = 1;
+  }
+  if (!idx)
+    return 0;
+
+  entry = malloc(sizeof(*entry));
+  if (!entry)
+    return 0;
+  entry->name = strdup(node);
+  if (!entry->name) {
+    free(entry);
+    return 0;
+  }
+  entry->idx = idx;
+  entry->name_next = fake_addrs_by_name[hash];
+  fake_addrs_by_name[hash] = entry;
+  uint32_t idx_hash = fake_addr_idx_hash(idx);
+  entry->idx_next = fake_addrs_by_idx[idx_hash];
+  fake_addrs_by_idx[idx_hash] = entry;
+  fake_addr_lru_push(entry);
+  ++fake_addrs_count;
+
+  sock_register_fake_addr(idx, node);
+  return idx;
 }
 
 // Resolve a hostname into an IP address.
@@ -137,8 +267,18 @@ int getaddrinfo(const char* node, const char* service,
         _EXIT("EAI_NONAME: non-numeric IPv6 address");
         return EAI_NONAME;
       } else {
+        uint32_t idx = get_fake_addr(node);
+        if (!idx) {
+          _EXIT("EAI_MEMORY: out of fake addresses");
+          return EAI_MEMORY;
+        }
         ai_protocol = -1;
-        memcpy(&sin6_addr, next_fake_addr6(node), sizeof(sin6_addr));
+        memset(&sin6_addr, 0, sizeof(sin6_addr));
+        sin6_addr.s6_addr[0] = 1;
+        sin6_addr.s6_addr[12] = idx >> 24;
+        sin6_addr.s6_addr[13] = idx >> 16;
+        sin6_addr.s6_addr[14] = idx >> 8;
+        sin6_addr.s6_addr[15] = idx;
       }
     }
   } else {
@@ -149,8 +289,13 @@ int getaddrinfo(const char* node, const char* service,
         _EXIT("EAI_NONAME: non-numeric IPv4 address");
         return EAI_NONAME;
       } else {
+        uint32_t idx = get_fake_addr(node);
+        if (!idx) {
+          _EXIT("EAI_MEMORY: out of fake addresses");
+          return EAI_MEMORY;
+        }
         ai_protocol = -1;
-        s_addr = next_fake_addr(node);
+        s_addr = htonl(idx);
       }
     }
   }
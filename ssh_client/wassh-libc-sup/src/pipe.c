@@ -0,0 +1,22 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Implementation for pipe().
+// https://pubs.opengroup.org/onlinepubs/9699919799/functions/pipe.html
+//
+// Both ends live in the runtime, so this only works between threads of the
+// program, which is all we have anyways.
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "bh-syscalls.h"
+#include "debug.h"
+
+int pipe(int pipefd[2]) {
+  _ENTER("pipefd=%p", pipefd);
+  int ret = fd_pipe(pipefd);
+  _EXIT_ERRNO(ret, "");
+  return ret;
+}
@@ -0,0 +1,215 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Implementation for sendto(), recvfrom(), sendmmsg() & recvmmsg().
+// https://pubs.opengroup.org/onlinepubs/9699919799/functions/sendto.html
+// https://pubs.opengroup.org/onlinepubs/9699919799/functions/recvfrom.html
+// https://man7.org/linux/man-pages/man2/sendmmsg.2.html
+// https://man7.org/linux/man-pages/man2/recvmmsg.2.html
+
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "bh-syscalls.h"
+#include "debug.h"
+
+// How many datagrams to move per syscall.  Larger batches are split up.
+#define BATCH_SIZE 32
+
+// Fill in the peer of |dgram| from |addr|.  A NULL |addr| means the connected
+// peer.
+static int set_peer(struct wassh_datagram* dgram, const struct sockaddr* addr,
+                    socklen_t addrlen) {
+  memset(dgram->addr, 0, sizeof(dgram->addr));
+  dgram->port = 0;
+  dgram->flags = 0;
+
+  if (addr == NULL) {
+    dgram->domain = AF_UNSPEC;
+    return 0;
+  }
+
+  dgram->domain = addr->sa_family;
+  switch (addr->sa_family) {
+    case AF_INET: {
+      const struct sockaddr_in* sin = (void*)addr;
+      if (addrlen < sizeof(*sin))
+        break;
+      memcpy(dgram->addr, &sin->sin_addr.s_addr, 4);
+      dgram->port = ntohs(sin->sin_port);
+      return 0;
+    }
+
+    case AF_INET6: {
+      const struct sockaddr_in6* sin6 = (void*)addr;
+      if (addrlen < sizeof(*sin6))
+        break;
+      memcpy(dgram->addr, &sin6->sin6_addr.s6_addr, 16);
+      dgram->port = ntohs(sin6->sin6_port);
+      return 0;
+    }
+
+    default:
+      errno = EAFNOSUPPORT;
+      return -1;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+// Store the peer of |dgram| in |addr|.  Like the kernel, |*addrlen| is set to
+// the full size even when |addr| is too small to hold all of it.
+static void get_peer(const struct wassh_datagram* dgram, struct sockaddr* addr,
+                     socklen_t* addrlen) {
+  if (addr == NULL || addrlen == NULL)
+    return;
+
+  union {
+    struct sockaddr_in sin;
+    struct sockaddr_in6 sin6;
+  } peer;
+  socklen_t len;
+  memset(&peer, 0, sizeof(peer));
+  switch (dgram->domain) {
+    case AF_INET:
+      peer.sin.sin_family = AF_INET;
+      peer.sin.sin_port = htons(dgram->port);
+      memcpy(&peer.sin.sin_addr, dgram->addr, 4);
+      len = sizeof(peer.sin);
+      break;
+
+    case AF_INET6:
+      peer.sin6.sin6_family = AF_INET6;
+      peer.sin6.sin6_port = htons(dgram->port);
+      memcpy(&peer.sin6.sin6_addr, dgram->addr, 16);
+      len = sizeof(peer.sin6);
+      break;
+
+    default:
+      *addrlen = 0;
+      return;
+  }
+
+  memcpy(addr, &peer, *addrlen < len ? *addrlen : len);
+  *addrlen = len;
+}
+
+ssize_t sendto(int sockfd, const void* buf, size_t len, int flags,
+               const struct sockaddr* dest_addr, socklen_t addrlen) {
+  _ENTER("sockfd=%i buf=%p len=%zu flags=%#x dest_addr=%p addrlen=%i",
+         sockfd, buf, len, flags, dest_addr, addrlen);
+
+  __wasi_iovec_t iov = {(void*)buf, len};
+  struct wassh_datagram dgram = {
+    .iovs = &iov,
+    .iovs_len = 1,
+  };
+  ssize_t ret = set_peer(&dgram, dest_addr, addrlen);
+  if (ret == 0) {
+    ret = sock_send_datagrams(sockfd, &dgram, 1);
+    if (ret == 1)
+      ret = dgram.len;
+  }
+
+  _EXIT("ret = %zi", ret);
+  return ret;
+}
+
+ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags,
+                 struct sockaddr* src_addr, socklen_t* addrlen) {
+  _ENTER("sockfd=%i buf=%p len=%zu flags=%#x src_addr=%p addrlen=%p",
+         sockfd, buf, len, flags, src_addr, addrlen);
+
+  __wasi_iovec_t iov = {buf, len};
+  struct wassh_datagram dgram = {
+    .iovs = &iov,
+    .iovs_len = 1,
+  };
+  ssize_t ret = sock_recv_datagrams(sockfd, &dgram, 1, flags);
+  if (ret == 1) {
+    get_peer(&dgram, src_addr, addrlen);
+    ret = dgram.len;
+  }
+
+  _EXIT("ret = %zi", ret);
+  return ret;
+}
+
+int sendmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+             int flags) {
+  _ENTER("sockfd=%i msgvec=%p vlen=%u flags=%#x", sockfd, msgvec, vlen, flags);
+
+  struct wassh_datagram dgrams[BATCH_SIZE];
+  unsigned int sent = 0;
+  int ret = 0;
+  while (sent < vlen) {
+    unsigned int count = vlen - sent;
+    if (count > BATCH_SIZE)
+      count = BATCH_SIZE;
+
+    for (unsigned int i = 0; i < count; ++i) {
+      const struct msghdr* msg = &msgvec[sent + i].msg_hdr;
+      dgrams[i].iovs = (const __wasi_iovec_t*)msg->msg_iov;
+      dgrams[i].iovs_len = msg->msg_iovlen;
+      ret = set_peer(&dgrams[i], msg->msg_name, msg->msg_namelen);
+      if (ret < 0) {
+        count = i;
+        break;
+      }
+    }
+
+    if (count) {
+      ret = sock_send_datagrams(sockfd, dgrams, count);
+      if (ret < 0)
+        break;
+      for (int i = 0; i < ret; ++i)
+        msgvec[sent + i].msg_len = dgrams[i].len;
+      sent += ret;
+    }
+    // Stop at the first datagram that couldn't be sent.
+    if (ret < 0 || (unsigned int)ret < count || count < BATCH_SIZE)
+      break;
+  }
+
+  // Like the kernel, only report errors if nothing was sent.
+  if (sent)
+    ret = sent;
+  _EXIT("ret = %i", ret);
+  return ret;
+}
+
+int recvmmsg(int sockfd, struct mmsghdr* msgvec, unsigned int vlen,
+             int flags, struct timespec* timeout) {
+  _ENTER("sockfd=%i msgvec=%p vlen=%u flags=%#x timeout=%p",
+         sockfd, msgvec, vlen, flags, timeout);
+
+  // Only the first datagram is waited for, and the rest are whatever else
+  // has arrived already, so there is nothing for |timeout| to cut short.
+  if (vlen > BATCH_SIZE)
+    vlen = BATCH_SIZE;
+
+  struct wassh_datagram dgrams[BATCH_SIZE];
+  for (unsigned int i = 0; i < vlen; ++i) {
+    const struct msghdr* msg = &msgvec[i].msg_hdr;
+    dgrams[i].iovs = (const __wasi_iovec_t*)msg->msg_iov;
+    dgrams[i].iovs_len = msg->msg_iovlen;
+  }
+
+  int ret = sock_recv_datagrams(sockfd, dgrams, vlen, flags);
+  for (int i = 0; i < ret; ++i) {
+    struct msghdr* msg = &msgvec[i].msg_hdr;
+    get_peer(&dgrams[i], msg->msg_name, &msg->msg_namelen);
+    msg->msg_controllen = 0;
+    msg->msg_flags = dgrams[i].flags & __WASI_ROFLAGS_RECV_DATA_TRUNCATED ?
+        MSG_TRUNC : 0;
+    msgvec[i].msg_len = dgrams[i].len;
+  }
+
+  _EXIT("ret = %i", ret);
+  return ret;
+}
@@ -0,0 +1,28 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Implementation for socketpair().
+// https://pubs.opengroup.org/onlinepubs/9699919799/functions/socketpair.html
+
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "bh-syscalls.h"
+#include "debug.h"
+
+int socketpair(int domain, int type, int protocol, int sv[2]) {
+  _ENTER("domain=%i type=%i protocol=%i sv=%p", domain, type, protocol, sv);
+
+  // Maybe add these if anyone wants them.
+  if (type & (SOCK_NONBLOCK | SOCK_CLOEXEC)) {
+    _EXIT("|type| flags unsupported");
+    errno = EINVAL;
+    return -1;
+  }
+
+  // The runtime only connects UNIX stream sockets to each other.
+  int ret = sock_create_pair(domain, type, protocol, sv);
+  _EXIT_ERRNO(ret, "");
+  return ret;
+}
@@ -33,24 +33,9 @@
   return val; \
 }
 
-// ssize_t send(int sockfd, const void* buf, size_t len, int flags);
-ssize_t sendto(int sockfd, const void* buf, size_t len, int flags,
-               const struct sockaddr* dest_addr, socklen_t addrlen) {
-  STUB_ENOSYS(-1, "");
-}
 // ssize_t sendmsg(int sockfd, const struct msghdr* msg, int flags);
-// ssize_t recv(int sockfd, void* buf, size_t len, int flags);
-ssize_t recvfrom(int sockfd, void* buf, size_t len, int flags,
-                 struct sockaddr* src_addr, socklen_t* addrlen) {
-  STUB_ENOSYS(-1, "");
-}
 // ssize_t recvmsg(int sockfd, struct msghdr* msg, int flags);
 
-int socketpair(int domain, int type, int protocol, int sv[2]) {
-  STUB_ENOSYS(-1, "domain=%i type=%i protocol=%i sv=%p",
-              domain, type, protocol, sv);
-}
-
 struct servent* getservbyname(const char* name, const char* proto) {
   STUB_ENOSYS(NULL, "name={%s} proto={%s}", name, proto);
 }
@@ -73,10 +58,6 @@ void syslog(int priority, const char* format, ...) {
 }
 void closelog(void) {}
 
-int pipe(int pipefd[2]) {
-  STUB_ENOSYS(-1, "");
-}
-
 struct passwd* getpwuid(uid_t uid) {  // NOLINT(runtime/threadsafe_fn)
   static struct passwd pwd;
   pwd.pw_name = (char*)"";
@@ -7,7 +7,11 @@
  * common module to avoid excess imports otherwise.
  */
 
-// const AF_UNSPEC = 0;
+export const AF_UNSPEC = 0;
 export const AF_INET = 1;
 export const AF_INET6 = 2;
 export const AF_UNIX = 3;
+
+// WASI riflags & roflags for receiving datagrams.
+export const RECV_PEEK = 1;
+export const RECV_DATA_TRUNCATED = 1;
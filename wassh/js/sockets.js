@@ -119,6 +119,44 @@ export class Socket extends VFS.PathHandle {
     });
   }
 
+  /**
+   * Send a datagram.  Connected stream sockets ignore the address.
+   *
+   * @param {!Uint8Array} buf
+   * @param {?string} address The peer, or null for the connected one.
+   * @param {number} port
+   * @return {!Promise<!WASI_t.errno|{nwritten: number}>}
+   */
+  async sendTo(buf, address, port) {
+    return this.write(buf);
+  }
+
+  /**
+   * Receive datagrams.  Waits for the first one, and returns whatever else has
+   * arrived already.  Stream sockets return a single read instead.
+   *
+   * @param {!Array<number>} lengths Room for each datagram.
+   * @param {number} flags WASI riflags.
+   * @return {!Promise<!WASI_t.errno|{datagrams: !Array<{
+   *     buf: !Uint8Array,
+   *     truncated: boolean,
+   *     address: ?string,
+   *     port: number,
+   * }>}>}
+   */
+  async recvFrom(lengths, flags) {
+    if (flags !== 0) {
+      return WASI.errno.ENOTSUP;
+    }
+
+    const ret = await this.read(lengths[0]);
+    if (typeof ret === 'number') {
+      return ret;
+    }
+    return {datagrams: [{buf: ret.buf, truncated: false, address: null,
+                         port: 0}]};
+  }
+
   /**
    * Registers a listener that will be called when data is recieved on the
    * socket.
@@ -584,6 +622,249 @@ export class ChromeTcpListenSocket extends Socket {
  */
 ChromeTcpListenSocket.eventRouter_ = null;
 
+/**
+ * A UDP/IP based socket backed by the chrome.sockets.udp API.
+ */
+export class ChromeUdpSocket extends Socket {
+  /** @override */
+  constructor(domain, type, protocol) {
+    super(domain, type, protocol);
+
+    /** @type {number} */
+    this.socketId_ = -1;
+    this.bound_ = false;
+
+    /**
+     * Received datagrams that haven't been read yet.
+     *
+     * @type {!Array<{data: !Uint8Array, address: string, port: number}>}
+     */
+    this.datagrams_ = [];
+  }
+
+  /** @override */
+  async init() {
+    const info = await new Promise((resolve) => {
+      chrome.sockets.udp.create(resolve);
+    });
+
+    this.socketId_ = info.socketId;
+
+    if (ChromeUdpSocket.eventRouter_ === null) {
+      ChromeUdpSocket.eventRouter_ = new ChromeUdpSocketEventRouter();
+    }
+
+    ChromeUdpSocket.eventRouter_.register(this.socketId_, this);
+  }
+
+  /** @override */
+  async bind(address, port) {
+    this.debug(`bind(${address}, ${port})`);
+
+    if (this.bound_) {
+      return WASI.errno.EINVAL;
+    }
+
+    const result = await new Promise((resolve) => {
+      chrome.sockets.udp.bind(this.socketId_, address, port, resolve);
+    });
+
+    switch (result) {
+      case 0:
+        this.bound_ = true;
+        return this;
+      case -147:
+        return WASI.errno.EADDRINUSE;
+      default:
+        // NB: Should try to translate these error codes.
+        return WASI.errno.EADDRNOTAVAIL;
+    }
+  }
+
+  /**
+   * Chrome only sends & receives on bound sockets, so bind to any address if
+   * the program hasn't picked one.
+   *
+   * @return {!Promise<!WASI_t.errno>}
+   */
+  async bindAny_() {
+    if (this.bound_) {
+      return WASI.errno.ESUCCESS;
+    }
+
+    const address = this.domain === Constants.AF_INET6 ? '::' : '0.0.0.0';
+    const ret = await this.bind(address, 0);
+    return typeof ret === 'number' ? ret : WASI.errno.ESUCCESS;
+  }
+
+  /** @override */
+  async connect(address, port) {
+    this.debug(`connect(${address}, ${port})`);
+
+    // Connecting a UDP socket only sets the default peer.
+    const ret = await this.bindAny_();
+    if (ret !== WASI.errno.ESUCCESS) {
+      return ret;
+    }
+
+    this.address = address;
+    this.port = port;
+    return WASI.errno.ESUCCESS;
+  }
+
+  /** @override */
+  async close() {
+    // In the *NIX world, close must never fail.  That's why we don't return
+    // any errors here.
+
+    if (this.socketId_ === -1) {
+      return;
+    }
+
+    chrome.sockets.udp.close(this.socketId_);
+    ChromeUdpSocket.eventRouter_.unregister(this.socketId_);
+
+    this.socketId_ = -1;
+    this.bound_ = false;
+    this.address = null;
+    this.port = null;
+    this.datagrams_ = [];
+  }
+
+  /** @override */
+  async write(buf) {
+    return this.sendTo(buf, null, 0);
+  }
+
+  /** @override */
+  async sendTo(buf, address, port) {
+    if (address === null) {
+      if (this.address === null) {
+        return WASI.errno.EDESTADDRREQ;
+      }
+      address = this.address;
+      port = this.port;
+    }
+
+    const ret = await this.bindAny_();
+    if (ret !== WASI.errno.ESUCCESS) {
+      return ret;
+    }
+
+    const data = buf.buffer.slice(buf.byteOffset, buf.byteOffset + buf.length);
+    const {resultCode, bytesSent} = await new Promise((resolve) => {
+      chrome.sockets.udp.send(this.socketId_, data, address, port, resolve);
+    });
+
+    if (resultCode < 0) {
+      // NB: Should try to translate these error codes.
+      return WASI.errno.ENETUNREACH;
+    }
+
+    return {nwritten: bytesSent};
+  }
+
+  /**
+   * @param {!ArrayBuffer} data
+   * @param {string} address
+   * @param {number} port
+   * @override
+   */
+  onRecv(data, address, port) {
+    this.datagrams_.push({data: new Uint8Array(data), address, port});
+
+    // If there are any readers waiting, wake them up.
+    if (this.reader_) {
+      this.reader_();
+      this.reader_ = null;
+    }
+
+    if (this.receiveListener_) {
+      this.receiveListener_();
+    }
+  }
+
+  /** @override */
+  async read(length) {
+    const ret = await this.recvFrom([length], 0);
+    return {buf: ret.datagrams[0].buf};
+  }
+
+  /** @override */
+  async recvFrom(lengths, flags) {
+    if ((flags & ~Constants.RECV_PEEK) !== 0) {
+      return WASI.errno.ENOTSUP;
+    }
+
+    // TODO(vapier): Support O_NONBLOCK.
+    if (this.datagrams_.length === 0) {
+      await new Promise((resolve) => this.reader_ = resolve);
+    }
+
+    // A peeked datagram stays queued, so there is only one to return.
+    let datagrams;
+    if (flags & Constants.RECV_PEEK) {
+      datagrams = this.datagrams_.slice(0, 1);
+    } else {
+      datagrams = this.datagrams_.splice(0, lengths.length);
+    }
+
+    return {
+      datagrams: datagrams.map(({data, address, port}, i) => ({
+        buf: data.subarray(0, lengths[i]),
+        truncated: data.length > lengths[i],
+        address,
+        port,
+      })),
+    };
+  }
+
+  /**
+   * @return {!Promise<!Object>}
+   */
+  async getSocketInfo() {
+    const info = await new Promise((resolve) => {
+      chrome.sockets.udp.getInfo(this.socketId_, resolve);
+    });
+    return {
+      ...info,
+      connected: this.bound_,
+      peerAddress: this.address ?? undefined,
+      peerPort: this.port ?? undefined,
+    };
+  }
+
+  /** @override */
+  async setSocketOption(level, name, value) {
+    switch (level) {
+      case SOL_SOCKET: {
+        switch (name) {
+          case SO_REUSEADDR: {
+            // TODO(vapier): Try and extend Chrome sockets API to support this.
+            console.warn(`Ignoring SO_REUSEADDR=${value}`);
+            return WASI.errno.ESUCCESS;
+          }
+        }
+        break;
+      }
+    }
+
+    return WASI.errno.ENOPROTOOPT;
+  }
+
+  /** @override */
+  static isSupported() {
+    return window?.chrome?.sockets?.udp !== undefined;
+  }
+}
+
+/**
+ * Used to route receive events to all ChromeUdpSockets.
+ *
+ * @type {?ChromeUdpSocketEventRouter}
+ */
+ChromeUdpSocket.eventRouter_ = null;
+
 /**
  * A TCP/IP based socket backed by a Stream. Used to connect to a relay server.
  */
@@ -1177,6 +1458,135 @@ export class UnixSocket extends Socket {
   }
 }
 
+/**
+ * One end of an in-memory socketpair() or pipe().
+ *
+ * Data written to one end is queued on the other, so it never leaves the
+ * runtime.
+ */
+export class LocalSocket extends Socket {
+  /**
+   * @param {number} domain
+   * @param {number} type
+   * @param {number} protocol
+   * @param {boolean=} readable
+   * @param {boolean=} writable
+   */
+  constructor(domain, type, protocol, readable = true, writable = true) {
+    super(domain, type, protocol);
+    /** @type {?LocalSocket} */
+    this.peer_ = null;
+    /** @const {boolean} */
+    this.readable_ = readable;
+    /** @const {boolean} */
+    this.writable_ = writable;
+    // Set once the other end has been closed.
+    this.eof_ = false;
+  }
+
+  /**
+   * Create two connected ends.  Unless |duplex| is set, as for pipe(), the
+   * first end can only be read from and the second only written to.
+   *
+   * @param {number} domain
+   * @param {number} type
+   * @param {number} protocol
+   * @param {boolean} duplex
+   * @return {!Array<!LocalSocket>}
+   */
+  static createPair(domain, type, protocol, duplex) {
+    const end0 = new LocalSocket(domain, type, protocol, true, duplex);
+    const end1 = new LocalSocket(domain, type, protocol, duplex, true);
+    end0.peer_ = end1;
+    end1.peer_ = end0;
+    return [end0, end1];
+  }
+
+  /** @override */
+  toString() {
+    return `${this.constructor.name}(readable=${this.readable_}, ` +
+        `writable=${this.writable_}, eof=${this.eof_})`;
+  }
+
+  /** @override */
+  async close() {
+    // In the *NIX world, close must never fail.  That's why we don't return
+    // any errors here.
+    const peer = this.peer_;
+    if (peer === null) {
+      return;
+    }
+
+    this.peer_ = null;
+    peer.peer_ = null;
+    peer.onPeerClose_();
+    this.data = new Uint8Array(0);
+  }
+
+  /**
+   * Wake up anyone waiting on data that will now never come.
+   */
+  onPeerClose_() {
+    this.eof_ = true;
+
+    if (this.reader_) {
+      this.reader_();
+      this.reader_ = null;
+    }
+
+    if (this.receiveListener_) {
+      this.receiveListener_();
+    }
+  }
+
+  /** @override */
+  async write(buf) {
+    if (!this.writable_) {
+      return WASI.errno.EBADF;
+    }
+    if (this.peer_ === null) {
+      return WASI.errno.EPIPE;
+    }
+
+    this.peer_.onRecv(buf);
+    return {nwritten: buf.length};
+  }
+
+  /** @override */
+  async read(length) {
+    if (!this.readable_) {
+      return WASI.errno.EBADF;
+    }
+
+    // Once the other end is gone, an empty read is EOF.
+    if (this.data.length === 0 && !this.eof_) {
+      await new Promise((resolve) => this.reader_ = resolve);
+    }
+
+    const buf = this.data.slice(0, length);
+    this.data = this.data.subarray(length);
+    return {buf};
+  }
+
+  /**
+   * @return {!Promise<!chrome.socket.SocketInfo>}
+   */
+  async getSocketInfo() {
+    // Local pairs have no addresses, so getsockname() & getpeername() return
+    // wildcards like the other emulated sockets.
+    return /** @type {!chrome.socket.SocketInfo} **/ ({
+      connected: (this.peer_ !== null),
+      paused: false,
+      persistent: false,
+      localAddress: '0.0.0.0',
+      localPort: 0,
+      peerAddress: '0.0.0.0',
+      peerPort: 0,
+      socketId: -1,
+    });
+  }
+}
+
 /**
  * Maps socketIds to sockets and forwards data received to the sockets.
  */
@@ -1284,3 +1694,54 @@ class ChromeTcpListenSocketEventRouter {
     handle.onAccept(clientSocketId);
   }
 }
+
+/**
+ * Maps socketIds to sockets and forwards datagrams received to the sockets.
+ */
+class ChromeUdpSocketEventRouter {
+  constructor() {
+    this.socketMap_ = new Map();
+
+    const listener = this.onSocketUdpRecv_.bind(this);
+    chrome.sockets.udp.onReceive.addListener(listener);
+  }
+
+  /**
+   * Registers the given ChromeUdpSocket with the router.
+   *
+   * Sockets must be registered in order to be notified when they receive
+   * data.
+   *
+   * @param {number} socketId
+   * @param {!ChromeUdpSocket} socket
+   */
+  register(socketId, socket) {
+    this.socketMap_.set(socketId, socket);
+  }
+
+  /**
+   * Unregisters the ChromeUdpSocket with the given ID from the router.
+   *
+   * @param {number} socketId
+   */
+  unregister(socketId) {
+    this.socketMap_.delete(socketId);
+  }
+
+  /**
+   * The onReceive listener for the chrome.sockets API which forwards data to
+   * the associated ChromeUdpSocket.
+   *
+   * @param {!chrome.sockets.udp.ReceiveEventData} options
+   */
+  onSocketUdpRecv_({socketId, data, remoteAddress, remotePort}) {
+    const handle = this.socketMap_.get(socketId);
+    if (handle === undefined) {
+      // Chrome broadcasts events to all instances of Secure Shell.  The
+      // sockets are not bound to the specific runtime.
+      return;
+    }
+
+    handle.onRecv(data, remoteAddress, remotePort);
+  }
+}
@@ -11,6 +11,11 @@
 import {SyscallEntry, WASI} from '../../wasi-js-bindings/index.js';
 import * as Constants from './constants.js';
 
+/**
+ * Size of struct wassh_datagram.
+ */
+const kDatagramSize = 36;
+
 /**
  * WASSH syscall extensions.
  */
@@ -20,6 +25,37 @@ export class WasshExperimental extends SyscallEntry.Base {
     this.namespace = 'wassh_experimental';
   }
 
+  /**
+   * Decode an IPv4 or IPv6 address passed to a syscall.
+   *
+   * @param {number} domain AF_INET or AF_INET6.
+   * @param {!WASI_t.pointer} addr_ptr The address in network byte order.
+   * @return {string|number} The address, or the index of a fake address.
+   */
+  getInetAddress_(domain, addr_ptr) {
+    if (domain === Constants.AF_INET) {
+      const dv = this.getView_(addr_ptr, 4);
+      const bytes = this.getMem_(addr_ptr, addr_ptr + 4);
+      // If address is within the fake range (0.0.0.0/8), pass it as an
+      // integer to look up the real host later.
+      if (bytes[0] === 0) {
+        return dv.getUint32(0);
+      }
+      return bytes.join('.');
+    }
+
+    const bytes = this.getMem_(addr_ptr, addr_ptr + 16);
+    if (bytes[0] === 1 && bytes.subarray(1, 8).every((b) => b === 0)) {
+      // If address is within the fake range (100::/64), pass it as an
+      // integer to look up the real host later.
+      return this.getView_(addr_ptr + 12, 4).getUint32(0);
+    }
+    // The groups are in network (big endian) order.
+    const dv = this.getView_(addr_ptr, 16);
+    return Array.from({length: 8}, (_, i) => dv.getUint16(i * 2))
+        .map((b) => b.toString(16).padStart(4, '0')).join(':');
+  }
+
   /**
    * @param {!WASI_t.fd} sock
    * @param {!WASI_t.pointer} newsock_ptr
@@ -47,32 +83,10 @@ export class WasshExperimental extends SyscallEntry.Base {
   sys_sock_bind(sock, domain, addr_ptr, port) {
     let address;
     switch (domain) {
-      case Constants.AF_INET: {
-        const dv = this.getView_(addr_ptr, 4);
-        const bytes = this.getMem_(addr_ptr, addr_ptr + 4);
-        // If address is within the fake range (0.0.0.0/8), pass it as an
-        // integer to look up the real host later.
-        address = dv.getUint32(0, true);
-        if (address >= 0x1000000) {
-          address = bytes.join('.');
-        }
-        break;
-      }
-
-      case Constants.AF_INET6: {
-        const bytes = this.getMem_(addr_ptr, addr_ptr + 16);
-        if (bytes[0] === 1) {
-          // If address is within the fake range (100::/64), pass it as an
-          // integer to look up the real host later.
-          address = bytes[15];
-        } else {
-          // TODO(vapier): Check endianness; might need DataView via getView_().
-          const u16 = new Uint16Array(bytes.buffer, bytes.bytesOffset, 8);
-          address = Array.from(u16).map(
-              (b) => b.toString(16).padStart(4, '0')).join(':');
-        }
+      case Constants.AF_INET:
+      case Constants.AF_INET6:
+        address = this.getInetAddress_(domain, addr_ptr);
         break;
-      }
 
       default:
         return WASI.errno.EAFNOSUPPORT;
@@ -120,6 +134,25 @@ export class WasshExperimental extends SyscallEntry.Base {
     return WASI.errno.ESUCCESS;
   }
 
+  /**
+   * @param {!WASI_t.s32} domain
+   * @param {!WASI_t.s32} type
+   * @param {!WASI_t.s32} protocol
+   * @param {!WASI_t.pointer} fds_ptr
+   * @return {!WASI_t.errno}
+   */
+  sys_sock_create_pair(domain, type, protocol, fds_ptr) {
+    const ret = this.handle_sock_create_pair(domain, type, protocol);
+    if (typeof ret === 'number') {
+      return ret;
+    }
+
+    const dv = this.getView_(fds_ptr, 8);
+    dv.setFd(0, ret.fds[0], true);
+    dv.setFd(4, ret.fds[1], true);
+    return WASI.errno.ESUCCESS;
+  }
+
   /**
    * @param {!WASI_t.fd} sock
    * @param {!WASI_t.s32} domain
@@ -145,32 +178,10 @@ export class WasshExperimental extends SyscallEntry.Base {
         break;
       }
 
-      case Constants.AF_INET: {
-        const dv = this.getView_(addr_ptr, 4);
-        const bytes = this.getMem_(addr_ptr, addr_ptr + 4);
-        // If address is within the fake range (0.0.0.0/8), pass it as an
-        // integer to look up the real host later.
-        address = dv.getUint32(0, true);
-        if (address >= 0x1000000) {
-          address = bytes.join('.');
-        }
-        break;
-      }
-
-      case Constants.AF_INET6: {
-        const bytes = this.getMem_(addr_ptr, addr_ptr + 16);
-        if (bytes[0] === 1) {
-          // If address is within the fake range (100::/64), pass it as an
-          // integer to look up the real host later.
-          address = bytes[15];
-        } else {
-          // TODO(vapier): Check endianness; might need DataView via getView_().
-          const u16 = new Uint16Array(bytes.buffer, bytes.bytesOffset, 8);
-          address = Array.from(u16).map(
-              (b) => b.toString(16).padStart(4, '0')).join(':');
-        }
+      case Constants.AF_INET:
+      case Constants.AF_INET6:
+        address = this.getInetAddress_(domain, addr_ptr);
         break;
-      }
 
       default:
         return WASI.errno.EAFNOSUPPORT;
@@ -247,6 +258,161 @@ export class WasshExperimental extends SyscallEntry.Base {
     return this.handle_sock_set_opt(sock, level, name, value);
   }
 
+  /**
+   * Gather the payload of a struct wassh_datagram.
+   *
+   * @param {!WasiView} dv View of the datagram.
+   * @return {!Uint8Array} A copy of the payload.
+   */
+  getDatagramData_(dv) {
+    const dvIovs = this.getView_(dv.getUint32(0, true));
+    const iovs_len = dv.getUint32(4, true);
+    const iovecs = [];
+    let length = 0;
+    let iovs_off = 0;
+    for (let i = 0; i < iovs_len; ++i) {
+      const iovec = dvIovs.getIovec(iovs_off, true);
+      iovecs.push(iovec);
+      length += iovec.buf_len;
+      iovs_off += iovec.struct_size;
+    }
+
+    const data = new Uint8Array(length);
+    let offset = 0;
+    for (const iovec of iovecs) {
+      data.set(this.getMem_(iovec.buf, iovec.buf + iovec.buf_len), offset);
+      offset += iovec.buf_len;
+    }
+    return data;
+  }
+
+  /**
+   * Send datagrams.  See struct wassh_datagram for the layout of |dgrams_ptr|.
+   *
+   * @param {!WASI_t.fd} sock
+   * @param {!WASI_t.pointer} dgrams_ptr
+   * @param {!WASI_t.size} count
+   * @param {!WASI_t.pointer} nsent_ptr
+   * @return {!WASI_t.errno}
+   */
+  sys_sock_send_datagrams(sock, dgrams_ptr, count, nsent_ptr) {
+    // The whole batch is handed over in one call.
+    const datagrams = [];
+    for (let i = 0; i < count; ++i) {
+      const dv = this.getView_(dgrams_ptr + i * kDatagramSize, kDatagramSize);
+      const domain = dv.getInt32(12, true);
+      let address = null;
+      switch (domain) {
+        case Constants.AF_UNSPEC:
+          break;
+
+        case Constants.AF_INET:
+        case Constants.AF_INET6:
+          address = this.getInetAddress_(domain, dgrams_ptr +
+                                         i * kDatagramSize + 16);
+          break;
+
+        default:
+          return WASI.errno.EAFNOSUPPORT;
+      }
+      datagrams.push({
+        buf: this.getDatagramData_(dv),
+        address,
+        port: dv.getUint16(32, true),
+      });
+    }
+
+    const ret = this.handle_sock_send_datagrams(sock, datagrams);
+    if (typeof ret === 'number') {
+      return ret;
+    }
+
+    ret.sent.forEach((nwritten, i) => {
+      const dv = this.getView_(dgrams_ptr + i * kDatagramSize, kDatagramSize);
+      dv.setUint32(8, nwritten, true);
+    });
+    const dv = this.getView_(nsent_ptr, 4);
+    dv.setUint32(0, ret.sent.length, true);
+    return WASI.errno.ESUCCESS;
+  }
+
+  /**
+   * Receive datagrams.  Waits for the first one, and returns whatever else has
+   * arrived already.  See struct wassh_datagram for the layout of |dgrams_ptr|.
+   *
+   * @param {!WASI_t.fd} sock
+   * @param {!WASI_t.pointer} dgrams_ptr
+   * @param {!WASI_t.size} count
+   * @param {!WASI_t.s32} flags
+   * @param {!WASI_t.pointer} nrecv_ptr
+   * @return {!WASI_t.errno}
+   */
+  sys_sock_recv_datagrams(sock, dgrams_ptr, count, flags, nrecv_ptr) {
+    const iovecs = [];
+    for (let i = 0; i < count; ++i) {
+      const dv = this.getView_(dgrams_ptr + i * kDatagramSize, kDatagramSize);
+      const dvIovs = this.getView_(dv.getUint32(0, true));
+      const iovs_len = dv.getUint32(4, true);
+      const list = [];
+      let iovs_off = 0;
+      for (let j = 0; j < iovs_len; ++j) {
+        const iovec = dvIovs.getIovec(iovs_off, true);
+        list.push(iovec);
+        iovs_off += iovec.struct_size;
+      }
+      iovecs.push(list);
+    }
+
+    const lengths = iovecs.map(
+        (list) => list.reduce((sum, iovec) => sum + iovec.buf_len, 0));
+    const ret = this.handle_sock_recv_datagrams(sock, lengths, flags);
+    if (typeof ret === 'number') {
+      return ret;
+    }
+
+    ret.datagrams.forEach(({buf, truncated, family, address, port}, i) => {
+      const u8 = new Uint8Array(buf);
+      let offset = 0;
+      for (const iovec of iovecs[i]) {
+        if (offset >= u8.length) {
+          break;
+        }
+        const chunk = u8.subarray(offset, offset + iovec.buf_len);
+        this.getMem_(iovec.buf, iovec.buf + chunk.length).set(chunk);
+        offset += chunk.length;
+      }
+
+      const base = dgrams_ptr + i * kDatagramSize;
+      const dv = this.getView_(base, kDatagramSize);
+      dv.setUint32(8, u8.length, true);
+      dv.setInt32(12, family, true);
+      const addr = this.getMem_(base + 16, base + 32);
+      addr.fill(0);
+      addr.set(address);
+      dv.setUint16(32, port, true);
+      dv.setUint16(34, truncated ? Constants.RECV_DATA_TRUNCATED : 0, true);
+    });
+    const dv = this.getView_(nrecv_ptr, 4);
+    dv.setUint32(0, ret.datagrams.length, true);
+    return WASI.errno.ESUCCESS;
+  }
+
+  /**
+   * @param {!WASI_t.pointer} fds_ptr
+   * @return {!WASI_t.errno}
+   */
+  sys_fd_pipe(fds_ptr) {
+    const ret = this.handle_fd_pipe();
+    if (typeof ret === 'number') {
+      return ret;
+    }
+
+    const dv = this.getView_(fds_ptr, 8);
+    dv.setFd(0, ret.fds[0], true);
+    dv.setFd(4, ret.fds[1], true);
+    return WASI.errno.ESUCCESS;
+  }
+
   /**
    * @param {!WASI_t.fd} oldfd
    * @param {!WASI_t.pointer} newfd_ptr
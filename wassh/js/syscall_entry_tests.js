@@ -0,0 +1,252 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * @fileoverview Tests for the wassh syscall entries.
+ */
+
+import {WASI, WasiView} from '../../wasi-js-bindings/index.js';
+import * as Constants from './constants.js';
+import {WasshExperimental} from './syscall_entry.js';
+
+describe('syscall_entry.js', () => {
+
+/**
+ * Where the test puts things in the program's memory.
+ */
+const kDatagramsPtr = 0x100;
+const kIovecsPtr = 0x400;
+const kDataPtr = 0x800;
+const kNumPtr = 0xff0;
+const kDatagramSize = 36;
+
+let mem;
+let entry;
+let calls;
+let result;
+
+/**
+ * Create a syscall entry over a fresh memory, with a handler that records its
+ * calls and returns |result|.
+ */
+beforeEach(() => {
+  mem = new Uint8Array(0x1000);
+  const process = {
+    getMem: (base, end) => mem.subarray(base, end),
+    getView: (base, length) => new WasiView(mem.buffer, base, length),
+  };
+  calls = [];
+  result = WASI.errno.ENOSYS;
+  const handler = {
+    handle_sock_send_datagrams: (...args) => {
+      calls.push(args);
+      return result;
+    },
+    handle_sock_recv_datagrams: (...args) => {
+      calls.push(args);
+      return result;
+    },
+  };
+  entry = new WasshExperimental({sys_handlers: [handler], process});
+});
+
+/**
+ * Fill in the i'th struct wassh_datagram.
+ *
+ * @param {number} i
+ * @param {{
+ *   iovs: !Array<!Array<number>>,
+ *   domain: (number|undefined),
+ *   addr: (!Array<number>|undefined),
+ *   port: (number|undefined),
+ * }} dgram The iovecs are given as [offset into kDataPtr, length] pairs.
+ */
+function setDatagram(i, {iovs, domain = Constants.AF_UNSPEC, addr = [],
+                         port = 0}) {
+  const iovsPtr = kIovecsPtr + i * 0x40;
+  const iovsView = new WasiView(mem.buffer, iovsPtr);
+  iovs.forEach(([offset, length], j) => {
+    iovsView.setIovec(j * 8, {buf: kDataPtr + offset, buf_len: length}, true);
+  });
+
+  const base = kDatagramsPtr + i * kDatagramSize;
+  const dv = new DataView(mem.buffer, base, kDatagramSize);
+  dv.setUint32(0, iovsPtr, true);
+  dv.setUint32(4, iovs.length, true);
+  dv.setUint32(8, 0xdeadbeef, true);
+  dv.setInt32(12, domain, true);
+  mem.set(addr, base + 16);
+  dv.setUint16(32, port, true);
+  dv.setUint16(34, 0xffff, true);
+}
+
+/**
+ * Read back the i'th struct wassh_datagram.
+ *
+ * @param {number} i
+ * @return {{len: number, domain: number, addr: !Array<number>, port: number,
+ *     flags: number}}
+ */
+function getDatagram(i) {
+  const base = kDatagramsPtr + i * kDatagramSize;
+  const dv = new DataView(mem.buffer, base, kDatagramSize);
+  return {
+    len: dv.getUint32(8, true),
+    domain: dv.getInt32(12, true),
+    addr: Array.from(mem.subarray(base + 16, base + 32)),
+    port: dv.getUint16(32, true),
+    flags: dv.getUint16(34, true),
+  };
+}
+
+/**
+ * @return {number} The count written to kNumPtr.
+ */
+function getNum() {
+  return new DataView(mem.buffer).getUint32(kNumPtr, true);
+}
+
+/**
+ * The payloads are gathered from all their iovecs, and the peers decoded.
+ */
+it('send-decode', () => {
+  mem.set([1, 2, 3, 4, 5, 6, 7, 8], kDataPtr);
+  setDatagram(0, {iovs: [[0, 2], [4, 3]], domain: Constants.AF_INET,
+                  addr: [192, 0, 2, 1], port: 53});
+  const v6 = [0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1];
+  setDatagram(1, {iovs: [[2, 1]], domain: Constants.AF_INET6, addr: v6,
+                  port: 0x1234});
+  // Fake addresses are passed on as their index.
+  setDatagram(2, {iovs: [], domain: Constants.AF_INET, addr: [0, 0, 0, 7],
+                  port: 22});
+  setDatagram(3, {iovs: [[7, 1]]});
+  result = {sent: [5, 1, 0, 1]};
+
+  const ret = entry.sys_sock_send_datagrams(3, kDatagramsPtr, 4, kNumPtr);
+  assert.equal(ret, WASI.errno.ESUCCESS);
+  assert.equal(calls.length, 1);
+  const [sock, datagrams] = calls[0];
+  assert.equal(sock, 3);
+  assert.deepStrictEqual(datagrams.map(({buf, address, port}) => ({
+    buf: Array.from(buf), address, port,
+  })), [
+    {buf: [1, 2, 5, 6, 7], address: '192.0.2.1', port: 53},
+    {buf: [3], address: '2001:0db8:0000:0000:0000:0000:0000:0001',
+     port: 0x1234},
+    {buf: [], address: 7, port: 22},
+    {buf: [8], address: null, port: 0},
+  ]);
+
+  assert.equal(getNum(), 4);
+  assert.deepStrictEqual([0, 1, 2, 3].map((i) => getDatagram(i).len),
+                         [5, 1, 0, 1]);
+});
+
+/**
+ * When only some datagrams were sent, only those are updated.
+ */
+it('send-partial', () => {
+  setDatagram(0, {iovs: [[0, 4]]});
+  setDatagram(1, {iovs: [[4, 4]]});
+  setDatagram(2, {iovs: [[8, 4]]});
+  result = {sent: [4]};
+
+  const ret = entry.sys_sock_send_datagrams(3, kDatagramsPtr, 3, kNumPtr);
+  assert.equal(ret, WASI.errno.ESUCCESS);
+  assert.equal(getNum(), 1);
+  assert.equal(getDatagram(0).len, 4);
+  assert.equal(getDatagram(1).len, 0xdeadbeef);
+  assert.equal(getDatagram(2).len, 0xdeadbeef);
+});
+
+/**
+ * Errors from the handler are returned as they are.
+ */
+it('send-error', () => {
+  setDatagram(0, {iovs: [[0, 4]]});
+  new DataView(mem.buffer).setUint32(kNumPtr, 0xdeadbeef, true);
+  result = WASI.errno.ENETUNREACH;
+
+  const ret = entry.sys_sock_send_datagrams(3, kDatagramsPtr, 1, kNumPtr);
+  assert.equal(ret, WASI.errno.ENETUNREACH);
+  assert.equal(getNum(), 0xdeadbeef);
+  assert.equal(getDatagram(0).len, 0xdeadbeef);
+});
+
+/**
+ * Unknown address families are rejected before anything is sent.
+ */
+it('send-bad-family', () => {
+  setDatagram(0, {iovs: [[0, 4]]});
+  setDatagram(1, {iovs: [[0, 4]], domain: Constants.AF_UNIX});
+
+  const ret = entry.sys_sock_send_datagrams(3, kDatagramsPtr, 2, kNumPtr);
+  assert.equal(ret, WASI.errno.EAFNOSUPPORT);
+  assert.deepStrictEqual(calls, []);
+});
+
+/**
+ * Received datagrams are scattered over the iovecs with their peers.
+ */
+it('recv', () => {
+  setDatagram(0, {iovs: [[0, 2], [8, 4]]});
+  setDatagram(1, {iovs: [[16, 4]]});
+  setDatagram(2, {iovs: [[24, 4]]});
+  result = {datagrams: [{
+    buf: new Uint8Array([1, 2, 3, 4, 5]),
+    truncated: false,
+    family: Constants.AF_INET,
+    address: [192, 0, 2, 1],
+    port: 53,
+  }, {
+    // Already cut down to the room in the iovecs.
+    buf: new Uint8Array([6, 7, 8, 9]),
+    truncated: true,
+    family: Constants.AF_INET6,
+    address: [0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+    port: 0x1234,
+  }]};
+
+  const ret = entry.sys_sock_recv_datagrams(3, kDatagramsPtr, 3,
+                                            Constants.RECV_PEEK, kNumPtr);
+  assert.equal(ret, WASI.errno.ESUCCESS);
+  assert.deepStrictEqual(calls, [[3, [6, 4, 4], Constants.RECV_PEEK]]);
+
+  assert.equal(getNum(), 2);
+  assert.deepStrictEqual(Array.from(mem.subarray(kDataPtr, kDataPtr + 24)), [
+    1, 2, 0, 0, 0, 0, 0, 0,
+    3, 4, 5, 0, 0, 0, 0, 0,
+    6, 7, 8, 9, 0, 0, 0, 0,
+  ]);
+  assert.deepStrictEqual(getDatagram(0), {
+    len: 5,
+    domain: Constants.AF_INET,
+    addr: [192, 0, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0],
+    port: 53,
+    flags: 0,
+  });
+  assert.deepStrictEqual(getDatagram(1), {
+    len: 4,
+    domain: Constants.AF_INET6,
+    addr: [0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+    port: 0x1234,
+    flags: Constants.RECV_DATA_TRUNCATED,
+  });
+  // Datagrams past the ones received are left alone.
+  assert.equal(getDatagram(2).len, 0xdeadbeef);
+});
+
+/**
+ * Errors from the handler are returned as they are.
+ */
+it('recv-error', () => {
+  setDatagram(0, {iovs: [[0, 4]]});
+  result = WASI.errno.EBADF;
+
+  const ret = entry.sys_sock_recv_datagrams(3, kDatagramsPtr, 1, 0, kNumPtr);
+  assert.equal(ret, WASI.errno.EBADF);
+  assert.equal(getDatagram(0).len, 0xdeadbeef);
+});
+
+});
@@ -18,6 +18,42 @@ import * as VFS from './vfs.js';
  */
 const kNanosecToMillisec = 1000000;
 
+/**
+ * Convert an address from the Chrome sockets APIs to bytes.
+ *
+ * @param {?string} address An IPv4 or IPv6 address, or null if unknown.
+ * @return {{family: number, address: !Array<number>}}
+ */
+function parseInetAddress(address) {
+  if (address === null) {
+    return {family: Constants.AF_UNSPEC, address: []};
+  }
+
+  if (!address.includes(':')) {
+    return {
+      family: Constants.AF_INET,
+      address: address.split('.').map((x) => parseInt(x, 10)),
+    };
+  }
+
+  // Drop any scope (e.g. "%eth0"), and expand "::" into the missing groups.
+  const [head, tail] = address.split('%')[0].split('::');
+  const headGroups = head ? head.split(':') : [];
+  const tailGroups = tail ? tail.split(':') : [];
+  const groups = tail === undefined ? headGroups : [
+    ...headGroups,
+    ...new Array(8 - headGroups.length - tailGroups.length).fill('0'),
+    ...tailGroups,
+  ];
+  return {
+    family: Constants.AF_INET6,
+    address: groups.flatMap((x) => {
+      const group = parseInt(x, 16);
+      return [group >> 8, group & 0xff];
+    }),
+  };
+}
+
 class Tty extends VFS.FileHandle {
   constructor(term, handler) {
     super('/dev/tty', WASI.filetype.CHARACTER_DEVICE);
@@ -81,7 +117,6 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
     this.notify_ = null;
     this.fileSystem_ = fileSystem;
     this.vfs = new VFS.VFS({stdio: false});
-    this.socketUdpRecv_ = null;
     this.fakeAddrMap_ = new Map();
     this.firstConnection_ = true;
   }
@@ -253,6 +288,16 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
     return this.vfs.dup(oldfd, newfd);
   }
 
+  /**
+   * @return {!WASI_t.errno|{fds: !Array<!WASI_t.fd>}}
+   */
+  handle_fd_pipe() {
+    // WASI has no FIFO filetype, so pipes show up as stream sockets.
+    const ends = Sockets.LocalSocket.createPair(
+        Constants.AF_UNIX, WASI.filetype.SOCKET_STREAM, 0, false);
+    return this.openPair_(ends);
+  }
+
   /** @override */
   handle_fd_renumber(fd, to) {
     return this.vfs.dup2(fd, to);
@@ -427,7 +472,8 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
                      handle.filetype === WASI.filetype.CHARACTER_DEVICE) {
             // If it's a socket, see if any data is available.
             if (subscription.tag === WASI.eventtype.FD_READ) {
-              if (handle.data.length || handle?.clients_?.length) {
+              if (handle.data.length || handle?.clients_?.length ||
+                  handle?.datagrams_?.length || handle?.eof_) {
                 events.push(eventBase);
               }
             } else if (subscription.tag === WASI.eventtype.FD_WRITE) {
@@ -583,7 +629,12 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
    * @return {!WASI_t.errno}
    */
   handle_sock_register_fake_addr(idx, name) {
-    this.fakeAddrMap_.set(idx, name);
+    // An empty name releases the address.
+    if (name === '') {
+      this.fakeAddrMap_.delete(idx);
+    } else {
+      this.fakeAddrMap_.set(idx, name);
+    }
     return WASI.errno.ESUCCESS;
   }
 
@@ -613,7 +664,12 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
             }
             break;
           case WASI.filetype.SOCKET_DGRAM:
-            // TODO(vapier): Implement UDP support.
+            if (Sockets.ChromeUdpSocket.isSupported()) {
+              handle = new Sockets.ChromeUdpSocket(domain, type, protocol);
+            } else {
+              return WASI.errno.EPROTONOSUPPORT;
+            }
+            break;
           default:
             return WASI.errno.EPROTONOSUPPORT;
         }
@@ -653,6 +709,53 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
     }
   }
 
+  /**
+   * @param {number} domain
+   * @param {number} type
+   * @param {number} protocol
+   * @return {!WASI_t.errno|{fds: !Array<!WASI_t.fd>}}
+   */
+  handle_sock_create_pair(domain, type, protocol) {
+    // Only a connected pair of stream sockets within the runtime is supported.
+    if (domain !== Constants.AF_UNIX) {
+      return WASI.errno.EAFNOSUPPORT;
+    }
+    if (type !== WASI.filetype.SOCKET_STREAM) {
+      return WASI.errno.ENOTSUP;
+    }
+    if (protocol !== 0) {
+      return WASI.errno.EPROTONOSUPPORT;
+    }
+
+    const ends = Sockets.LocalSocket.createPair(domain, type, protocol, true);
+    return this.openPair_(ends);
+  }
+
+  /**
+   * Add both ends of a pipe or socketpair to the fd table.
+   *
+   * @param {!Array<!Sockets.LocalSocket>} ends
+   * @return {!WASI_t.errno|{fds: !Array<!WASI_t.fd>}}
+   */
+  openPair_(ends) {
+    const fds = [];
+    for (const handle of ends) {
+      handle.setReceiveListener(() => {
+        if (this.notify_) {
+          this.notify_();
+        }
+      });
+
+      const fd = this.vfs.openHandle(handle);
+      if (fd < 0) {
+        fds.forEach((fd) => this.vfs.close(fd));
+        return WASI.errno.EMFILE;
+      }
+      fds.push(fd);
+    }
+    return {fds};
+  }
+
   /**
    * @param {number} socket
    * @param {string} address
@@ -668,13 +771,6 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
       return WASI.errno.ENOTSOCK;
     }
 
-    /* TODO(vapier): Implement UDP support.
-    if (this.socketUdpRecv_ === null) {
-      this.socketUdpRecv_ = this.onSocketUdpRecv.bind(this);
-      chrome.sockets.Udp.onReceive.addListener(this.socketUdpRecv_);
-    }
-    */
-
     // The getaddrinfo function used -1 to register a delayed hostname lookup.
     if (handle.protocol === -1) {
       address = this.fakeAddrMap_.get(address);
@@ -699,6 +795,77 @@ export class RemoteReceiverWasiPreview1 extends SyscallHandler.Base {
     return handle.connect(address, port);
   }
 
+  /**
+   * @param {number} socket
+   * @param {!Array<{buf: !Uint8Array, address: (?string|number),
+   *     port: number}>} datagrams
+   * @return {!WASI_t.errno|{sent: !Array<number>}}
+   */
+  async handle_sock_send_datagrams(socket, datagrams) {
+    const handle = this.vfs.getFileHandle(socket);
+    if (handle === undefined) {
+      return WASI.errno.EBADF;
+    }
+    if (!(handle instanceof Sockets.Socket)) {
+      return WASI.errno.ENOTSOCK;
+    }
+
+    // Stop at the first failure, and only report it if nothing was sent.
+    const sent = [];
+    for (let {buf, address, port} of datagrams) {
+      // The getaddrinfo function registered fake addresses for hostnames.
+      if (typeof address === 'number') {
+        address = this.fakeAddrMap_.get(address);
+        if (address === undefined) {
+          return sent.length ? {sent} : WASI.errno.EFAULT;
+        }
+      }
+
+      const ret = await handle.sendTo(buf, address, port);
+      if (typeof ret === 'number') {
+        return sent.length ? {sent} : ret;
+      }
+      sent.push(ret.nwritten);
+    }
+    return {sent};
+  }
+
+  /**
+   * @param {number} socket
+   * @param {!Array<number>} lengths Room for each datagram.
+   * @param {number} flags
+   * @return {!WASI_t.errno|{datagrams: !Array<{
+   *    buf: !Uint8Array,
+   *    truncated: boolean,
+   *    family: number,
+   *    address: !Array<number>,
+   *    port: number,
+   * }>}}
+   */
+  async handle_sock_recv_datagrams(socket, lengths, flags) {
+    const handle = this.vfs.getFileHandle(socket);
+    if (handle === undefined) {
+      return WASI.errno.EBADF;
+    }
+    if (!(handle instanceof Sockets.Socket)) {
+      return WASI.errno.ENOTSOCK;
+    }
+
+    const ret = await handle.recvFrom(lengths, flags);
+    if (typeof ret === 'number') {
+      return ret;
+    }
+
+    return {
+      datagrams: ret.datagrams.map(({buf, truncated, address, port}) => ({
+        buf,
+        truncated,
+        ...parseInetAddress(address),
+        port,
+      })),
+    };
+  }
+
   /**
    * @param {!WASI_t.fd} socket
    * @param {!WASI_t.size} remote
@@ -0,0 +1,235 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * @fileoverview Tests for the wassh syscall handlers.
+ */
+
+import {WASI} from '../../wasi-js-bindings/index.js';
+import * as Constants from './constants.js';
+import {RemoteReceiverWasiPreview1} from './syscall_handler.js';
+
+describe('syscall_handler.js', () => {
+
+/**
+ * A fake chrome.sockets.udp.
+ *
+ * The onReceive listener is registered once for all sockets, so this is shared
+ * by all the tests.
+ */
+const udp = {
+  nextId: 1,
+  // What send() was called with.
+  sent: [],
+  // What send() returns for each call; it succeeds once this runs out.
+  sendResults: [],
+  listeners: [],
+
+  create(callback) {
+    callback({socketId: udp.nextId++});
+  },
+  bind(socketId, address, port, callback) {
+    callback(0);
+  },
+  send(socketId, data, address, port, callback) {
+    udp.sent.push({socketId, data: Array.from(new Uint8Array(data)), address,
+                   port});
+    callback(udp.sendResults.shift() ??
+             {resultCode: 0, bytesSent: data.byteLength});
+  },
+  close(socketId) {},
+  getInfo(socketId, callback) {
+    callback({socketId});
+  },
+  onReceive: {
+    addListener(listener) {
+      udp.listeners.push(listener);
+    },
+  },
+
+  /**
+   * Deliver a datagram to all the listeners.
+   *
+   * @param {number} socketId
+   * @param {!Array<number>} data
+   * @param {string} remoteAddress
+   * @param {number} remotePort
+   */
+  receive(socketId, data, remoteAddress, remotePort) {
+    const info = {socketId, data: new Uint8Array(data).buffer, remoteAddress,
+                  remotePort};
+    udp.listeners.forEach((listener) => listener(info));
+  },
+};
+
+let handler;
+let socket;
+let socketId;
+
+/**
+ * Install the fake API, and create a UDP socket with it.
+ */
+beforeEach(async () => {
+  udp.sent = [];
+  udp.sendResults = [];
+  chrome.sockets = {udp};
+
+  handler = new RemoteReceiverWasiPreview1();
+  socketId = udp.nextId;
+  const ret = await handler.handle_sock_create(
+      Constants.AF_INET, WASI.filetype.SOCKET_DGRAM, 0);
+  socket = ret.socket;
+});
+
+/**
+ * Close the socket, and remove the fake API.
+ */
+afterEach(async () => {
+  await handler.handle_fd_close(socket);
+  delete chrome.sockets;
+});
+
+/**
+ * A batch is sent one datagram at a time to each peer.
+ */
+it('send', async () => {
+  const ret = await handler.handle_sock_send_datagrams(socket, [
+    {buf: new Uint8Array([1, 2, 3]), address: '192.0.2.1', port: 53},
+    {buf: new Uint8Array([4]).subarray(0, 1), address: '2001:db8::1',
+     port: 123},
+  ]);
+  assert.deepStrictEqual(ret, {sent: [3, 1]});
+  assert.deepStrictEqual(udp.sent, [
+    {socketId, data: [1, 2, 3], address: '192.0.2.1', port: 53},
+    {socketId, data: [4], address: '2001:db8::1', port: 123},
+  ]);
+});
+
+/**
+ * Fake addresses are sent to the hostname they were registered for.
+ */
+it('send-fake-address', async () => {
+  handler.handle_sock_register_fake_addr(7, 'example.com');
+
+  const ret = await handler.handle_sock_send_datagrams(socket, [
+    {buf: new Uint8Array([1]), address: 7, port: 53},
+  ]);
+  assert.deepStrictEqual(ret, {sent: [1]});
+  assert.equal(udp.sent[0].address, 'example.com');
+
+  assert.equal(await handler.handle_sock_send_datagrams(socket, [
+    {buf: new Uint8Array([1]), address: 8, port: 53},
+  ]), WASI.errno.EFAULT);
+});
+
+/**
+ * Sending stops at the first failure, which is only reported if nothing was
+ * sent.
+ */
+it('send-partial-failure', async () => {
+  const datagrams = [
+    {buf: new Uint8Array([1, 2]), address: '192.0.2.1', port: 53},
+    {buf: new Uint8Array([3]), address: '192.0.2.2', port: 53},
+    {buf: new Uint8Array([4]), address: '192.0.2.3', port: 53},
+  ];
+
+  udp.sendResults = [{resultCode: 0, bytesSent: 2}, {resultCode: -109}];
+  let ret = await handler.handle_sock_send_datagrams(socket, datagrams);
+  assert.deepStrictEqual(ret, {sent: [2]});
+  assert.equal(udp.sent.length, 2);
+
+  udp.sent = [];
+  udp.sendResults = [{resultCode: -109}];
+  ret = await handler.handle_sock_send_datagrams(socket, datagrams);
+  assert.equal(ret, WASI.errno.ENETUNREACH);
+  assert.equal(udp.sent.length, 1);
+
+  // A bad fake address after a datagram went out is a partial send too.
+  udp.sent = [];
+  ret = await handler.handle_sock_send_datagrams(socket, [
+    datagrams[0], {buf: new Uint8Array([3]), address: 9, port: 53},
+  ]);
+  assert.deepStrictEqual(ret, {sent: [2]});
+  assert.equal(udp.sent.length, 1);
+});
+
+/**
+ * Sending on something that isn't a socket fails.
+ */
+it('send-bad-fd', async () => {
+  assert.equal(await handler.handle_sock_send_datagrams(99, []),
+               WASI.errno.EBADF);
+});
+
+/**
+ * Queued datagrams are returned in one batch with their peers, and cut down
+ * to the room given for them.
+ */
+it('recv', async () => {
+  udp.receive(socketId, [1, 2, 3, 4, 5, 6], '192.0.2.1', 53);
+  udp.receive(socketId, [7, 8], '2001:db8::1', 123);
+  udp.receive(socketId, [9], '192.0.2.3', 53);
+  // Other sockets' datagrams aren't ours.
+  udp.receive(socketId + 100, [10], '192.0.2.4', 53);
+
+  const ret = await handler.handle_sock_recv_datagrams(socket, [4, 4], 0);
+  const datagrams = ret.datagrams.map((d) => ({...d, buf: Array.from(d.buf)}));
+  assert.deepStrictEqual(datagrams, [{
+    buf: [1, 2, 3, 4],
+    truncated: true,
+    family: Constants.AF_INET,
+    address: [192, 0, 2, 1],
+    port: 53,
+  }, {
+    buf: [7, 8],
+    truncated: false,
+    family: Constants.AF_INET6,
+    address: [0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1],
+    port: 123,
+  }]);
+
+  // The one that didn't fit in the batch is still queued.
+  const next = await handler.handle_sock_recv_datagrams(socket, [4, 4], 0);
+  assert.equal(next.datagrams.length, 1);
+  assert.deepStrictEqual(Array.from(next.datagrams[0].buf), [9]);
+});
+
+/**
+ * A peek returns only the first datagram, and leaves it queued.
+ */
+it('recv-peek', async () => {
+  udp.receive(socketId, [1, 2, 3], '192.0.2.1', 53);
+  udp.receive(socketId, [4], '192.0.2.1', 53);
+
+  let ret = await handler.handle_sock_recv_datagrams(
+      socket, [2, 2], Constants.RECV_PEEK);
+  assert.equal(ret.datagrams.length, 1);
+  assert.deepStrictEqual(Array.from(ret.datagrams[0].buf), [1, 2]);
+  assert.isTrue(ret.datagrams[0].truncated);
+
+  ret = await handler.handle_sock_recv_datagrams(socket, [8, 8], 0);
+  assert.deepStrictEqual(ret.datagrams.map((d) => Array.from(d.buf)),
+                         [[1, 2, 3], [4]]);
+  assert.isFalse(ret.datagrams[0].truncated);
+});
+
+/**
+ * A receive waits for the first datagram to arrive.
+ */
+it('recv-wait', async () => {
+  const pending = handler.handle_sock_recv_datagrams(socket, [4], 0);
+  udp.receive(socketId, [1], '192.0.2.1', 53);
+  const ret = await pending;
+  assert.deepStrictEqual(Array.from(ret.datagrams[0].buf), [1]);
+});
+
+/**
+ * Unknown flags are rejected.
+ */
+it('recv-bad-flags', async () => {
+  assert.equal(await handler.handle_sock_recv_datagrams(socket, [4], 2),
+               WASI.errno.ENOTSUP);
+});
+
+});
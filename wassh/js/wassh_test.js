@@ -0,0 +1,47 @@
+// Copyright 2026 The ChromiumOS Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+'use strict';
+
+/**
+ * @fileoverview Test framework setup when run inside the browser.
+ */
+
+// Setup the mocha framework.
+mocha.setup('bdd');
+mocha.checkLeaks();
+
+// Add a global shortcut to the assert API.
+const assert = chai.assert;
+
+// Tests mock the chrome.* APIs they need in here.
+globalThis.chrome = globalThis.chrome || {};
+
+// Catch any random errors before the test runner runs.
+let earlyError = null;
+
+/**
+ * Catch any errors.
+ *
+ * @param {*} args Whatever arguments are passed in.
+ */
+globalThis.onerror = function(...args) {
+  earlyError = Array.from(args);
+};
+
+/** Run the test framework once everything is finished. */
+globalThis.onload = function() {
+  mocha.run();
+};
+
+describe('wassh_test.js', () => {
+
+  /** Make sure no general framework errors happened (e.g. syntax error). */
+  it('uncaught framework errors', () => {
+    if (earlyError !== null) {
+      assert.fail(`uncaught exception detected:\n${earlyError.join('\n')}`);
+    }
+  });
+
+});